@@ -0,0 +1,109 @@
+#ifndef _AABB_H__
+#define _AABB_H__
+
+#include <algorithm>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+/**
+* Axis aligned bounding box. An empty box has min > max, so extending
+* it with the first point or box gives that point or box.
+*/
+struct AABB
+{
+	AABB()
+	{
+		min = glm::vec3(std::numeric_limits<float>::max());
+		max = -glm::vec3(std::numeric_limits<float>::max());
+	}
+
+	AABB(const glm::vec3& min, const glm::vec3& max)
+	{
+		this->min = min;
+		this->max = max;
+	}
+
+	/**
+	* @return false if the box is empty (e.g. the result of a disjoint intersection)
+	*/
+	inline bool valid() const
+	{
+		return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+	}
+
+	inline void extend(const glm::vec3& p)
+	{
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	inline void extend(const AABB& b)
+	{
+		if(!b.valid())
+			return;
+		min = glm::min(min, b.min);
+		max = glm::max(max, b.max);
+	}
+
+	/**
+	* Returns corner i in [0, 8) of the box, bit 0/1/2 selecting max x/y/z
+	*/
+	inline glm::vec3 corner(unsigned int i) const
+	{
+		return glm::vec3((i & 1) ? max.x : min.x,
+						 (i & 2) ? max.y : min.y,
+						 (i & 4) ? max.z : min.z);
+	}
+
+	/**
+	* Returns the box enclosing this box after it is transformed by the param matrix
+	*/
+	inline AABB transformed(const glm::mat4& m) const
+	{
+		AABB result;
+		if(!valid())
+			return result;
+		for(unsigned int i = 0; i < 8; i++)
+		{
+			glm::vec4 p = m*glm::vec4(corner(i), 1.0f);
+			result.extend(glm::vec3(p)/p.w);
+		}
+		return result;
+	}
+
+	/**
+	* Returns true if the box is certainly outside the view volume of the
+	* param model view projection matrix, i.e. all its corners are outside
+	* the same clip plane. Boxes near a frustum corner may pass the test
+	* without being visible.
+	*/
+	inline bool outsideFrustum(const glm::mat4& modelviewprojection) const
+	{
+		if(!valid())
+			return true;
+		unsigned int outside_all = 0x3F;
+		for(unsigned int i = 0; i < 8; i++)
+		{
+			glm::vec4 p = modelviewprojection*glm::vec4(corner(i), 1.0f);
+			unsigned int outside = (p.x < -p.w ? 1 : 0) | (p.x > p.w ? 2 : 0)
+								 | (p.y < -p.w ? 4 : 0) | (p.y > p.w ? 8 : 0)
+								 | (p.z < -p.w ? 16 : 0) | (p.z > p.w ? 32 : 0);
+			outside_all &= outside;
+		}
+		return outside_all != 0;
+	}
+
+	/**
+	* Returns the overlap of the two boxes. The result is not valid() if they are disjoint
+	*/
+	static inline AABB intersection(const AABB& a, const AABB& b)
+	{
+		return AABB(glm::max(a.min, b.min), glm::min(a.max, b.max));
+	}
+
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+#endif
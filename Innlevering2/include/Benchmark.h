@@ -0,0 +1,86 @@
+#ifndef _BENCHMARK_H__
+#define _BENCHMARK_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "GLUtils/GLCounters.hpp"
+
+/**
+* A named, repeatable benchmark run: the scene, the render mode and a
+* scripted camera and light path, rendered with a fixed time step
+*/
+struct BenchmarkScenario {
+	enum RenderModes {
+		PHONG,
+		WIREFRAME,
+		HIDDEN_LINE
+	};
+
+	enum CameraPaths {
+		CAMERA_STATIC, //< The default view for every frame
+		CAMERA_ORBIT,  //< A trackball drag across half the window over the run
+		CAMERA_ZOOM	   //< Zooming in from 0.5 to 2.5 over the run
+	};
+
+	std::string name;
+	unsigned int models;	  //< Number of bunnies
+	bool open_room;			  //< The open half room instead of the plain cube room
+	RenderModes render_mode;
+	CameraPaths camera_path;
+	bool rotate_light;		  //< Whether the lights rotate, at the fixed time step
+	unsigned int warmup_frames; //< Rendered but not measured
+	unsigned int frames;	  //< Measured frames
+};
+
+/**
+* Summary of a series of frame times, in milliseconds. Percentiles are
+* nearest rank.
+*/
+struct FrameTimeStats {
+	FrameTimeStats(std::vector<double> frame_ms);
+
+	double mean, p50, p95, p99, max;
+};
+
+/**
+* Measured GPU times of one render pass, and its mean pipeline statistics
+* per frame (zero without ARB_pipeline_statistics_query)
+*/
+struct PassResult {
+	std::string name;
+	std::vector<double> gpu_ms; //< GPU time of the pass in each frame it ran
+	double vertices;			//< Vertex shader invocations
+	double primitives;			//< Primitives submitted
+	double fragments;			//< Fragment shader invocations
+	GLUtils::GLCounters counters; //< GL calls of the pass summed over the measured frames, with PG612_GL_COUNTERS
+	unsigned int counted_frames;  //< Frames summed in counters
+};
+
+/**
+* Measured CPU and GPU frame times of one scenario
+*/
+struct BenchmarkResult {
+	BenchmarkScenario scenario;
+	std::vector<double> cpu_ms; //< Time to submit each frame
+	std::vector<double> gpu_ms; //< GPU time of each frame, from timestamp queries
+	std::vector<PassResult> passes; //< The passes that ran, see PassQueries
+};
+
+/**
+* Returns the built in scenarios
+*/
+std::vector<BenchmarkScenario> getBenchmarkScenarios();
+
+/**
+* Writes the results as JSON: the run settings and, per scenario, its
+* settings, the mean, p50, p95, p99 and max CPU and GPU frame times, and
+* the GPU times, pipeline statistics and (with PG612_GL_COUNTERS) mean GL
+* call counts of each pass
+*/
+void writeBenchmarkJSON(std::ostream& out, const std::vector<BenchmarkResult>& results,
+						unsigned int seed, const std::string& renderer, unsigned int width, unsigned int height,
+						bool pipeline_statistics);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _CUBESHADOWFBO_HPP__
+#define _CUBESHADOWFBO_HPP__
+
+#include <glm/glm.hpp>
+
+#include "GLUtils/GLUtils.hpp"
+
+/**
+* Depth only FBO for omnidirectional shadows from a point light. The depth
+* cube map is attached as a layered target, so a geometry shader can render
+* all six faces in a single pass by selecting the face with gl_Layer.
+* Layer i is face GL_TEXTURE_CUBE_MAP_POSITIVE_X + i.
+*/
+class CubeShadowFBO {
+public:
+	/**
+	* Creates the FBO with a depth cube map of size x size texels per face
+	* and the param internal format
+	*/
+	CubeShadowFBO(unsigned int size, GLenum depth_format=GL_DEPTH_COMPONENT24);
+	~CubeShadowFBO();
+
+	void bind();
+	static void unbind();
+
+	unsigned int getSize() {return size; }
+	GLenum getDepthFormat() {return depth_format; }
+
+	GLuint getTexture() { return texture; }
+
+	/**
+	* Returns the view projection matrix of the param cube face for a
+	* point light at the param position, following the cube map face
+	* orientation conventions
+	*/
+	static glm::mat4 getFaceMatrix(unsigned int face, const glm::vec3& position, float near_clip, float far_clip);
+
+private:
+	GLuint fbo;
+	GLuint texture;
+	unsigned int size;
+	GLenum depth_format;
+};
+
+#endif
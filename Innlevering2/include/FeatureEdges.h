@@ -0,0 +1,55 @@
+#ifndef _FEATUREEDGES_H__
+#define _FEATUREEDGES_H__
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GLUtils/BO.hpp"
+
+/**
+* The unique edges of a triangle mesh, classified once when it is loaded.
+* Boundary edges have one adjacent triangle (or more than two), crease edges
+* have two meeting at more than the crease angle, and the remaining edges
+* are potential silhouettes, which depend on the view.
+*
+* The edges index the vertices of the mesh itself, in one element buffer:
+* the boundary and crease edges as GL_LINES, followed by the potential
+* silhouettes as GL_LINES_ADJACENCY (the vertex opposite the edge in the
+* first triangle, the edge, and the vertex opposite it in the second).
+*/
+class FeatureEdges {
+public:
+	/**
+	* Extracts the edges of the triangles in param indices. Vertices at the
+	* same position count as one, so edges are shared across normal seams.
+	* @param crease_angle Angle in degrees between the triangle normals above which an edge is a crease
+	*/
+	FeatureEdges(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, float crease_angle=30.0f);
+	~FeatureEdges();
+
+	inline std::shared_ptr<GLUtils::BO<GL_ELEMENT_ARRAY_BUFFER> > getIndices() {return edge_indices;}
+
+	/**
+	* Draws the boundary and crease edges as lines, from the edge indices
+	* bound to the current vertex array
+	*/
+	void drawFeatureEdges();
+
+	/**
+	* Draws the potential silhouettes as lines with adjacency, from the edge
+	* indices bound to the current vertex array
+	*/
+	void drawSilhouetteCandidates();
+
+	unsigned int getBoundaryCount() {return boundary_count;}
+	unsigned int getCreaseCount() {return crease_count;}
+	unsigned int getSilhouetteCount() {return silhouette_count;}
+
+private:
+	std::shared_ptr<GLUtils::BO<GL_ELEMENT_ARRAY_BUFFER> > edge_indices;
+	unsigned int boundary_count, crease_count, silhouette_count;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _FLIGHTRECORDER_H__
+#define _FLIGHTRECORDER_H__
+
+#include <string>
+#include <vector>
+
+#include "PassQueries.h"
+
+/**
+* Always on record of the last frames, written to disk when a frame goes
+* over the time budget. Each frame keeps its CPU time per pass, the GPU
+* time and pipeline statistics per pass once they are read back, the heap
+* allocations made during it and, built with PG612_GL_COUNTERS, its draw
+* calls.
+*
+* Recording a frame copies it into a ring allocated up front. The heap
+* allocations are counted by the global operator new of FlightRecorder.cpp,
+* at the cost of an atomic increment per allocation.
+*/
+class FlightRecorder {
+public:
+	struct FrameRecord {
+		unsigned int frame;			//< Frame number of PassQueries
+		double time_s;				//< Seconds since the game started
+		double frame_ms;			//< CPU time of the whole frame
+		double cpu_ms[PassQueries::PASS_COUNT];
+		bool gpu_measured;			//< Whether the GPU results below were read back
+		double gpu_ms[PassQueries::PASS_COUNT];
+		GLuint64 primitives[PassQueries::PASS_COUNT];
+		GLuint64 fragments[PassQueries::PASS_COUNT];
+		unsigned int draw_calls;	//< 0 without PG612_GL_COUNTERS
+		unsigned long long allocations;		//< Filled in by recordFrame
+		unsigned long long allocated_bytes; //< Filled in by recordFrame
+	};
+
+	/**
+	* Keeps the last capacity frames. A frame over budget_ms writes them to
+	* <output_prefix><frame>.json, a few frames later so the GPU results of
+	* the slow frame are in
+	*/
+	FlightRecorder(unsigned int capacity=300, double budget_ms=50.0);
+
+	/**
+	* Sets the frame time above which the record is written. 0 never writes it.
+	*/
+	void setBudget(double budget_ms) { this->budget_ms = budget_ms; }
+	double getBudget() { return budget_ms; }
+	void setOutputPrefix(const std::string& prefix) { output_prefix = prefix; }
+
+	/**
+	* Records a frame, with the allocations made since the last one
+	*/
+	void recordFrame(FrameRecord record);
+
+	/**
+	* Adds the GPU results of a recorded frame
+	*/
+	void addGPUResults(const PassQueries::FrameStats& stats);
+
+	unsigned int getDumpCount() { return dumps; }
+
+	/**
+	* Returns the number and total size of heap allocations since the start
+	*/
+	static unsigned long long allocationCount();
+	static unsigned long long allocatedBytes();
+
+private:
+	/**
+	* Writes the record, and the profiler trace if it is enabled
+	*/
+	void dump();
+
+	std::vector<FrameRecord> frames; //< Ring of the last frames
+	unsigned int next;				 //< Ring index of the next frame
+	unsigned int count;				 //< Frames in the ring
+	double budget_ms;
+	std::string output_prefix;
+
+	unsigned long long last_allocations, last_allocated_bytes;
+	unsigned int recorded_frames;
+	int frames_until_dump;			 //< Frames left before writing the record, -1 if none is due
+	unsigned int hitch_frame;		 //< Frame that went over the budget
+	double hitch_ms;
+	double last_dump_s;				 //< time_s of the last written record
+	unsigned int dumps;
+
+	static const unsigned int warmup_frames = 60;  //< Not checked, as loading and first uses are slow
+	static const unsigned int frames_after = 8;	   //< Frames recorded after the slow one before writing
+	static const double dump_cooldown_s;		   //< Minimum time between two written records
+};
+
+#endif
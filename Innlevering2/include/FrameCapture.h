@@ -0,0 +1,66 @@
+#ifndef _FRAMECAPTURE_H__
+#define _FRAMECAPTURE_H__
+
+#include <map>
+#include <string>
+
+#include "GLUtils/GLUtils.hpp"
+
+/**
+* Captures the GL calls of a frame into a trace tools/glreplay replays.
+* The trace starts with a snapshot of every buffer, texture, renderbuffer,
+* framebuffer, vertex array and program with their contents, and of the
+* context state, so that the recorded calls replay from the state the
+* frame began in. Needs PG612_GL_CAPTURE, see GLUtils/GLCapture.hpp.
+*
+* The file is a header of seven words: the magic "PGGL", the version, the
+* size of the window framebuffer and the number of words of each section,
+* followed by the object, state and frame sections. The replayer runs the
+* object section once and the other two every time it replays the frame.
+*/
+class FrameCapture {
+public:
+	/**
+	* Snapshots the objects and state, and begins recording the GL calls.
+	* The param size is that of the window framebuffer.
+	*/
+	FrameCapture(unsigned int width, unsigned int height);
+
+	/**
+	* Stops recording, if write() has not
+	*/
+	~FrameCapture();
+
+	/**
+	* Stops recording and writes the trace to the param file
+	*/
+	void write(const std::string& filename);
+
+	size_t getCallCount() { return GLUtils::glCaptureState().frame.command_count; }
+
+	static bool isAvailable() { return GLUtils::gl_capture_enabled; }
+
+private:
+	void snapshotState();
+	void snapshotBuffers();
+	void snapshotTextures();
+	void snapshotRenderbuffers();
+	void snapshotFramebuffers();
+	void snapshotVertexArrays();
+	void snapshotPrograms();
+
+	/**
+	* Records the param level of the texture bound to the target, of the
+	* param face for cube maps. Returns false if the level has no image.
+	*/
+	bool snapshotTextureLevel(GLenum target, GLenum face, GLint level);
+
+	unsigned int width, height;
+	bool recording;
+
+	GLUtils::GLTraceWriter objects;	//< Creates the objects with their contents
+	GLUtils::GLTraceWriter state;		//< Sets the bindings and state the frame begins with
+	std::map<GLuint, GLenum> texture_targets; //< Target of every texture, for the framebuffer attachments
+};
+
+#endif
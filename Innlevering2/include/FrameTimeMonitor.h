@@ -0,0 +1,97 @@
+#ifndef _FRAMETIMEMONITOR_H__
+#define _FRAMETIMEMONITOR_H__
+
+#include <ostream>
+#include <vector>
+
+/**
+* Rolling statistics of the last frames: a frame time histogram for
+* percentiles, the spread of the frame times, frame pacing, and stutters.
+* All memory is allocated by the constructor, so adding frames and
+* querying allocate nothing.
+*
+* The histogram has log spaced bins from 0.1 ms to 1 s, each about 7%
+* wide, and percentiles are interpolated within a bin.
+*/
+class FrameTimeMonitor {
+public:
+	/**
+	* Statistics of the frames in the window, in milliseconds
+	*/
+	struct Summary {
+		unsigned int frames;  //< Frames in the window
+		double mean_ms;
+		double fps;			  //< Frames per second, from the mean frame time
+		double p50_ms, p95_ms, p99_ms, max_ms;
+		double stdev_ms;	  //< Standard deviation of the frame times
+		double pacing_ms;	  //< Root mean square change from one frame time to the next
+		unsigned int stutters; //< Stutters in the window
+	};
+
+	/**
+	* A frame that took more than the stutter factor times the median
+	*/
+	struct Stutter {
+		unsigned long long frame; //< Frame number, counted from the first added frame
+		double frame_ms;
+		double median_ms;		  //< Median of the window when it happened
+	};
+
+	/**
+	* Keeps the statistics of the last window frames. A frame over
+	* stutter_factor times the median of the window is a stutter.
+	*/
+	FrameTimeMonitor(unsigned int window=600, double stutter_factor=2.0);
+
+	/**
+	* Adds a frame. Returns true if it was a stutter.
+	*/
+	bool addFrame(double frame_ms);
+
+	/**
+	* Returns the frame time the param fraction of the window is within
+	*/
+	double percentile(double fraction) const;
+
+	Summary getSummary() const;
+
+	unsigned long long getTotalFrames() const { return total_frames; }
+	unsigned long long getTotalStutters() const { return total_stutters; }
+
+	/**
+	* Returns the last stutter. Its frame is 0 and frame_ms 0 if there was none.
+	*/
+	const Stutter& getLastStutter() const { return last_stutter; }
+
+	/**
+	* Writes the summary as one line of JSON, tagged with the param time
+	* in seconds, so a log of them can be read line by line
+	*/
+	void writeJSONLine(std::ostream& out, double time_s) const;
+
+private:
+	static const unsigned int bin_count = 128;
+	static const double min_bin_ms;
+	static const double max_bin_ms;
+
+	unsigned int binOf(double frame_ms) const;
+	double binStart(unsigned int bin) const;
+
+	std::vector<double> frame_ms;	//< Ring of the window frame times
+	std::vector<bool> stutter;		//< Whether each frame of the ring was a stutter
+	unsigned int next;				//< Ring index of the next frame
+	unsigned int count;				//< Frames in the ring
+	unsigned int histogram[bin_count];
+	double stutter_factor;
+
+	double sum, sum_squares;		//< Of the frame times in the window
+	double pacing_sum_squares;		//< Of the changes between consecutive frames in the window
+	unsigned int window_stutters;
+
+	unsigned long long total_frames;
+	unsigned long long total_stutters;
+	Stutter last_stutter;
+	double log_bin_scale;			//< bin_count / log(max_bin_ms/min_bin_ms)
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _GBUFFER_HPP__
+#define _GBUFFER_HPP__
+
+#include "GLUtils/GLUtils.hpp"
+
+/**
+* Compact G-buffer for deferred shading, 12 bytes per pixel:
+* color attachment 0: octahedral encoded world space normal (RG16F)
+* color attachment 1: albedo (RGBA8)
+* depth texture (GL_DEPTH_COMPONENT24), from which the position is reconstructed
+*/
+class GBuffer {
+public:
+	GBuffer(unsigned int width, unsigned int height);
+	~GBuffer();
+
+	void bind();
+	static void unbind();
+
+	/**
+	* Binds the normal, albedo and depth textures to texture units
+	* first_unit, first_unit+1 and first_unit+2
+	*/
+	void bindTextures(unsigned int first_unit);
+
+	unsigned int getWidth() {return width; }
+	unsigned int getHeight() {return height; }
+
+private:
+	GLuint fbo;
+	GLuint textures[3]; //< normal, albedo and depth
+	unsigned int width, height;
+};
+
+#endif
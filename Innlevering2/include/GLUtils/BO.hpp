@@ -3,6 +3,8 @@
 
 #include <GL/glew.h>
 
+#include "GLUtils/GLCounters.hpp"
+
 namespace GLUtils {
 
 template <GLenum T>
@@ -0,0 +1,135 @@
+#ifndef _DEBUGOUTPUT_HPP__
+#define _DEBUGOUTPUT_HPP__
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <GL/glew.h>
+
+namespace GLUtils {
+
+/**
+* Returns true if the current context exposes the param extension
+*/
+inline bool hasExtension(const std::string& extension) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for(GLint i = 0; i < count; i++) {
+		if(extension == reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)))
+			return true;
+	}
+	return false;
+}
+
+/**
+* State shared by the debug message callback and CHECK_GL_ERRORS()
+*/
+struct DebugOutputState {
+	DebugOutputState() : enabled(false), file("startup"), line(0) {}
+
+	bool enabled;		//< Whether the KHR_debug callback is installed
+	const char* file;	//< Source location of the last CHECK_GL_ERRORS()
+	unsigned int line;
+	std::string error;	//< First error message since the last CHECK_GL_ERRORS(), thrown by it
+};
+
+inline DebugOutputState& debugOutputState() {
+	static DebugOutputState state;
+	return state;
+}
+
+inline const char* debugSourceName(GLenum source) {
+	switch(source) {
+	case GL_DEBUG_SOURCE_API: return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+	case GL_DEBUG_SOURCE_APPLICATION: return "application";
+	default: return "other";
+	}
+}
+
+inline const char* debugTypeName(GLenum type) {
+	switch(type) {
+	case GL_DEBUG_TYPE_ERROR: return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+	case GL_DEBUG_TYPE_MARKER: return "marker";
+	default: return "other";
+	}
+}
+
+inline const char* debugSeverityName(GLenum severity) {
+	switch(severity) {
+	case GL_DEBUG_SEVERITY_HIGH: return "high";
+	case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+	case GL_DEBUG_SEVERITY_LOW: return "low";
+	default: return "notification";
+	}
+}
+
+/**
+* Prints each message the driver reports. In debug builds the output is
+* synchronous, so the call that caused it is between the last passed
+* CHECK_GL_ERRORS() and the next one, which throws the error.
+*/
+inline void GLAPIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+											 GLsizei length, const GLchar* message, const void* user_param) {
+	DebugOutputState& state = debugOutputState();
+	std::stringstream log;
+	log << "OpenGL " << debugSeverityName(severity) << " severity " << debugTypeName(type)
+		<< " from " << debugSourceName(source) << " (" << id << ")";
+#ifndef NDEBUG
+	log << " after " << state.file << '@' << state.line;
+#endif
+	log << ": " << message;
+	std::cerr << log.str() << std::endl;
+
+	if(type == GL_DEBUG_TYPE_ERROR && state.error.empty())
+		state.error = log.str();
+}
+
+/**
+* Installs the KHR_debug message callback for messages of the param
+* severity and above. Returns false if the context has no KHR_debug, in
+* which case debug builds still find errors through CHECK_GL_ERRORS()
+*/
+inline bool installDebugOutput(GLenum min_severity=GL_DEBUG_SEVERITY_LOW) {
+	if(!hasExtension("GL_KHR_debug") || glDebugMessageCallback == NULL)
+		return false;
+
+	glEnable(GL_DEBUG_OUTPUT);
+#ifndef NDEBUG
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+	glDebugMessageCallback(debugMessageCallback, NULL);
+
+	//Severities from the highest down, enabling those up to the param one
+	GLenum severities[] = {GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM,
+						   GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_NOTIFICATION};
+	bool enable = true;
+	for(unsigned int i = 0; i < 4; i++) {
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severities[i], 0, NULL, enable ? GL_TRUE : GL_FALSE);
+		if(severities[i] == min_severity)
+			enable = false;
+	}
+
+	debugOutputState().enabled = true;
+	return true;
+}
+
+/**
+* Names the param object (e.g. GL_PROGRAM, GL_TEXTURE or GL_FRAMEBUFFER) in
+* debug messages and debuggers. Does nothing without KHR_debug.
+*/
+inline void labelObject(GLenum identifier, GLuint name, const std::string& label) {
+	if(debugOutputState().enabled)
+		glObjectLabel(identifier, name, static_cast<GLsizei>(label.size()), label.c_str());
+}
+
+}; //Namespace GLUtils
+
+#endif
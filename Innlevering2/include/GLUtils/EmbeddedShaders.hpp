@@ -0,0 +1,82 @@
+#ifndef _EMBEDDEDSHADERS_HPP__
+#define _EMBEDDEDSHADERS_HPP__
+
+#include <cstring>
+#include <string>
+
+namespace GLUtils {
+
+/**
+* 64 bit FNV-1a hash of the param string, continuing from the param hash.
+* Evaluated at compile time for string literals
+*/
+constexpr unsigned long long hashString(const char* str, unsigned long long hash=14695981039346656037ULL) {
+	return (*str == '\0') ? hash : hashString(str+1, (hash ^ static_cast<unsigned char>(*str)) * 1099511628211ULL);
+}
+
+/**
+* 64 bit FNV-1a hash of the param string, continuing from the param hash
+*/
+inline unsigned long long hashString(const std::string& str, unsigned long long hash=14695981039346656037ULL) {
+	for(size_t i = 0; i < str.size(); i++) {
+		hash ^= static_cast<unsigned char>(str[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+* A shader source compiled into the executable
+*/
+struct EmbeddedShader {
+	unsigned long long hash; //< hashString of the name
+	const char* name;		 //< Path the shader is loaded by, e.g. "shaders/phong.frag", NULL for an empty slot
+	const char* source;
+};
+
+/**
+* Every shader below shaders/ in an open addressing table: a shader sits in
+* slot hash & (embedded_shader_slots-1), or in the first empty slot after it.
+* Defined as constexpr data in the generated src/EmbeddedShaders.cpp,
+* written by tools/embed_shaders.py before each build
+*/
+extern const EmbeddedShader embedded_shaders[];
+extern const unsigned int embedded_shader_slots; //< Power of two, at least twice the shader count
+
+/**
+* Returns the embedded source of the param shader path with the param hash,
+* or NULL if the shader was not embedded
+*/
+inline const char* findEmbeddedShader(unsigned long long hash, const char* name) {
+	const unsigned int mask = embedded_shader_slots - 1;
+	for(unsigned int i = 0; i < embedded_shader_slots; i++) {
+		const EmbeddedShader& shader = embedded_shaders[(hash + i) & mask];
+		if(shader.name == NULL)
+			return NULL;
+		if(shader.hash == hash && std::strcmp(shader.name, name) == 0)
+			return shader.source;
+	}
+	return NULL;
+}
+
+/**
+* Returns the embedded source of the param shader path, or NULL if the
+* shader was not embedded
+*/
+inline const char* findEmbeddedShader(const std::string& name) {
+	return findEmbeddedShader(hashString(name), name.c_str());
+}
+
+/**
+* Directory shader files are read from before the embedded ones, so shaders
+* can be edited without rebuilding. Empty (the default) uses only the
+* embedded shaders.
+*/
+inline std::string& shaderOverrideDirectory() {
+	static std::string directory;
+	return directory;
+}
+
+}; //Namespace GLUtils
+
+#endif
@@ -0,0 +1,780 @@
+#ifndef _GLCAPTURE_HPP__
+#define _GLCAPTURE_HPP__
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+/**
+* Frame capture of the GL calls. Built with PG612_GL_CAPTURE, the calls
+* that draw, bind, set state, upload uniforms or create and fill objects
+* in every file including this are recorded while a capture is active,
+* with their parameters and the client memory they read. When no capture
+* is active each wrapped call costs one branch. FrameCapture adds a
+* snapshot of the objects and state the frame starts from, and
+* tools/glreplay replays the result.
+*
+* A trace is a stream of 32 bit words. Each call is its command id, the
+* number of words of its arguments, and the arguments: integers as they
+* are, floats by their bits, and blobs of memory as their byte count
+* followed by the bytes padded to a whole word. Pointers into buffer
+* objects are stored as offsets. Queries are not recorded, the replayer
+* measures the frame with its own.
+*/
+namespace GLUtils {
+
+#ifdef PG612_GL_CAPTURE
+static const bool gl_capture_enabled = true;
+#else
+static const bool gl_capture_enabled = false;
+#endif
+
+static const GLuint gl_trace_magic = 0x4C474750; //< "PGGL"
+static const GLuint gl_trace_version = 1;
+
+enum GLTraceCommand {
+	GLTRACE_GEN_BUFFERS = 1,
+	GLTRACE_GEN_TEXTURES,
+	GLTRACE_GEN_VERTEX_ARRAYS,
+	GLTRACE_GEN_FRAMEBUFFERS,
+	GLTRACE_GEN_RENDERBUFFERS,
+	GLTRACE_DELETE_BUFFERS,
+	GLTRACE_DELETE_TEXTURES,
+	GLTRACE_DELETE_VERTEX_ARRAYS,
+	GLTRACE_DELETE_FRAMEBUFFERS,
+	GLTRACE_DELETE_RENDERBUFFERS,
+
+	GLTRACE_BIND_BUFFER,
+	GLTRACE_BIND_BUFFER_BASE,
+	GLTRACE_BUFFER_DATA,
+	GLTRACE_BUFFER_SUB_DATA,
+
+	GLTRACE_ACTIVE_TEXTURE,
+	GLTRACE_BIND_TEXTURE,
+	GLTRACE_TEX_IMAGE_2D,
+	GLTRACE_TEX_IMAGE_3D,
+	GLTRACE_TEX_PARAMETERI,
+	GLTRACE_TEX_BUFFER,
+
+	GLTRACE_BIND_RENDERBUFFER,
+	GLTRACE_RENDERBUFFER_STORAGE,
+	GLTRACE_RENDERBUFFER_STORAGE_MULTISAMPLE,
+	GLTRACE_BIND_FRAMEBUFFER,
+	GLTRACE_FRAMEBUFFER_TEXTURE,
+	GLTRACE_FRAMEBUFFER_TEXTURE_2D,
+	GLTRACE_FRAMEBUFFER_TEXTURE_LAYER,
+	GLTRACE_FRAMEBUFFER_RENDERBUFFER,
+	GLTRACE_DRAW_BUFFER,
+	GLTRACE_DRAW_BUFFERS,
+	GLTRACE_READ_BUFFER,
+
+	GLTRACE_BIND_VERTEX_ARRAY,
+	GLTRACE_VERTEX_ATTRIB_POINTER,
+	GLTRACE_VERTEX_ATTRIB_I_POINTER,
+	GLTRACE_VERTEX_ATTRIB_DIVISOR,
+	GLTRACE_ENABLE_VERTEX_ATTRIB_ARRAY,
+
+	GLTRACE_CREATE_PROGRAM,			//< Program, stages of type and source, attributes of location and name
+	GLTRACE_PROGRAM_UNIFORM,		//< Program, location in the capture and uniform name
+	GLTRACE_UNIFORM_BLOCK_BINDING,	//< Program, binding and block name
+	GLTRACE_UNIFORM_VALUE,			//< Location, uniform type and the values of the current program
+	GLTRACE_USE_PROGRAM,
+	GLTRACE_UNIFORM_1I,
+	GLTRACE_UNIFORM_1F,
+	GLTRACE_UNIFORM_2F,
+	GLTRACE_UNIFORM_2FV,
+	GLTRACE_UNIFORM_3FV,
+	GLTRACE_UNIFORM_3IV,
+	GLTRACE_UNIFORM_MATRIX_4FV,
+
+	GLTRACE_ENABLE,
+	GLTRACE_DISABLE,
+	GLTRACE_VIEWPORT,
+	GLTRACE_SCISSOR,
+	GLTRACE_DEPTH_FUNC,
+	GLTRACE_DEPTH_MASK,
+	GLTRACE_COLOR_MASK,
+	GLTRACE_BLEND_FUNC,
+	GLTRACE_BLEND_FUNC_SEPARATE,
+	GLTRACE_BLEND_EQUATION_SEPARATE,
+	GLTRACE_CULL_FACE,
+	GLTRACE_FRONT_FACE,
+	GLTRACE_POLYGON_MODE,
+	GLTRACE_POLYGON_OFFSET,
+	GLTRACE_PIXEL_STOREI,
+	GLTRACE_CLEAR_COLOR,
+	GLTRACE_CLEAR_DEPTH,
+	GLTRACE_CLEAR,
+
+	GLTRACE_DRAW_ARRAYS,
+	GLTRACE_DRAW_ELEMENTS,
+
+	GLTRACE_COMMAND_COUNT
+};
+
+/**
+* Trace being written
+*/
+class GLTraceWriter {
+public:
+	GLTraceWriter() : command_start(0), command_count(0) {}
+
+	void begin(GLTraceCommand command) {
+		words.push_back(command);
+		words.push_back(0);
+		command_start = words.size();
+		command_count++;
+	}
+
+	/**
+	* Ends the command begun last, storing its length
+	*/
+	void end() {
+		words.at(command_start-1) = static_cast<GLuint>(words.size() - command_start);
+	}
+
+	void arg(GLuint value) { words.push_back(value); }
+	void arg(GLint value) { words.push_back(static_cast<GLuint>(value)); }
+	void arg(GLboolean value) { words.push_back(value); }
+	void arg(GLfloat value) {
+		GLuint bits;
+		std::memcpy(&bits, &value, sizeof(GLuint));
+		words.push_back(bits);
+	}
+
+	void blob(const void* data, size_t bytes) {
+		words.push_back(static_cast<GLuint>(bytes));
+		size_t first = words.size();
+		words.resize(first + (bytes+3)/4, 0);
+		if(bytes > 0)
+			std::memcpy(&words[first], data, bytes);
+	}
+
+	void string(const std::string& str) { blob(str.c_str(), str.size()); }
+
+	/**
+	* Writes a whole command of plain arguments
+	*/
+	template <typename... Args>
+	void call(GLTraceCommand command, Args... args) {
+		begin(command);
+		int expand[] = {0, (arg(args), 0)...};
+		(void) expand;
+		end();
+	}
+
+	void clear() { words.clear(); command_count = 0; }
+
+	std::vector<GLuint> words;
+	size_t command_start; //< First argument word of the command begun last
+	size_t command_count;
+};
+
+/**
+* Preprocessed shader sources of a program, which the driver does not
+* keep once the shaders are detached
+*/
+struct GLProgramSources {
+	std::vector<GLenum> types;
+	std::vector<std::string> sources;
+};
+
+struct GLCaptureState {
+	GLCaptureState() : active(false), window_framebuffer(0) {}
+
+	bool active;
+	GLuint window_framebuffer; //< Framebuffer the frame is shown from, recorded as framebuffer 0
+	GLTraceWriter frame; //< Calls recorded since the capture began
+	std::map<GLuint, GLProgramSources> program_sources;
+};
+
+inline GLCaptureState& glCaptureState() {
+	static GLCaptureState capture_state;
+	return capture_state;
+}
+
+/**
+* Keeps the sources of the param program for the capture snapshot
+*/
+inline void registerProgramSources(GLuint program, const std::vector<GLenum>& types, const std::vector<std::string>& sources) {
+#ifdef PG612_GL_CAPTURE
+	GLProgramSources& program_sources = glCaptureState().program_sources[program];
+	program_sources.types = types;
+	program_sources.sources = sources;
+#endif
+}
+
+/**
+* Returns the bytes per pixel of client memory of the param format and type
+*/
+inline unsigned int glPixelSize(GLenum format, GLenum type) {
+	switch(type) {
+	case GL_UNSIGNED_BYTE_3_3_2:
+	case GL_UNSIGNED_BYTE_2_3_3_REV:
+		return 1;
+	case GL_UNSIGNED_SHORT_5_6_5:
+	case GL_UNSIGNED_SHORT_5_6_5_REV:
+	case GL_UNSIGNED_SHORT_4_4_4_4:
+	case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+	case GL_UNSIGNED_SHORT_5_5_5_1:
+	case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+		return 2;
+	case GL_UNSIGNED_INT_8_8_8_8:
+	case GL_UNSIGNED_INT_8_8_8_8_REV:
+	case GL_UNSIGNED_INT_10_10_10_2:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_24_8:
+	case GL_UNSIGNED_INT_10F_11F_11F_REV:
+	case GL_UNSIGNED_INT_5_9_9_9_REV:
+		return 4;
+	case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+		return 8;
+	}
+
+	unsigned int components;
+	switch(format) {
+	case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER:
+	case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+		components = 1;
+		break;
+	case GL_RG: case GL_RG_INTEGER:
+		components = 2;
+		break;
+	case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+		components = 3;
+		break;
+	default:
+		components = 4;
+	}
+
+	switch(type) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return components;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2*components;
+	default:
+		return 4*components;
+	}
+}
+
+/**
+* Returns the bytes of client memory an image of the param size is read
+* from, with rows aligned to the param alignment. The last row is not padded.
+*/
+inline size_t glImageSize(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, GLint alignment) {
+	if(width <= 0 || height <= 0 || depth <= 0)
+		return 0;
+	size_t pixel = glPixelSize(format, type);
+	size_t row = (width*pixel + alignment-1)/alignment*alignment;
+	return row*(height*depth-1) + width*pixel;
+}
+
+/**
+* Returns the number of components of a uniform of the param type, and its
+* base type (GL_FLOAT, GL_INT or GL_UNSIGNED_INT) in base_type. Samplers and
+* bools are ints. Returns 0 for types the capture does not handle.
+*/
+inline unsigned int glUniformComponents(GLenum type, GLenum& base_type) {
+	base_type = GL_FLOAT;
+	switch(type) {
+	case GL_FLOAT: return 1;
+	case GL_FLOAT_VEC2: return 2;
+	case GL_FLOAT_VEC3: return 3;
+	case GL_FLOAT_VEC4: return 4;
+	case GL_FLOAT_MAT2: return 4;
+	case GL_FLOAT_MAT3: return 9;
+	case GL_FLOAT_MAT4: return 16;
+	case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 6;
+	case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 8;
+	case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 12;
+	}
+
+	base_type = GL_UNSIGNED_INT;
+	switch(type) {
+	case GL_UNSIGNED_INT: return 1;
+	case GL_UNSIGNED_INT_VEC2: return 2;
+	case GL_UNSIGNED_INT_VEC3: return 3;
+	case GL_UNSIGNED_INT_VEC4: return 4;
+	}
+
+	base_type = GL_INT;
+	switch(type) {
+	case GL_INT: case GL_BOOL: return 1;
+	case GL_INT_VEC2: case GL_BOOL_VEC2: return 2;
+	case GL_INT_VEC3: case GL_BOOL_VEC3: return 3;
+	case GL_INT_VEC4: case GL_BOOL_VEC4: return 4;
+	case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW: case GL_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+	case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+	case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		return 1;
+	}
+	return 0;
+}
+
+#ifdef PG612_GL_CAPTURE
+/**
+* Records a call of plain arguments, if a capture is active
+*/
+template <typename... Args>
+inline void traceCall(GLTraceCommand command, Args... args) {
+	GLCaptureState& capture = glCaptureState();
+	if(capture.active)
+		capture.frame.call(command, args...);
+}
+
+inline void traceNames(GLTraceCommand command, GLsizei n, const GLuint* names) {
+	GLCaptureState& capture = glCaptureState();
+	if(!capture.active)
+		return;
+	capture.frame.begin(command);
+	capture.frame.arg(n);
+	for(GLsizei i = 0; i < n; i++)
+		capture.frame.arg(names[i]);
+	capture.frame.end();
+}
+
+inline void traceValues(GLTraceCommand command, GLint location, GLsizei count, const void* values, size_t bytes) {
+	GLCaptureState& capture = glCaptureState();
+	if(!capture.active)
+		return;
+	capture.frame.begin(command);
+	capture.frame.arg(location);
+	capture.frame.arg(count);
+	capture.frame.blob(values, bytes);
+	capture.frame.end();
+}
+
+//The wrappers call the GL functions as they are defined before the
+//capture macros below replace them
+inline void capturedGenBuffers(GLsizei n, GLuint* names) {
+	glGenBuffers(n, names);
+	traceNames(GLTRACE_GEN_BUFFERS, n, names);
+}
+
+inline void capturedGenTextures(GLsizei n, GLuint* names) {
+	glGenTextures(n, names);
+	traceNames(GLTRACE_GEN_TEXTURES, n, names);
+}
+
+inline void capturedGenVertexArrays(GLsizei n, GLuint* names) {
+	glGenVertexArrays(n, names);
+	traceNames(GLTRACE_GEN_VERTEX_ARRAYS, n, names);
+}
+
+inline void capturedGenFramebuffers(GLsizei n, GLuint* names) {
+	glGenFramebuffers(n, names);
+	traceNames(GLTRACE_GEN_FRAMEBUFFERS, n, names);
+}
+
+inline void capturedGenRenderbuffers(GLsizei n, GLuint* names) {
+	glGenRenderbuffers(n, names);
+	traceNames(GLTRACE_GEN_RENDERBUFFERS, n, names);
+}
+
+inline void capturedDeleteBuffers(GLsizei n, const GLuint* names) {
+	traceNames(GLTRACE_DELETE_BUFFERS, n, names);
+	glDeleteBuffers(n, names);
+}
+
+inline void capturedDeleteTextures(GLsizei n, const GLuint* names) {
+	traceNames(GLTRACE_DELETE_TEXTURES, n, names);
+	glDeleteTextures(n, names);
+}
+
+inline void capturedDeleteVertexArrays(GLsizei n, const GLuint* names) {
+	traceNames(GLTRACE_DELETE_VERTEX_ARRAYS, n, names);
+	glDeleteVertexArrays(n, names);
+}
+
+inline void capturedDeleteFramebuffers(GLsizei n, const GLuint* names) {
+	traceNames(GLTRACE_DELETE_FRAMEBUFFERS, n, names);
+	glDeleteFramebuffers(n, names);
+}
+
+inline void capturedDeleteRenderbuffers(GLsizei n, const GLuint* names) {
+	traceNames(GLTRACE_DELETE_RENDERBUFFERS, n, names);
+	glDeleteRenderbuffers(n, names);
+}
+
+inline void capturedBindBuffer(GLenum target, GLuint buffer) {
+	traceCall(GLTRACE_BIND_BUFFER, target, buffer);
+	glBindBuffer(target, buffer);
+}
+
+inline void capturedBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+	traceCall(GLTRACE_BIND_BUFFER_BASE, target, index, buffer);
+	glBindBufferBase(target, index, buffer);
+}
+
+inline void capturedBufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage) {
+	GLCaptureState& capture = glCaptureState();
+	if(capture.active) {
+		capture.frame.begin(GLTRACE_BUFFER_DATA);
+		capture.frame.arg(target);
+		capture.frame.arg(static_cast<GLuint>(size));
+		capture.frame.arg(usage);
+		capture.frame.blob(data, data != NULL ? size : 0);
+		capture.frame.end();
+	}
+	glBufferData(target, size, data, usage);
+}
+
+inline void capturedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data) {
+	GLCaptureState& capture = glCaptureState();
+	if(capture.active) {
+		capture.frame.begin(GLTRACE_BUFFER_SUB_DATA);
+		capture.frame.arg(target);
+		capture.frame.arg(static_cast<GLuint>(offset));
+		capture.frame.blob(data, size);
+		capture.frame.end();
+	}
+	glBufferSubData(target, offset, size, data);
+}
+
+inline void capturedActiveTexture(GLenum texture) {
+	traceCall(GLTRACE_ACTIVE_TEXTURE, texture);
+	glActiveTexture(texture);
+}
+
+inline void capturedBindTexture(GLenum target, GLuint texture) {
+	traceCall(GLTRACE_BIND_TEXTURE, target, texture);
+	glBindTexture(target, texture);
+}
+
+/**
+* Records the pixels the call reads from client memory, which assumes no
+* pixel unpack buffer is bound
+*/
+inline void capturedTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+	GLint border, GLenum format, GLenum type, const GLvoid* pixels) {
+	GLCaptureState& capture = glCaptureState();
+	if(capture.active) {
+		GLint alignment = 4;
+		if(pixels != NULL)
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		capture.frame.begin(GLTRACE_TEX_IMAGE_2D);
+		capture.frame.arg(target);
+		capture.frame.arg(level);
+		capture.frame.arg(internalformat);
+		capture.frame.arg(width);
+		capture.frame.arg(height);
+		capture.frame.arg(border);
+		capture.frame.arg(format);
+		capture.frame.arg(type);
+		capture.frame.blob(pixels, pixels != NULL ? glImageSize(width, height, 1, format, type, alignment) : 0);
+		capture.frame.end();
+	}
+	glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+inline void capturedTexParameteri(GLenum target, GLenum pname, GLint param) {
+	traceCall(GLTRACE_TEX_PARAMETERI, target, pname, param);
+	glTexParameteri(target, pname, param);
+}
+
+inline void capturedTexBuffer(GLenum target, GLenum internalformat, GLuint buffer) {
+	traceCall(GLTRACE_TEX_BUFFER, target, internalformat, buffer);
+	glTexBuffer(target, internalformat, buffer);
+}
+
+inline void capturedBindRenderbuffer(GLenum target, GLuint renderbuffer) {
+	traceCall(GLTRACE_BIND_RENDERBUFFER, target, renderbuffer);
+	glBindRenderbuffer(target, renderbuffer);
+}
+
+inline void capturedRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {
+	traceCall(GLTRACE_RENDERBUFFER_STORAGE, target, internalformat, width, height);
+	glRenderbufferStorage(target, internalformat, width, height);
+}
+
+inline void capturedBindFramebuffer(GLenum target, GLuint framebuffer) {
+	GLuint window_framebuffer = glCaptureState().window_framebuffer;
+	traceCall(GLTRACE_BIND_FRAMEBUFFER, target, framebuffer == window_framebuffer ? 0 : framebuffer);
+	glBindFramebuffer(target, framebuffer);
+}
+
+inline void capturedFramebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) {
+	traceCall(GLTRACE_FRAMEBUFFER_TEXTURE, target, attachment, texture, level);
+	glFramebufferTexture(target, attachment, texture, level);
+}
+
+inline void capturedFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+	traceCall(GLTRACE_FRAMEBUFFER_TEXTURE_2D, target, attachment, textarget, texture, level);
+	glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+inline void capturedFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) {
+	traceCall(GLTRACE_FRAMEBUFFER_RENDERBUFFER, target, attachment, renderbuffertarget, renderbuffer);
+	glFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+}
+
+inline void capturedDrawBuffer(GLenum mode) {
+	traceCall(GLTRACE_DRAW_BUFFER, mode);
+	glDrawBuffer(mode);
+}
+
+inline void capturedDrawBuffers(GLsizei n, const GLenum* bufs) {
+	traceNames(GLTRACE_DRAW_BUFFERS, n, bufs);
+	glDrawBuffers(n, bufs);
+}
+
+inline void capturedReadBuffer(GLenum mode) {
+	traceCall(GLTRACE_READ_BUFFER, mode);
+	glReadBuffer(mode);
+}
+
+inline void capturedBindVertexArray(GLuint vao) {
+	traceCall(GLTRACE_BIND_VERTEX_ARRAY, vao);
+	glBindVertexArray(vao);
+}
+
+inline void capturedVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer) {
+	traceCall(GLTRACE_VERTEX_ATTRIB_POINTER, index, size, type, normalized, stride,
+		static_cast<GLuint>(reinterpret_cast<size_t>(pointer)));
+	glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+inline void capturedEnableVertexAttribArray(GLuint index) {
+	traceCall(GLTRACE_ENABLE_VERTEX_ATTRIB_ARRAY, index);
+	glEnableVertexAttribArray(index);
+}
+
+inline void capturedUseProgram(GLuint program) {
+	traceCall(GLTRACE_USE_PROGRAM, program);
+	glUseProgram(program);
+}
+
+inline void capturedUniform1i(GLint location, GLint v0) {
+	traceCall(GLTRACE_UNIFORM_1I, location, v0);
+	glUniform1i(location, v0);
+}
+
+inline void capturedUniform1f(GLint location, GLfloat v0) {
+	traceCall(GLTRACE_UNIFORM_1F, location, v0);
+	glUniform1f(location, v0);
+}
+
+inline void capturedUniform2f(GLint location, GLfloat v0, GLfloat v1) {
+	traceCall(GLTRACE_UNIFORM_2F, location, v0, v1);
+	glUniform2f(location, v0, v1);
+}
+
+inline void capturedUniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+	traceValues(GLTRACE_UNIFORM_2FV, location, count, value, 2*count*sizeof(GLfloat));
+	glUniform2fv(location, count, value);
+}
+
+inline void capturedUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+	traceValues(GLTRACE_UNIFORM_3FV, location, count, value, 3*count*sizeof(GLfloat));
+	glUniform3fv(location, count, value);
+}
+
+inline void capturedUniform3iv(GLint location, GLsizei count, const GLint* value) {
+	traceValues(GLTRACE_UNIFORM_3IV, location, count, value, 3*count*sizeof(GLint));
+	glUniform3iv(location, count, value);
+}
+
+inline void capturedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+	GLCaptureState& capture = glCaptureState();
+	if(capture.active) {
+		capture.frame.begin(GLTRACE_UNIFORM_MATRIX_4FV);
+		capture.frame.arg(location);
+		capture.frame.arg(count);
+		capture.frame.arg(transpose);
+		capture.frame.blob(value, 16*count*sizeof(GLfloat));
+		capture.frame.end();
+	}
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+inline void capturedEnable(GLenum cap) {
+	traceCall(GLTRACE_ENABLE, cap);
+	glEnable(cap);
+}
+
+inline void capturedDisable(GLenum cap) {
+	traceCall(GLTRACE_DISABLE, cap);
+	glDisable(cap);
+}
+
+inline void capturedViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	traceCall(GLTRACE_VIEWPORT, x, y, width, height);
+	glViewport(x, y, width, height);
+}
+
+inline void capturedDepthFunc(GLenum func) {
+	traceCall(GLTRACE_DEPTH_FUNC, func);
+	glDepthFunc(func);
+}
+
+inline void capturedDepthMask(GLboolean flag) {
+	traceCall(GLTRACE_DEPTH_MASK, flag);
+	glDepthMask(flag);
+}
+
+inline void capturedColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+	traceCall(GLTRACE_COLOR_MASK, red, green, blue, alpha);
+	glColorMask(red, green, blue, alpha);
+}
+
+inline void capturedBlendFunc(GLenum sfactor, GLenum dfactor) {
+	traceCall(GLTRACE_BLEND_FUNC, sfactor, dfactor);
+	glBlendFunc(sfactor, dfactor);
+}
+
+inline void capturedPolygonMode(GLenum face, GLenum mode) {
+	traceCall(GLTRACE_POLYGON_MODE, face, mode);
+	glPolygonMode(face, mode);
+}
+
+inline void capturedPolygonOffset(GLfloat factor, GLfloat units) {
+	traceCall(GLTRACE_POLYGON_OFFSET, factor, units);
+	glPolygonOffset(factor, units);
+}
+
+inline void capturedClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha) {
+	traceCall(GLTRACE_CLEAR_COLOR, red, green, blue, alpha);
+	glClearColor(red, green, blue, alpha);
+}
+
+inline void capturedClear(GLbitfield mask) {
+	traceCall(GLTRACE_CLEAR, mask);
+	glClear(mask);
+}
+
+inline void capturedDrawArrays(GLenum mode, GLint first, GLsizei count) {
+	traceCall(GLTRACE_DRAW_ARRAYS, mode, first, count);
+	glDrawArrays(mode, first, count);
+}
+
+inline void capturedDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+	traceCall(GLTRACE_DRAW_ELEMENTS, mode, count, type,
+		static_cast<GLuint>(reinterpret_cast<size_t>(indices)));
+	glDrawElements(mode, count, type, indices);
+}
+#endif
+
+}; //Namespace GLUtils
+
+#ifdef PG612_GL_CAPTURE
+//GLEW defines most entry points as macros, so they are undefined first
+#undef glGenBuffers
+#undef glGenTextures
+#undef glGenVertexArrays
+#undef glGenFramebuffers
+#undef glGenRenderbuffers
+#undef glDeleteBuffers
+#undef glDeleteTextures
+#undef glDeleteVertexArrays
+#undef glDeleteFramebuffers
+#undef glDeleteRenderbuffers
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBufferData
+#undef glBufferSubData
+#undef glActiveTexture
+#undef glBindTexture
+#undef glTexImage2D
+#undef glTexParameteri
+#undef glTexBuffer
+#undef glBindRenderbuffer
+#undef glRenderbufferStorage
+#undef glBindFramebuffer
+#undef glFramebufferTexture
+#undef glFramebufferTexture2D
+#undef glFramebufferRenderbuffer
+#undef glDrawBuffer
+#undef glDrawBuffers
+#undef glReadBuffer
+#undef glBindVertexArray
+#undef glVertexAttribPointer
+#undef glEnableVertexAttribArray
+#undef glUseProgram
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform2fv
+#undef glUniform3fv
+#undef glUniform3iv
+#undef glUniformMatrix4fv
+#undef glEnable
+#undef glDisable
+#undef glViewport
+#undef glDepthFunc
+#undef glDepthMask
+#undef glColorMask
+#undef glBlendFunc
+#undef glPolygonMode
+#undef glPolygonOffset
+#undef glClearColor
+#undef glClear
+#undef glDrawArrays
+#undef glDrawElements
+#define glGenBuffers GLUtils::capturedGenBuffers
+#define glGenTextures GLUtils::capturedGenTextures
+#define glGenVertexArrays GLUtils::capturedGenVertexArrays
+#define glGenFramebuffers GLUtils::capturedGenFramebuffers
+#define glGenRenderbuffers GLUtils::capturedGenRenderbuffers
+#define glDeleteBuffers GLUtils::capturedDeleteBuffers
+#define glDeleteTextures GLUtils::capturedDeleteTextures
+#define glDeleteVertexArrays GLUtils::capturedDeleteVertexArrays
+#define glDeleteFramebuffers GLUtils::capturedDeleteFramebuffers
+#define glDeleteRenderbuffers GLUtils::capturedDeleteRenderbuffers
+#define glBindBuffer GLUtils::capturedBindBuffer
+#define glBindBufferBase GLUtils::capturedBindBufferBase
+#define glBufferData GLUtils::capturedBufferData
+#define glBufferSubData GLUtils::capturedBufferSubData
+#define glActiveTexture GLUtils::capturedActiveTexture
+#define glBindTexture GLUtils::capturedBindTexture
+#define glTexImage2D GLUtils::capturedTexImage2D
+#define glTexParameteri GLUtils::capturedTexParameteri
+#define glTexBuffer GLUtils::capturedTexBuffer
+#define glBindRenderbuffer GLUtils::capturedBindRenderbuffer
+#define glRenderbufferStorage GLUtils::capturedRenderbufferStorage
+#define glBindFramebuffer GLUtils::capturedBindFramebuffer
+#define glFramebufferTexture GLUtils::capturedFramebufferTexture
+#define glFramebufferTexture2D GLUtils::capturedFramebufferTexture2D
+#define glFramebufferRenderbuffer GLUtils::capturedFramebufferRenderbuffer
+#define glDrawBuffer GLUtils::capturedDrawBuffer
+#define glDrawBuffers GLUtils::capturedDrawBuffers
+#define glReadBuffer GLUtils::capturedReadBuffer
+#define glBindVertexArray GLUtils::capturedBindVertexArray
+#define glVertexAttribPointer GLUtils::capturedVertexAttribPointer
+#define glEnableVertexAttribArray GLUtils::capturedEnableVertexAttribArray
+#define glUseProgram GLUtils::capturedUseProgram
+#define glUniform1i GLUtils::capturedUniform1i
+#define glUniform1f GLUtils::capturedUniform1f
+#define glUniform2f GLUtils::capturedUniform2f
+#define glUniform2fv GLUtils::capturedUniform2fv
+#define glUniform3fv GLUtils::capturedUniform3fv
+#define glUniform3iv GLUtils::capturedUniform3iv
+#define glUniformMatrix4fv GLUtils::capturedUniformMatrix4fv
+#define glEnable GLUtils::capturedEnable
+#define glDisable GLUtils::capturedDisable
+#define glViewport GLUtils::capturedViewport
+#define glDepthFunc GLUtils::capturedDepthFunc
+#define glDepthMask GLUtils::capturedDepthMask
+#define glColorMask GLUtils::capturedColorMask
+#define glBlendFunc GLUtils::capturedBlendFunc
+#define glPolygonMode GLUtils::capturedPolygonMode
+#define glPolygonOffset GLUtils::capturedPolygonOffset
+#define glClearColor GLUtils::capturedClearColor
+#define glClear GLUtils::capturedClear
+#define glDrawArrays GLUtils::capturedDrawArrays
+#define glDrawElements GLUtils::capturedDrawElements
+#endif
+
+#endif
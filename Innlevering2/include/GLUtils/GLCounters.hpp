@@ -0,0 +1,240 @@
+#ifndef _GLCOUNTERS_HPP__
+#define _GLCOUNTERS_HPP__
+
+#include <GL/glew.h>
+
+#include "GLUtils/GLCapture.hpp"
+
+/**
+* Instrumentation of the GL calls that cost CPU time to submit. Built with
+* PG612_GL_COUNTERS (the debug configuration), the draw, bind, uniform and
+* buffer upload calls of every file including this are counted, separately
+* for each counter slot. PassQueries sets the slot to the pass being
+* rendered. Without it the calls are the plain GL ones and every count
+* stays 0. The counted calls go on to the frame capture of GLCapture.hpp.
+*/
+namespace GLUtils {
+
+#ifdef PG612_GL_COUNTERS
+static const bool gl_counters_enabled = true;
+#else
+static const bool gl_counters_enabled = false;
+#endif
+
+/**
+* Counts of the GL work submitted
+*/
+struct GLCounters {
+	GLCounters() { reset(); }
+
+	void reset() {
+		draw_calls = 0;
+		vertices = triangles = 0;
+		program_binds = vao_binds = texture_binds = framebuffer_binds = 0;
+		uniform_uploads = 0;
+		buffer_bytes = 0;
+	}
+
+	void add(const GLCounters& other) {
+		draw_calls += other.draw_calls;
+		vertices += other.vertices;
+		triangles += other.triangles;
+		program_binds += other.program_binds;
+		vao_binds += other.vao_binds;
+		texture_binds += other.texture_binds;
+		framebuffer_binds += other.framebuffer_binds;
+		uniform_uploads += other.uniform_uploads;
+		buffer_bytes += other.buffer_bytes;
+	}
+
+	unsigned int draw_calls;
+	GLuint64 vertices;			 //< Vertices or indices submitted by the draws
+	GLuint64 triangles;			 //< Triangles submitted, 0 for points and lines
+	unsigned int program_binds;
+	unsigned int vao_binds;
+	unsigned int texture_binds;
+	unsigned int framebuffer_binds;
+	unsigned int uniform_uploads;
+	GLuint64 buffer_bytes;		 //< Bytes passed to glBufferData and glBufferSubData
+};
+
+/**
+* The counters of each slot, and the slot counting now. Slot 0 is the work
+* outside of any pass.
+*/
+struct GLCounterSlots {
+	static const unsigned int slot_count = 8;
+
+	GLCounterSlots() : current(0) {}
+
+	GLCounters slots[slot_count];
+	unsigned int current;
+};
+
+inline GLCounterSlots& glCounterSlots() {
+	static GLCounterSlots counter_slots;
+	return counter_slots;
+}
+
+inline GLCounters& glCounters() {
+	return glCounterSlots().slots[glCounterSlots().current];
+}
+
+inline void setGLCounterSlot(unsigned int slot) {
+#ifdef PG612_GL_COUNTERS
+	glCounterSlots().current = slot < GLCounterSlots::slot_count ? slot : 0;
+#endif
+}
+
+inline const GLCounters& getGLCounters(unsigned int slot) {
+	return glCounterSlots().slots[slot];
+}
+
+/**
+* Returns the sum of all slots
+*/
+inline GLCounters getTotalGLCounters() {
+	GLCounters total;
+	for(unsigned int i = 0; i < GLCounterSlots::slot_count; i++)
+		total.add(glCounterSlots().slots[i]);
+	return total;
+}
+
+inline void resetGLCounters() {
+	for(unsigned int i = 0; i < GLCounterSlots::slot_count; i++)
+		glCounterSlots().slots[i].reset();
+}
+
+#ifdef PG612_GL_COUNTERS
+inline GLuint64 trianglesOf(GLenum mode, GLsizei count) {
+	switch(mode) {
+	case GL_TRIANGLES: return count/3;
+	case GL_TRIANGLES_ADJACENCY: return count/6;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN: return count > 2 ? count-2 : 0;
+	default: return 0;
+	}
+}
+
+inline void countDraw(GLenum mode, GLsizei count) {
+	GLCounters& counters = glCounters();
+	counters.draw_calls++;
+	counters.vertices += count;
+	counters.triangles += trianglesOf(mode, count);
+}
+
+//The wrappers call the GL functions as they are defined before the
+//counting macros below replace them
+inline void countedDrawArrays(GLenum mode, GLint first, GLsizei count) {
+	countDraw(mode, count);
+	glDrawArrays(mode, first, count);
+}
+
+inline void countedDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+	countDraw(mode, count);
+	glDrawElements(mode, count, type, indices);
+}
+
+inline void countedUseProgram(GLuint program) {
+	glCounters().program_binds++;
+	glUseProgram(program);
+}
+
+inline void countedBindVertexArray(GLuint vao) {
+	glCounters().vao_binds++;
+	glBindVertexArray(vao);
+}
+
+inline void countedBindTexture(GLenum target, GLuint texture) {
+	glCounters().texture_binds++;
+	glBindTexture(target, texture);
+}
+
+inline void countedBindFramebuffer(GLenum target, GLuint framebuffer) {
+	glCounters().framebuffer_binds++;
+	glBindFramebuffer(target, framebuffer);
+}
+
+inline void countedBufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage) {
+	glCounters().buffer_bytes += size;
+	glBufferData(target, size, data, usage);
+}
+
+inline void countedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data) {
+	glCounters().buffer_bytes += size;
+	glBufferSubData(target, offset, size, data);
+}
+
+inline void countedUniform1f(GLint location, GLfloat v0) {
+	glCounters().uniform_uploads++;
+	glUniform1f(location, v0);
+}
+
+inline void countedUniform1i(GLint location, GLint v0) {
+	glCounters().uniform_uploads++;
+	glUniform1i(location, v0);
+}
+
+inline void countedUniform2f(GLint location, GLfloat v0, GLfloat v1) {
+	glCounters().uniform_uploads++;
+	glUniform2f(location, v0, v1);
+}
+
+inline void countedUniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+	glCounters().uniform_uploads++;
+	glUniform2fv(location, count, value);
+}
+
+inline void countedUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+	glCounters().uniform_uploads++;
+	glUniform3fv(location, count, value);
+}
+
+inline void countedUniform3iv(GLint location, GLsizei count, const GLint* value) {
+	glCounters().uniform_uploads++;
+	glUniform3iv(location, count, value);
+}
+
+inline void countedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+	glCounters().uniform_uploads++;
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+#endif
+
+}; //Namespace GLUtils
+
+#ifdef PG612_GL_COUNTERS
+//GLEW defines most entry points as macros, so they are undefined first
+#undef glDrawArrays
+#undef glDrawElements
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindTexture
+#undef glBindFramebuffer
+#undef glBufferData
+#undef glBufferSubData
+#undef glUniform1f
+#undef glUniform1i
+#undef glUniform2f
+#undef glUniform2fv
+#undef glUniform3fv
+#undef glUniform3iv
+#undef glUniformMatrix4fv
+#define glDrawArrays GLUtils::countedDrawArrays
+#define glDrawElements GLUtils::countedDrawElements
+#define glUseProgram GLUtils::countedUseProgram
+#define glBindVertexArray GLUtils::countedBindVertexArray
+#define glBindTexture GLUtils::countedBindTexture
+#define glBindFramebuffer GLUtils::countedBindFramebuffer
+#define glBufferData GLUtils::countedBufferData
+#define glBufferSubData GLUtils::countedBufferSubData
+#define glUniform1f GLUtils::countedUniform1f
+#define glUniform1i GLUtils::countedUniform1i
+#define glUniform2f GLUtils::countedUniform2f
+#define glUniform2fv GLUtils::countedUniform2fv
+#define glUniform3fv GLUtils::countedUniform3fv
+#define glUniform3iv GLUtils::countedUniform3iv
+#define glUniformMatrix4fv GLUtils::countedUniformMatrix4fv
+#endif
+
+#endif
@@ -10,13 +10,44 @@
 
 #include <GL/glew.h>
 
+#include "GLUtils/GLCounters.hpp"
+#include "GLUtils/DebugOutput.hpp"
+
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
+/**
+* glGetError stalls the driver, so release builds rely on the KHR_debug
+* callback alone and the check compiles to nothing
+*/
+#ifdef NDEBUG
+#define CHECK_GL_ERRORS() ((void)0)
+#else
 #define CHECK_GL_ERRORS() GLUtils::checkGLErrors(__FILE__, __LINE__)
+#endif
 #define CHECK_GL_FBO_COMPLETENESS() GLUtils::checkGLFBOCompleteness(__FILE__, __LINE__)
 
 namespace GLUtils {
 
+/**
+* Framebuffer the passes return to when they are done with their own FBOs:
+* 0 for the window, or the offscreen framebuffer of a headless context
+*/
+inline GLuint& screenFramebuffer() {
+	static GLuint framebuffer = 0;
+	return framebuffer;
+}
+
 inline void checkGLErrors(const char* file, unsigned int line) {
+	DebugOutputState& state = debugOutputState();
+	state.file = file;
+	state.line = line;
+	if(!state.error.empty()) {
+		std::stringstream log;
+		log << file << '@' << line << ": " << state.error;
+		state.error.clear();
+		while(glGetError() != GL_NO_ERROR);
+		throw std::runtime_error(log.str());
+	}
+
 	GLenum err = glGetError(); 
     if( err != GL_NO_ERROR ) { 
 		std::stringstream log; 
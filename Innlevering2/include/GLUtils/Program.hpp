@@ -1,13 +1,31 @@
 #ifndef _PROGRAM_HPP__
 #define _PROGRAM_HPP__
 
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 #include <iomanip>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include <GL/glew.h>
 
+#include "GLUtils/GLCounters.hpp"
+#include "GLUtils/EmbeddedShaders.hpp"
+#include "GLUtils/DebugOutput.hpp"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace GLUtils {
 
 	
@@ -43,34 +61,197 @@ inline std::string readFile(std::string file) {
 	return contents;
 }
 
+/**
+* Returns the source of the param shader: from the override directory if
+* it holds the file, else the embedded copy, else the file itself
+*/
+inline std::string readShader(const std::string& file) {
+	if(!shaderOverrideDirectory().empty()) {
+		std::string override_file = shaderOverrideDirectory() + "/" + file;
+		if(std::ifstream(override_file.c_str()).good())
+			return readFile(override_file);
+	}
 
+	const char* source = findEmbeddedShader(file);
+	if(source != NULL)
+		return source;
+	return readFile(file);
+}
 
+/**
+* Defines injected into a shader after its #version line, each given
+* as the text following #define, e.g. "PCF_TAPS 4"
+*/
+typedef std::vector<std::string> ShaderDefines;
+
+/**
+* Reads a shader, replacing each #include "file" line with the file, relative
+* to the including one. A file is included only once per shader. The param
+* defines are inserted after the #version line, and #line directives keep the
+* compiler log pointing into the original files: source string i is files[i].
+*/
+inline std::string preprocessShader(const std::string& file, const ShaderDefines& defines, std::vector<std::string>& files) {
+	unsigned int file_index = files.size();
+	files.push_back(file);
+
+	std::string directory;
+	size_t slash = file.find_last_of("/\\");
+	if(slash != std::string::npos)
+		directory = file.substr(0, slash+1);
+
+	std::istringstream source(readShader(file));
+	std::stringstream result;
+	std::string line;
+	unsigned int line_number = 0;
+	bool version_found = false;
+
+	if(file_index > 0)
+		result << "#line 1 " << file_index << std::endl;
+	while(std::getline(source, line)) {
+		line_number++;
+		size_t first = line.find_first_not_of(" \t");
+		std::string directive = (first == std::string::npos) ? "" : line.substr(first);
+
+		if(directive.compare(0, 8, "#version") == 0) {
+			version_found = true;
+			result << line << std::endl;
+			for(unsigned int i = 0; i < defines.size(); i++)
+				result << "#define " << defines.at(i) << std::endl;
+			result << "#line " << line_number+1 << " " << file_index << std::endl;
+		}
+		else if(directive.compare(0, 8, "#include") == 0) {
+			size_t open = directive.find('"');
+			size_t close = directive.find('"', open+1);
+			if(open == std::string::npos || close == std::string::npos)
+				throw std::runtime_error(file + ": malformed " + directive);
+
+			std::string included = directory + directive.substr(open+1, close-open-1);
+			if(std::find(files.begin(), files.end(), included) == files.end()) {
+				result << "//" << directive << " is source string " << files.size() << std::endl;
+				result << preprocessShader(included, ShaderDefines(), files);
+			}
+			result << "#line " << line_number+1 << " " << file_index << std::endl;
+		}
+		else {
+			result << line << std::endl;
+		}
+	}
+
+	//Without a #version line, the defines go first
+	if(file_index == 0 && !version_found && !defines.empty()) {
+		std::stringstream with_defines;
+		for(unsigned int i = 0; i < defines.size(); i++)
+			with_defines << "#define " << defines.at(i) << std::endl;
+		with_defines << "#line 1 0" << std::endl << result.str();
+		return with_defines.str();
+	}
+	return result.str();
+}
+
+inline std::string preprocessShader(const std::string& file, const ShaderDefines& defines) {
+	std::vector<std::string> files;
+	return preprocessShader(file, defines, files);
+}
+
+
+/**
+* A shader program, built in two phases: the constructor submits the
+* shaders for compiling and the program for linking without waiting for
+* either, and finish() waits for the result and reports errors. Drivers
+* with KHR_parallel_shader_compile work on all submitted programs at the
+* same time. Any other use of the program finishes it first.
+*/
 class Program {
 public:
-	Program(std::string vs, std::string fs) {
+	Program(std::string vs, std::string fs, const ShaderDefines& defines=ShaderDefines()) {
 		name = glCreateProgram();
 
-		std::string vs_src = readFile(vs);
-		std::string fs_src = readFile(fs);
-
-		attachShader(vs_src, GL_VERTEX_SHADER);
-		attachShader(fs_src, GL_FRAGMENT_SHADER);
-		link();
+		std::vector<std::string> shader_sources;
+		std::vector<GLenum> types;
+		shader_sources.push_back(preprocessShader(vs, defines));
+		types.push_back(GL_VERTEX_SHADER);
+		shader_sources.push_back(preprocessShader(fs, defines));
+		types.push_back(GL_FRAGMENT_SHADER);
+		build(shader_sources, types, defines);
+		labelObject(GL_PROGRAM, name, vs + " " + fs);
 	}
 
-	Program(std::string vs, std::string gs, std::string fs) {
+	Program(std::string vs, std::string gs, std::string fs, const ShaderDefines& defines=ShaderDefines()) {
 		name = glCreateProgram();
-		std::string vs_src = readFile(vs);
-		std::string gs_src = readFile(gs);
-		std::string fs_src = readFile(fs);
-		
-		attachShader(vs_src, GL_VERTEX_SHADER);
-		attachShader(gs_src, GL_GEOMETRY_SHADER);
-		attachShader(fs_src, GL_FRAGMENT_SHADER);
-		link();
+
+		std::vector<std::string> shader_sources;
+		std::vector<GLenum> types;
+		shader_sources.push_back(preprocessShader(vs, defines));
+		types.push_back(GL_VERTEX_SHADER);
+		shader_sources.push_back(preprocessShader(gs, defines));
+		types.push_back(GL_GEOMETRY_SHADER);
+		shader_sources.push_back(preprocessShader(fs, defines));
+		types.push_back(GL_FRAGMENT_SHADER);
+		build(shader_sources, types, defines);
+		labelObject(GL_PROGRAM, name, vs + " " + gs + " " + fs);
+	}
+
+	/**
+	* Sets the directory linked program binaries are stored in and loaded
+	* from. An empty string (the default) compiles every program from source.
+	*/
+	static void setBinaryCacheDirectory(const std::string& directory) {
+		binaryCacheDirectory() = directory;
+		if(!directory.empty()) {
+#ifdef _WIN32
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+		}
+	}
+
+	/**
+	* Returns the number of programs loaded from the binary cache and the
+	* number compiled from source since the program started
+	*/
+	static unsigned int& binaryCacheHits() { static unsigned int hits = 0; return hits; }
+	static unsigned int& binaryCacheMisses() { static unsigned int misses = 0; return misses; }
+
+	/**
+	* Returns true if the program is compiled and linked, so that finish()
+	* will not block. Without KHR_parallel_shader_compile this can not be
+	* known and is always true.
+	*/
+	bool isReady() {
+		if(finished || !parallelCompile())
+			return true;
+		GLint completed;
+		glGetProgramiv(name, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed == GL_TRUE;
+	}
+
+	/**
+	* Waits until the program is linked, throwing the compile or link log if
+	* that failed, and stores the binary if the program was compiled
+	*/
+	void finish() {
+		if(finished)
+			return;
+		finished = true;
+		for(unsigned int i = 0; i < shaders.size(); i++)
+			checkShader(shaders.at(i), sources.at(i));
+		if(!shaders.empty()) {
+			checkLink();
+			if(!cache_file.empty())
+				storeBinary(cache_file);
+		}
+
+		for(unsigned int i = 0; i < shaders.size(); i++) {
+			glDetachShader(name, shaders.at(i));
+			glDeleteShader(shaders.at(i));
+		}
+		shaders.clear();
+		sources.clear();
 	}
 
 	inline void use() {
+		finish();
 		glUseProgram(name);
 	}
 
@@ -79,12 +260,21 @@ public:
 	}
 
 	inline GLint getUniform(std::string var) {
+		finish();
 		GLint loc = glGetUniformLocation(name, var.c_str());
 		assert(loc >= 0);
 		return loc;
 	}
 
+	inline void setUniformBlockBinding(std::string block, GLuint binding) {
+		finish();
+		GLuint index = glGetUniformBlockIndex(name, block.c_str());
+		assert(index != GL_INVALID_INDEX);
+		glUniformBlockBinding(name, index, binding);
+	}
+
 	inline void setAttributePointer(std::string var, unsigned int size, GLenum type=GL_FLOAT, GLboolean normalized=GL_FALSE, GLsizei stride=0, GLvoid* pointer=NULL) {
+		finish();
 		GLint loc = glGetAttribLocation(name, var.c_str());
 		assert(loc >= 0);
 		glVertexAttribPointer(loc, size, type, normalized, stride, pointer);
@@ -92,9 +282,109 @@ public:
 	}
 
 private:
-	void link() {
-		std::stringstream log;
+	static bool parallelCompile() {
+		static bool supported = hasExtension("GL_KHR_parallel_shader_compile");
+		return supported;
+	}
+
+	static std::string& binaryCacheDirectory() {
+		static std::string directory;
+		return directory;
+	}
+
+	/**
+	* Loads the program from the binary cache if it holds the param sources,
+	* and otherwise submits them for compiling and linking. finish() stores
+	* the linked result in the cache.
+	*/
+	void build(const std::vector<std::string>& shader_sources, const std::vector<GLenum>& types, const ShaderDefines& defines) {
+		finished = false;
+		GLint binary_formats = 0;
+		if(GLEW_ARB_get_program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+		bool use_cache = !binaryCacheDirectory().empty() && binary_formats > 0;
+		registerProgramSources(name, types, shader_sources);
+
+		//A binary is only valid for the driver that created it
+		if(use_cache) {
+			unsigned long long hash = hashString(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+			hash = hashString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)), hash);
+			hash = hashString(reinterpret_cast<const char*>(glGetString(GL_VERSION)), hash);
+			for(unsigned int i = 0; i < defines.size(); i++)
+				hash = hashString(defines.at(i) + "\n", hash);
+			for(unsigned int i = 0; i < shader_sources.size(); i++) {
+				std::stringstream type;
+				type << types.at(i) << "\n";
+				hash = hashString(type.str() + shader_sources.at(i), hash);
+			}
+
+			std::stringstream file;
+			file << binaryCacheDirectory() << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+			cache_file = file.str();
+
+			if(loadBinary(cache_file)) {
+				binaryCacheHits()++;
+				return;
+			}
+			glProgramParameteri(name, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		binaryCacheMisses()++;
+		for(unsigned int i = 0; i < shader_sources.size(); i++)
+			attachShader(shader_sources.at(i), types.at(i));
 		glLinkProgram(name);
+	}
+
+	/**
+	* Returns true if the param file holds a binary the driver accepts
+	*/
+	bool loadBinary(const std::string& file) {
+		std::ifstream is(file.c_str(), std::ios::binary);
+		if(!is.good())
+			return false;
+
+		GLenum format;
+		is.read(reinterpret_cast<char*>(&format), sizeof(GLenum));
+		if(!is.good())
+			return false;
+		std::vector<char> binary((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+		if(binary.empty())
+			return false;
+
+		//A format the driver no longer lists would raise GL_INVALID_ENUM
+		GLint format_count = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+		if(format_count <= 0)
+			return false;
+		std::vector<GLint> formats(format_count);
+		glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats[0]);
+		if(std::find(formats.begin(), formats.end(), static_cast<GLint>(format)) == formats.end())
+			return false;
+
+		//A driver update may still reject the binary, which leaves the program unlinked
+		glProgramBinary(name, format, &binary[0], static_cast<GLsizei>(binary.size()));
+		GLint link_status;
+		glGetProgramiv(name, GL_LINK_STATUS, &link_status);
+		return link_status == GL_TRUE;
+	}
+
+	void storeBinary(const std::string& file) {
+		GLint length = 0;
+		glGetProgramiv(name, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(length <= 0)
+			return;
+
+		GLenum format;
+		std::vector<char> binary(length);
+		glGetProgramBinary(name, length, NULL, &format, &binary[0]);
+
+		std::ofstream os(file.c_str(), std::ios::binary);
+		os.write(reinterpret_cast<const char*>(&format), sizeof(GLenum));
+		os.write(&binary[0], length);
+	}
+
+	void checkLink() {
+		std::stringstream log;
 
 		// check for errors
 		GLint linkstatus;
@@ -117,7 +407,7 @@ private:
 		}
 	}
 
-	void attachShader(std::string& src, unsigned int type) {
+	void attachShader(const std::string& src, unsigned int type) {
 		std::stringstream log;
 		// create shader object
 		GLuint s = glCreateShader(type);
@@ -126,12 +416,18 @@ private:
 			throw std::runtime_error(log.str());
 		}
 
-		// set source code and compile
+		// set source code and compile. The status is checked by finish()
 		const GLchar* src_list[1] = { src.c_str() };
 		glShaderSource(s, 1, src_list, NULL);
 		glCompileShader(s);
+		glAttachShader(name, s);
 
-		// check for errors
+		shaders.push_back(s);
+		sources.push_back(src);
+	}
+
+	void checkShader(GLuint s, const std::string& src) {
+		std::stringstream log;
 		GLint compile_status;
 		glGetShaderiv(s, GL_COMPILE_STATUS, &compile_status);
 		if (compile_status != GL_TRUE) {
@@ -158,11 +454,13 @@ private:
 			}
 			throw std::runtime_error(log.str());
 		}
-		
-		glAttachShader(name, s);
 	}
 
 	GLuint name; //< OpenGL shader program
+	bool finished; //< Whether finish() has checked the compile and link status
+	std::vector<GLuint> shaders; //< Shaders submitted for compiling, until finish()
+	std::vector<std::string> sources; //< Preprocessed source of each shader, for the error log
+	std::string cache_file; //< Binary cache file the linked program is stored in, empty if none
 
 };
 
@@ -0,0 +1,84 @@
+#ifndef _PROGRAMCACHE_HPP__
+#define _PROGRAMCACHE_HPP__
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "GLUtils/Program.hpp"
+
+namespace GLUtils {
+
+/**
+* Programs keyed by their shader files and defines, so each permutation
+* is compiled once, however many times it is asked for
+*/
+class ProgramCache {
+public:
+	std::shared_ptr<Program> get(const std::string& vs, const std::string& fs, const ShaderDefines& defines=ShaderDefines()) {
+		return get(vs, "", fs, defines);
+	}
+
+	/**
+	* Returns the program of the param shaders (gs may be empty for none)
+	* and defines, submitting it for compiling if it is not in the cache
+	*/
+	std::shared_ptr<Program> get(const std::string& vs, const std::string& gs, const std::string& fs, const ShaderDefines& defines=ShaderDefines()) {
+		//The order of the defines does not change the program
+		ShaderDefines sorted_defines = defines;
+		std::sort(sorted_defines.begin(), sorted_defines.end());
+		std::string key = vs + "|" + gs + "|" + fs;
+		for(unsigned int i = 0; i < sorted_defines.size(); i++)
+			key += "|" + sorted_defines.at(i);
+
+		std::map<std::string, std::shared_ptr<Program> >::iterator it = programs.find(key);
+		if(it != programs.end())
+			return it->second;
+
+		std::shared_ptr<Program> program;
+		if(gs.empty())
+			program.reset(new Program(vs, fs, defines));
+		else
+			program.reset(new Program(vs, gs, fs, defines));
+		programs[key] = program;
+		return program;
+	}
+
+	/**
+	* Returns the number of programs still compiling or linking
+	*/
+	unsigned int pending() {
+		unsigned int count = 0;
+		std::map<std::string, std::shared_ptr<Program> >::iterator it;
+		for(it = programs.begin(); it != programs.end(); it++) {
+			if(!it->second->isReady())
+				count++;
+		}
+		return count;
+	}
+
+	/**
+	* Waits for every submitted program, throwing the log of the first that
+	* failed to compile or link
+	*/
+	void finish() {
+		std::map<std::string, std::shared_ptr<Program> >::iterator it;
+		for(it = programs.begin(); it != programs.end(); it++)
+			it->second->finish();
+	}
+
+	/**
+	* Returns the number of compiled permutations
+	*/
+	size_t size() {
+		return programs.size();
+	}
+
+private:
+	std::map<std::string, std::shared_ptr<Program> > programs;
+};
+
+}; //Namespace GLUtils
+
+#endif
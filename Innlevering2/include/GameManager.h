@@ -7,6 +7,7 @@
 #endif
 
 #include <memory>
+#include <fstream>
 
 #include <GL/glew.h>
 #include <SDL.h>
@@ -14,13 +15,29 @@
 
 #include "Timer.h"
 #include "GLUtils/GLUtils.hpp"
+#include "GLUtils/ProgramCache.hpp"
 #include "Model.h"
 #include "VirtualTrackball.h"
 #include "ShadowFBO.h"
+#include "VarianceShadowFBO.h"
+#include "CubeShadowFBO.h"
+#include "ShadowAtlas.h"
+#include "LightClusters.h"
+#include "GBuffer.h"
+#include "FeatureEdges.h"
+#include "HeadlessContext.h"
+#include "Benchmark.h"
+#include "InputLog.h"
+#include "PassQueries.h"
+#include "FrameTimeMonitor.h"
+#include "FlightRecorder.h"
+#include "PerformanceHUD.h"
+#include "FrameCapture.h"
 #include "SliderWithText.h"
 #include "CubeMap.h"
 #include "RadioButtonCollection.h"
 #include "Game_Constants.h"
+#include "AABB.h"
 
 /**
  * This class handles the game logic and display.
@@ -46,16 +63,77 @@ public:
 	 */
 	void init();
 
+	/**
+	 * Initializes the game without a window, rendering into an offscreen
+	 * framebuffer of the param size (see HeadlessContext)
+	 */
+	void initHeadless(unsigned int width, unsigned int height);
+
 	/**
 	 * The main loop of the game. Runs the SDL main loop
 	 */
 	void play();
 
+	/**
+	 * Renders the param number of frames as fast as possible, without
+	 * handling events or swapping, and prints the frame times
+	 */
+	void playHeadless(unsigned int frames);
+
+	/**
+	 * Makes play() record every event it handles, and the time step of
+	 * every frame, to the param file (see InputRecorder)
+	 */
+	void recordInput(const std::string& filename);
+
+	/**
+	 * Makes play() replay the param input log instead of handling live
+	 * events, and return at its end. The log's seed and window size must
+	 * be set before init() for the replay to match the recording.
+	 */
+	void setInputReplay(std::shared_ptr<InputReplay> replay);
+
+	/**
+	 * Makes play() write the frame time statistics as a line of JSON to
+	 * the param file every interval_s seconds
+	 */
+	void setFrameLog(const std::string& filename, double interval_s);
+
+	/**
+	 * Returns the statistics of the frame times play() measured
+	 */
+	const FrameTimeMonitor& getFrameTimeMonitor() { return frame_time_monitor; }
+
+	/**
+	 * Sets the frame time above which play() writes the last frames to
+	 * disk (see FlightRecorder). 0 turns it off.
+	 */
+	void setHitchBudget(double budget_ms) { flight_recorder.setBudget(budget_ms); }
+
+	/**
+	 * Captures the GL calls of the param frame, counted from the first
+	 * frame rendered, to a trace tools/glreplay replays (see FrameCapture).
+	 * Needs a build with PG612_GL_CAPTURE.
+	 */
+	void captureFrame(const std::string& filename, unsigned int frame);
+
 	/**
 	 * Quit function
 	 */
 	void quit();
 
+	/**
+	 * Sets the seed of the random bunny and light placement. Call before
+	 * init() for a scene that is the same on every run.
+	 */
+	void setRandomSeed(unsigned int seed) { random_seed = seed; }
+
+	/**
+	 * Runs each of the param scenarios after a fixed number of warmup frames
+	 * and writes their CPU and GPU frame time statistics to json
+	 */
+	void runBenchmark(const std::vector<BenchmarkScenario>& scenarios, std::ostream& json);
+
 	/**
 	 * Function that handles rendering into the OpenGL context
 	 */
@@ -71,6 +149,60 @@ public:
 	  */
 	void renderColorPass();
 
+	/**
+	* Renders to screen with deferred shading: the scene is rendered into
+	* the G-buffer, and a fullscreen pass shades every pixel once
+	*/
+	void renderDeferredColorPass();
+
+	/**
+	* Reads the overdraw measured in the previous frame, and decides whether
+	* this frame uses the depth pre-pass
+	*/
+	void UpdateDepthPrepass();
+
+	/**
+	* Renders to screen as flat filled surfaces with only their feature
+	* edges drawn on top: boundaries, creases and the current silhouettes.
+	* Nothing is shaded, so the shadow pass is skipped in this mode.
+	*/
+	void renderFeatureEdgeColorPass();
+
+	/**
+	* Renders to screen with lines found in image space: normals and depth are
+	* rendered to the G-buffer, and one fullscreen pass inks their discontinuities
+	*/
+	void renderImageEdgeColorPass();
+
+	/**
+	* Reads the color pass GPU time measured in the previous frame into the
+	* average of the render mode and variant it measured
+	*/
+	void UpdateColorPassTimers();
+
+	/**
+	* Prints the average color pass GPU time of each forward render mode
+	* with and without geometry shader
+	*/
+	void PrintColorPassTimes();
+
+	/**
+	* Prints the GL calls of the last frame per pass, when built with PG612_GL_COUNTERS
+	*/
+	void PrintGLCounters();
+
+	/**
+	* Switches the phong, wireframe and hidden line render modes between
+	* their geometry shader and their vertex to fragment shader variants
+	*/
+	void SetGeometryShaderVariants(bool use_geometry_shaders);
+
+	/**
+	* Returns the defines the shading programs are compiled with
+	* at the current shader quality
+	*/
+	GLUtils::ShaderDefines ShadingDefines();
+
 
 	/**
 	* Renders the light point of view as a depth representation 
@@ -78,15 +210,32 @@ public:
 	*/
 	void renderDepthDump();
 
+	/**
+	* Recreates the shadow map with the param size, keeping the current depth format
+	*/
+	void SetShadowMapSize(unsigned int width, unsigned int height);
+
+	/**
+	* Recreates the shadow map with the param depth format (GL_DEPTH_COMPONENT16,
+	* GL_DEPTH_COMPONENT24 or GL_DEPTH_COMPONENT32F), keeping the current size
+	*/
+	void SetShadowMapFormat(GLenum depth_format);
+
 protected:
 	void createOpenGLContext();
 
-	static const unsigned int number_of_models = 20;
+	unsigned int number_of_models; //< Number of bunnies, 20 unless a benchmark scenario sets it
+	unsigned int random_seed;	   //< Seed of the bunny and point light placement
+	static const unsigned int number_of_atlas_lights = 4;
+	static const unsigned int max_atlas_lights = 8; //< Must match MAX_SHADOW_LIGHTS in the shaders
+	static const unsigned int number_of_point_lights = 256;
 
 	static const float near_plane;
 	static const float far_plane;
 	static const float fovy;
 	static const float cube_scale;
+	static const float depth_prepass_enable_overdraw;  //< Overdraw ratio above which the automatic depth pre-pass turns on
+	static const float depth_prepass_disable_overdraw; //< Overdraw ratio below which it turns off again
 	
 	static const float cube_vertices_data[];
 	static const float cube_normals_data[];
@@ -103,17 +252,51 @@ private:
 	*/
 	GLuint vao[4];
 
+	/**
+	* De-indexed copies of vao[0] and vao[2], drawn with glDrawArrays by the
+	* hidden line program without geometry shader
+	*/
+	GLuint deindexed_vao[2];
+
+	/**
+	* Vertex arrays with the feature edge indices of the cube room [0],
+	* the modelled room [1] and the bunnies [2]
+	*/
+	GLuint edge_vao[3];
+
 	std::shared_ptr<GLUtils::Program> phong_program,
 									  wireframe_program,
 									  hidden_line_program,
 									  exploded_view_program, 
 									  light_pov_program,
 									  depth_dump_program,
+									  vsm_moments_program,
+									  vsm_blur_program,
+									  cube_shadow_program,
+									  gbuffer_program,
+									  deferred_lighting_program,
+									  feature_edge_program,
+									  silhouette_edge_program,
+									  image_edge_program,
 									  gui_program;
 
+	/**
+	* The forward render modes with and without geometry shader. phong_program,
+	* wireframe_program and hidden_line_program point to the variants in use.
+	*/
+	std::shared_ptr<GLUtils::Program> phong_gs_program,
+									  wireframe_gs_program,
+									  hidden_line_gs_program,
+									  phong_direct_program,
+									  wireframe_direct_program,
+									  hidden_line_direct_program;
+
 	// Pointer to the program currently used for the color pass scene drawing
 	std::shared_ptr<GLUtils::Program> current_program; 
 
+	// Pointer to the program currently used for the shadow pass scene drawing
+	std::shared_ptr<GLUtils::Program> current_shadow_program;
+
 	std::shared_ptr<CubeMap> diffuse_cubemap; //< Cubemap with the scenes diffuse light
 	std::shared_ptr<CubeMap> spacebox;		  //< Cubemap for the spacebox surrounding the scene
 
@@ -121,18 +304,30 @@ private:
 
 	std::shared_ptr<Model> bunny;
 	std::shared_ptr<Model> room;
+	std::shared_ptr<FeatureEdges> cube_edges; //< Feature edges of the cube room, which is not a Model
 
 	std::shared_ptr<ShadowFBO> shadow_fbo;
+	std::shared_ptr<VarianceShadowFBO> vsm_fbo; //< Moments for variance shadow mapping, same size as shadow_fbo
+	std::shared_ptr<CubeShadowFBO> cube_shadow_fbo; //< Omnidirectional depth cube map, faces as wide as shadow_fbo
+	std::shared_ptr<ShadowAtlas> shadow_atlas;		//< Depth atlas with one tile per atlas light
+	std::shared_ptr<GLUtils::BO<GL_UNIFORM_BUFFER> > shadow_lights_ubo; //< ShadowLights uniform block of the atlas lights
+
+	std::shared_ptr<LightClusters> light_clusters; //< Froxel light lists for the clustered point lights
+	std::vector<PointLight> point_lights;		   //< Unshadowed point lights orbiting along with the light
+
+	std::shared_ptr<GBuffer> gbuffer; //< Normals, albedo and depth of the deferred render mode
 
 	std::shared_ptr<gui::SliderWithText> slider_line_threshold; //< GUI slider modifying the hidden-line wireframe line tickness
 	std::shared_ptr<gui::SliderWithText> slider_line_scale;		//< GUI slider modifying the hidden-line wireframe line fade scale
 	std::shared_ptr<gui::SliderWithText> slider_line_offset;	//< GUI slider modifying the hidden-line wireframe line fade out
 	std::shared_ptr<gui::SliderWithText> slider_diffuse_mix;	//< GUI slider modifying the way the diffuse color is mixed in phong shaders
 	std::shared_ptr<gui::SliderWithText> slider_gui_alpha;		//< GUI slider modifying the alpha of all gui objects
+	std::shared_ptr<gui::SliderWithText> slider_light_bleeding;	//< GUI slider modifying the variance shadow light bleeding reduction
 	std::vector<std::shared_ptr<gui::SliderWithText>> gui_sliders; //< Collection of the sliders
 	
 	std::shared_ptr<gui::RadioButtonCollection> rendermode_radiobtn;
 	std::shared_ptr<gui::RadioButtonCollection> environment_radiobtn;
+	std::shared_ptr<gui::RadioButtonCollection> shadowmode_radiobtn;
 
 	GLuint fbo_vertex_bo; //< Vetex buffer object for fullscreen quad
 
@@ -154,10 +349,66 @@ private:
 
 	Timer my_timer;		//< Timer for machine independent motion
 	float delta_time;	//< Program Delta-time variable
+	FrameTimeMonitor frame_time_monitor; //< Statistics of the frame times measured by play()
+	std::shared_ptr<std::ofstream> frame_log; //< Receives a line of frame time statistics every frame_log_interval seconds, if set
+	double frame_log_interval;
+	FlightRecorder flight_recorder; //< The last frames of play(), written to disk after a slow one
 	float zoom;			//< Zoom factor
 	
 	bool render_gui_and_depth;
 	bool rotate_light;
+	bool fit_light_frustum; //< Fit the light frustum to the visible casters each frame
+	bool clustered_lighting; //< Add the point lights through the clustered forward path
+
+	/**
+	* Depth pre-pass setting for the phong and hidden line color passes.
+	* In auto mode the pre-pass is used while the measured overdraw is high.
+	*/
+	enum DepthPrepassModes{
+		DEPTH_PREPASS_OFF,
+		DEPTH_PREPASS_ON,
+		DEPTH_PREPASS_AUTO
+	}depth_prepass_mode;
+
+	bool depth_prepass_active;	 //< Whether the color pass currently starts with a depth pre-pass
+	float overdraw_ratio;		 //< Depth tested scene samples per framebuffer sample, as last measured
+	GLuint overdraw_queries[2];	 //< GL_SAMPLES_PASSED queries, alternating so the one of the previous frame is read
+	bool overdraw_query_issued[2];
+	unsigned int overdraw_frame; //< Frame counter selecting the overdraw query
+	GLint framebuffer_samples;	 //< Samples per pixel of the window framebuffer
+
+	bool use_geometry_shaders;				//< Whether the forward render modes use their geometry shader variants
+	GLuint color_pass_timer_queries[2];		//< GL_TIME_ELAPSED queries of the forward color pass, alternating like the overdraw queries
+	int color_pass_timer_slots[2];			//< Render mode*2 + variant each timer query measured, -1 if none is pending
+	unsigned int color_pass_timer_frame;	//< Frame counter selecting the timer query
+	float color_pass_gpu_ms[3][2];			//< Moving average GPU time of phong, wireframe and hidden line, [0] with and [1] without geometry shader
+	unsigned int color_pass_gpu_frames[3][2]; //< Number of frames measured for each of the above
+	std::shared_ptr<PassQueries> pass_queries; //< GPU time and pipeline statistics of each render pass
+	std::shared_ptr<PerformanceHUD> performance_hud; //< Frame times, pass times and counters, drawn with the GUI
+
+	std::vector<bool> model_visible; //< Whether each bunny is inside the view frustum this frame
+	unsigned int culled_models;		 //< Bunnies outside it, left out of the color pass
+	std::shared_ptr<FrameCapture> frame_capture; //< Recording the frame being rendered, if it is captured
+	std::string capture_file;		//< Trace the frame capture_frame is captured to, empty if none is requested
+	unsigned int capture_frame;
+
+	GLUtils::ProgramCache program_cache; //< Every compiled program permutation, so switching back does not recompile
+
+	/**
+	* Shader quality tiers. Each is a compile time permutation of the
+	* shading programs, selecting the number of PCF shadow taps.
+	*/
+	enum ShaderQualities{
+		SHADER_QUALITY_LOW,		//< 1 PCF tap
+		SHADER_QUALITY_MEDIUM,	//< 4 dithered PCF taps
+		SHADER_QUALITY_HIGH		//< 4x4 PCF taps
+	}shader_quality;
+
+	/**
+	* Selects the shading program permutations of the param quality,
+	* compiling those not already in the program cache
+	*/
+	void SetShaderQuality(ShaderQualities quality);
 
 	/**
 	* Enum representation of the different environments we can 
@@ -169,15 +420,49 @@ private:
 		OPEN_HALFROOM
 	}current_environment;
 
+	/**
+	* Enum representation of the shadow mapping techniques. The
+	* current_shadow_technique variable holds the one in use.
+	*/
+	enum ShadowTechniques{
+		PCF_SHADOWS,		//< Depth map sampled with 4 dithered PCF taps
+		VARIANCE_SHADOWS,	//< Prefiltered moments sampled once with a Chebyshev bound
+		CUBE_SHADOWS,		//< Depth cube map around the light rendered in one layered pass
+		ATLAS_SHADOWS		//< Several lights with PCF shadows from tiles of one depth atlas
+	}current_shadow_technique;
+
 	/**
 	* Struct for the light position and the projection and view matrices.
 	*/
-	struct {
+	struct Light {
 		glm::vec3 position;
 		glm::mat4 projection;
 		glm::mat4 view;
+		glm::vec3 color; //< Color of the light, used by the atlas lights after the first
+		float near_clip; //< Near plane of the current light projection
+		float far_clip;  //< Far plane of the current light projection
 	} light;
 
+	/**
+	* The shadow casting lights of the atlas technique. The first one
+	* follows light, the rest orbit along with it.
+	*/
+	std::vector<Light> atlas_lights;
+
+	/**
+	* Layout of the ShadowLights uniform block in the shaders (std140)
+	*/
+	struct ShadowLightsBlock {
+		glm::mat4 shadow_matrices[max_atlas_lights]; //< World space to [0, 1] shadow coordinates
+		glm::vec4 tiles[max_atlas_lights];			 //< Atlas offset (xy) and scale (zw) of each tile
+		glm::vec4 positions[max_atlas_lights];		 //< World space position (xyz) of each light
+		glm::vec4 colors[max_atlas_lights];			 //< Color (rgb) of each light
+		GLint count;
+		GLint padding[3];
+	};
+
+	glm::mat4 shadow_pass_viewprojection; //< View projection of the light the shadow pass currently renders
+
 	/**
 	* Struct with a cameras projection and view matrices
 	*/
@@ -189,13 +474,33 @@ private:
 
 	SDL_Window* main_window; //< Our window handle
 	SDL_GLContext main_context; //< Our opengl context handle 
+	std::shared_ptr<HeadlessContext> headless_context; //< Offscreen context replacing the window when headless
+	std::shared_ptr<InputRecorder> input_recorder; //< Records the events play() handles, if set
+	std::shared_ptr<InputReplay> input_replay; //< Replaces the events play() handles, if set
 	
 	VirtualTrackball cam_trackball;
 
 	void zoomIn();
 	void zoomOut();
+	void SetZoom(float zoom); //< Sets the zoom factor and updates the camera projection
 
+	/**
+	* Reacts to a mouse, wheel, key or quit event, live or replayed.
+	* Sets doExit when the event ends the game.
+	*/
+	void HandleEvent(const SDL_Event& event, bool& doExit);
+
+	/**
+	* Records the frame just rendered in the flight recorder, along with
+	* the GPU results read back since the last frame, which also go to
+	* the performance HUD
+	*/
+	void RecordFlightFrame(double frame_ms, double time_s);
+
+	void Init_GLState(); //< GL state and queries, once the context is current
+	void Init_Resources(); //< Models, FBOs, programs and GUI, shared by the windowed and headless init
 	void Init_SetMatrices();
+	void Init_CreateModels(); //< Random bunny transforms and colors, number_of_models of them
 	void Init_CreateShaderPrograms();
 	void Init_SetShaderUniforms();
 	void Init_SetShaderAttribPtrs();
@@ -203,6 +508,7 @@ private:
 	void Init_set_vao_1_attribPtrs(); //< Attrib ptrs for the cube room vao
 	void Init_set_vao_2_attribPtrs(); //< Attrib ptrs for the half open room vao
 	void Init_set_vao_3_attribPtrs(); //< Attrib ptrs for the FBO vao
+	void Init_set_edge_vao_attribPtrs(); //< Attrib ptrs and edge indices for the feature edge vaos
 	void Init_CreateGUIObjects();
 
 	void RenderGUI();
@@ -215,6 +521,105 @@ private:
 	void RenderRoomModelColorpass();
 	void RenderRooomModelShadowpass();
 
+	/**
+	* Draws all shadow casters of the current environment with shadow_pass_viewprojection
+	*/
+	void RenderShadowCasters();
+
+	/**
+	* Draws the environment and the bunnies from the camera with the param
+	* (active) program. Only modelviewprojection_matrix is set, unless
+	* surface_uniforms is true, which also sets model_matrix and color.
+	*/
+	void RenderSceneGeometry(std::shared_ptr<GLUtils::Program> program, bool surface_uniforms);
+
+	/**
+	* Renders the normals, albedo and depth of the scene into the G-buffer
+	*/
+	void RenderGBuffer();
+
+	/**
+	* Sets the line_threshold, line_scale and line_offset uniforms of the
+	* param (active) program from the hidden line sliders
+	*/
+	void SetLineUniforms(std::shared_ptr<GLUtils::Program> program);
+
+	/**
+	* Draws the feature edges (or the silhouette candidates, if param silhouettes
+	* is true) of one mesh with the param (active) edge program
+	*/
+	void RenderEdges(std::shared_ptr<GLUtils::Program> program, GLuint vao, std::shared_ptr<FeatureEdges> edges,
+					 const glm::mat4& model_matrix, bool silhouettes);
+
+	/**
+	* Sets the lighting and shadowing uniforms shared by the phong, hidden
+	* line and deferred lighting programs on the param (active) program
+	*/
+	void SetShadingUniforms(std::shared_ptr<GLUtils::Program> program);
+
+	/**
+	* Binds the shadow maps, the diffuse cube map and the light clusters
+	* to the texture units the shading programs sample them from
+	*/
+	void BindShadingTextures();
+
+	/**
+	* Returns the fraction of the screen covered by the receivers the param
+	* light can shadow, used to size its shadow atlas tile
+	*/
+	float GetScreenImportance(const Light& shadow_light);
+
+	/**
+	* Sizes the atlas tiles by screen importance, repacks the atlas if
+	* the sizes changed and uploads the ShadowLights uniform block
+	*/
+	void UpdateShadowAtlas();
+
+	/**
+	* Returns the world space bounds of everything that casts shadows
+	* in the current environment: the bunnies and the open half-room,
+	* but not the cube room enclosing the light
+	*/
+	AABB GetCasterBounds();
+
+	/**
+	* Returns the world space bounds of everything that receives shadows,
+	* the casters and the cube room
+	*/
+	AABB GetSceneBounds();
+
+	/**
+	* Returns the world space bounds of the camera view frustum
+	*/
+	AABB GetViewFrustumBounds();
+
+	/**
+	* Finds the bunnies outside the view frustum, which the color pass skips.
+	* The shadow passes still draw them, as they may cast shadows into view.
+	*/
+	void CullModels();
+
+	/**
+	* Fits light.projection to the visible part of the scene. The frustum
+	* covers the part of the visible receivers that shadow casters can
+	* reach, and its depth range is shrunk to the casters and receivers.
+	* It is never wider than the 90 degree frustum the light uses unfitted.
+	*/
+	void FitLightFrustum();
+
+	/**
+	* Returns the matrix transforming object coordinates of the param model
+	* into shadow map texture coordinates for the current shadow technique
+	*/
+	glm::mat4 GetShadowMatrix(const glm::mat4& model_matrix);
+
+	/**
+	* Sets the transformation uniforms of the shadow pass program for the
+	* param model. Cube shadows take the model matrix alone, as the
+	* geometry shader applies the view projection of each cube face.
+	*/
+	void SetShadowPassModelMatrix(const glm::mat4& model_matrix);
+
 /************************************************************************/
 /* The functions below are used for callbacks to the GUI classes        */
 /************************************************************************/
@@ -234,6 +639,21 @@ private:
 	*/
 	void UseHiddenLineProgram();
 
+	/**
+	* Switch to deferred shading
+	*/
+	void UseDeferredProgram();
+
+	/**
+	* Switch to phong shading with the feature edges drawn on top
+	*/
+	void UseFeatureEdgeProgram();
+
+	/**
+	* Switch to lines detected in image space from the depth and normals
+	*/
+	void UseImageEdgeProgram();
+
 	/**
 	* Sets the current room environemnt to be rendered to the cube room
 	*/
@@ -243,6 +663,26 @@ private:
 	* Sets the current room environemnt to be rendered to the half open room
 	*/
 	void SetBackgroundToOpenRoom();
+
+	/**
+	* Switch to shadows from the depth map with PCF filtering
+	*/
+	void UsePCFShadows();
+
+	/**
+	* Switch to variance shadow mapping
+	*/
+	void UseVarianceShadows();
+
+	/**
+	* Switch to omnidirectional shadows from a depth cube map
+	*/
+	void UseCubeShadows();
+
+	/**
+	* Switch to shadows from several lights sharing a depth atlas
+	*/
+	void UseAtlasShadows();
 };
 
 #endif // _GAMEMANAGER_H_
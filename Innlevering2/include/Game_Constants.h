@@ -2,11 +2,13 @@
 #define Game_Constants_H
 
 
-static const unsigned int window_width = 1280;
-static const unsigned int window_height = 720;
+extern unsigned int window_width;  //< 1280 for the window, or the offscreen framebuffer size when headless
+extern unsigned int window_height; //< 720 for the window, or the offscreen framebuffer size when headless
 
 static const unsigned int shadow_map_width = 1024;
 static const unsigned int shadow_map_height = 1024;
 
+static const unsigned int shadow_atlas_size = 4096; //< Width and height of the depth atlas shared by the atlas lights
+
 
 #endif // Game_Constants_H
@@ -0,0 +1,78 @@
+#ifndef _HEADLESSCONTEXT_H__
+#define _HEADLESSCONTEXT_H__
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <SDL.h>
+
+#ifdef PG612_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef PG612_HEADLESS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+/**
+* OpenGL 3.3 core context without a visible window, rendering into an
+* offscreen framebuffer that stands in for the window framebuffer (see
+* GLUtils::screenFramebuffer). The context comes from, in order of preference:
+* - a surfaceless EGL display, when built with PG612_HEADLESS_EGL (link
+*   libEGL and a GLEW built with GLEW_EGL)
+* - OSMesa, when built with PG612_HEADLESS_OSMESA (link libOSMesa and a
+*   GLEW built with GLEW_OSMESA)
+* - a hidden SDL window otherwise, which still needs a display
+* The first two need neither a display server nor a GPU, e.g. Mesa's llvmpipe.
+*/
+class HeadlessContext {
+public:
+	/**
+	* Creates the context, makes it current and initializes GLEW, then
+	* creates and binds an offscreen framebuffer of the param size
+	*/
+	HeadlessContext(unsigned int width, unsigned int height);
+	~HeadlessContext();
+
+	/**
+	* Sets the number of rasterizer threads llvmpipe uses (LP_NUM_THREADS).
+	* Must be called before the context is created.
+	*/
+	static void setRasterizerThreads(unsigned int threads);
+
+	/**
+	* Returns the llvmpipe thread setting, or an empty string if the driver
+	* picks its default (one thread per CPU)
+	*/
+	static std::string getRasterizerThreads();
+
+	GLuint getFramebuffer() { return fbo; }
+	unsigned int getWidth() { return width; }
+	unsigned int getHeight() { return height; }
+	const char* getBackendName() { return backend_name; }
+
+private:
+	void createContext();
+	void createFramebuffer();
+
+	unsigned int width, height;
+	const char* backend_name;
+
+	GLuint fbo;
+	GLuint color; //< RGBA8 color renderbuffer
+	GLuint depth; //< 24 bit depth renderbuffer
+
+#ifdef PG612_HEADLESS_EGL
+	EGLDisplay display;
+	EGLContext context;
+#elif defined(PG612_HEADLESS_OSMESA)
+	OSMesaContext context;
+	std::vector<unsigned char> osmesa_buffer; //< Window framebuffer OSMesa requires, though it is not rendered to
+#else
+	SDL_Window* window;
+	SDL_GLContext context;
+#endif
+};
+
+#endif
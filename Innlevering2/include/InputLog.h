@@ -0,0 +1,77 @@
+#ifndef _INPUTLOG_H__
+#define _INPUTLOG_H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+/**
+* One record of an input log: an SDL event handled on a frame, or the end
+* of a frame with its time step. The log is a header (magic, version, seed,
+* window size) followed by these records, 24 bytes each.
+*/
+struct InputRecord {
+	static const unsigned int FRAME_END = 0; //< type of the record closing a frame, a holds its delta time
+
+	unsigned int frame;	  //< Frame the event was handled on
+	unsigned int time_ms; //< Milliseconds since the recording started
+	unsigned int type;	  //< SDL event type, or FRAME_END
+	int a, b, c;		  //< x, y and button for mouse events, 0, y for wheel, sym and mod for keys
+};
+
+/**
+* Writes the mouse, wheel and key events GameManager::play handles to a
+* binary log, frame by frame
+*/
+class InputRecorder {
+public:
+	InputRecorder(const std::string& filename, unsigned int seed, unsigned int width, unsigned int height);
+
+	void record(unsigned int frame, const SDL_Event& event);
+
+	/**
+	* Closes the param frame. Replaying uses the same time step, so
+	* everything that moves with time moves the same way.
+	*/
+	void endFrame(unsigned int frame, float delta_time);
+
+private:
+	void write(const InputRecord& record);
+
+	std::ofstream file;
+	unsigned int start_ms; //< SDL_GetTicks when the recording started
+};
+
+/**
+* Reads a log written by InputRecorder and hands back its events frame by frame
+*/
+class InputReplay {
+public:
+	InputReplay(const std::string& filename);
+
+	/**
+	* Returns the random seed the recorded session used, which must be
+	* set before GameManager::init to get the same scene
+	*/
+	unsigned int getSeed() { return seed; }
+	unsigned int getWidth() { return width; }
+	unsigned int getHeight() { return height; }
+	unsigned int getFrameCount() { return frames; }
+
+	/**
+	* Gets the events and time step of the next frame. Returns false when
+	* the log is done.
+	*/
+	bool nextFrame(std::vector<SDL_Event>& events, float& delta_time);
+
+private:
+	std::vector<InputRecord> records;
+	unsigned int next;	 //< Next record to replay
+	unsigned int frames; //< Number of recorded frames
+	unsigned int seed;
+	unsigned int width, height;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef _LIGHTCLUSTERS_HPP__
+#define _LIGHTCLUSTERS_HPP__
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GLUtils/GLUtils.hpp"
+
+/**
+* Point light for the clustered forward lighting
+*/
+struct PointLight {
+	glm::vec3 position; //< World space position
+	float radius;		//< Distance where the light has faded out completely
+	glm::vec3 color;
+};
+
+/**
+* Clustered light culling for forward shading. The view frustum is split into
+* froxels, screen space tiles times exponentially spaced depth slices, and each
+* froxel gets the list of point lights whose sphere of influence overlaps it.
+* The lists are built on the CPU every frame, with the depth slices split over
+* the calling thread and a pool of worker threads that wait between frames,
+* and uploaded as three texture buffers:
+*
+* grid (RG32UI): offset and count into the index buffer for each froxel, where
+*				 froxel x, y, slice is at x + dim_x*(y + dim_y*slice)
+* indices (R32UI): the light indices of all froxels
+* lights (RGBA32F): two texels per light, position and radius followed by color
+*/
+class LightClusters {
+public:
+	LightClusters(unsigned int dim_x=16, unsigned int dim_y=9, unsigned int dim_z=24, unsigned int max_lights_per_cluster=128);
+	~LightClusters();
+
+	/**
+	* Sets the perspective projection (fovy in degrees) the froxels subdivide.
+	* The froxel bounds are only recomputed if the parameters changed.
+	*/
+	void setProjection(float fovy, float aspect, float near_clip, float far_clip);
+
+	/**
+	* Bins the lights into the froxels as seen with the param view matrix,
+	* and uploads the texture buffers
+	*/
+	void update(const glm::mat4& view_matrix, const std::vector<PointLight>& lights);
+
+	/**
+	* Binds the grid, index and light texture buffers to texture units
+	* first_unit, first_unit+1 and first_unit+2
+	*/
+	void bind(unsigned int first_unit);
+
+	glm::ivec3 getDimensions() { return glm::ivec3(dim_x, dim_y, dim_z); }
+	float getNear() { return near_clip; }
+
+	/**
+	* Returns the scale taking log(depth/near) to the depth slice
+	*/
+	float getSlicesPerLogDepth() { return dim_z/log(far_clip/near_clip); }
+
+	/**
+	* Returns the number of froxel light references of the last update
+	*/
+	unsigned int getIndexCount() { return light_indices.size(); }
+
+private:
+	void computeFroxelBounds();
+
+	/**
+	* Bins the lights (view space position and radius) into the froxels of the
+	* slices [first_slice, last_slice). Threads binning disjoint slice ranges
+	* write to disjoint froxels.
+	*/
+	void binSlices(unsigned int first_slice, unsigned int last_slice, const std::vector<glm::vec4>& view_lights);
+
+	/**
+	* Bins the param share of the slices of every update until the
+	* destructor stops the pool
+	*/
+	void workerLoop(unsigned int share);
+
+	unsigned int dim_x, dim_y, dim_z;
+	unsigned int max_lights_per_cluster;
+	float fovy, aspect, near_clip, far_clip;
+
+	//View space froxel bounds as a structure of arrays, so neighbouring froxels in x can be tested four at a time
+	std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+
+	std::vector<unsigned int> cluster_counts; //< Number of lights binned in each froxel
+	std::vector<unsigned int> cluster_lights; //< max_lights_per_cluster slots per froxel
+	std::vector<unsigned int> grid;			  //< Offset and count per froxel, as uploaded
+	std::vector<unsigned int> light_indices;  //< Compacted light lists, as uploaded
+	std::vector<glm::vec4> light_data;		  //< Light texels, as uploaded
+
+	GLuint buffers[3];	//< grid, indices and lights
+	GLuint textures[3];
+
+	unsigned int thread_count;				//< Shares the slices are split in, the calling thread bins the first
+	std::vector<std::thread> workers;		//< Bin the other shares
+	std::mutex work_mutex;					//< Guards the work_ members
+	std::condition_variable work_ready;		//< Signalled when an update starts, or the pool stops
+	std::condition_variable work_done;		//< Signalled when the last worker is done with its share
+	unsigned int work_generation;			//< Number of updates started, so each worker bins every update once
+	unsigned int work_pending;				//< Workers still binning the current update
+	const std::vector<glm::vec4>* work_lights; //< View space lights of the current update
+	bool work_stopping;
+};
+
+#endif
@@ -13,6 +13,8 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "GLUtils/BO.hpp"
+#include "AABB.h"
+#include "FeatureEdges.h"
 #include "GameException.h"
 
 struct MeshPart 
@@ -50,9 +52,19 @@ public:
 
 	inline MeshPart& getMesh() {return root;}
 
+	//Returns the bounds of the vertices as loaded, before the root transform is applied
+	inline AABB getBounds() {return AABB(min_dim, max_dim);}
+
 	inline std::shared_ptr<GLUtils::BO<GL_ARRAY_BUFFER> > getInterleavedVBO(){return InterleavedVBO;}
 	inline std::shared_ptr<GLUtils::BO<GL_ELEMENT_ARRAY_BUFFER> > getIndices(){return indices;}
 
+	//Returns a VBO with the vertex of each index in index order, with the same layout as the
+	//interleaved VBO. A mesh part is drawn from it with glDrawArrays(GL_TRIANGLES, first, count)
+	inline std::shared_ptr<GLUtils::BO<GL_ARRAY_BUFFER> > getDeindexedVBO(){return DeindexedVBO;}
+
+	//Returns the boundary, crease and potential silhouette edges, indexing the interleaved VBO
+	inline std::shared_ptr<FeatureEdges> getFeatureEdges(){return feature_edges;}
+
 	//Returns the stride, use for interleaved VBOs
 	inline GLint getStride(){return stride;}
 
@@ -91,6 +103,8 @@ private:
 
 	std::shared_ptr<GLUtils::BO<GL_ARRAY_BUFFER> > InterleavedVBO;
 	std::shared_ptr<GLUtils::BO<GL_ELEMENT_ARRAY_BUFFER> > indices;
+	std::shared_ptr<GLUtils::BO<GL_ARRAY_BUFFER> > DeindexedVBO;
+	std::shared_ptr<FeatureEdges> feature_edges;
 
 	GLint stride;			//< Stride value for the interleavedVBO
 	GLvoid* verticeOffset;	//< Offset value for the vertices (should be NULL)
@@ -0,0 +1,157 @@
+#ifndef _PASSQUERIES_H__
+#define _PASSQUERIES_H__
+
+#include <deque>
+#include <ostream>
+#include <vector>
+
+#include "GLUtils/GLUtils.hpp"
+
+#ifndef GL_PRIMITIVES_SUBMITTED_ARB
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+/**
+* GPU time and, with ARB_pipeline_statistics_query, vertex shader, primitive
+* and fragment shader counts of each render pass of a frame.
+*
+* Passes may nest: beginning a pass inside another pauses the outer one, so
+* every pass is measured exclusive of the passes inside it. The time is
+* taken with timestamps, as GL_TIME_ELAPSED queries cannot nest with the
+* color pass timers of GameManager.
+*
+* The queries of a frame are read back when they are done, normally
+* latency frames later. Frames still running on the GPU get new queries
+* rather than waiting, so reading back never stalls.
+*
+* While the profiler is enabled, the passes are also recorded on its GPU
+* track.
+*/
+class PassQueries {
+public:
+	enum Passes {
+		SHADOW_PASS,
+		SKYBOX,
+		COLOR_PASS,
+		DEPTH_DUMP,
+		GUI,
+		PASS_COUNT
+	};
+
+	/**
+	* The measurements of one frame
+	*/
+	struct FrameStats {
+		unsigned int frame;					 //< Frame number, counted by beginFrame
+		bool measured[PASS_COUNT];			 //< Whether the pass ran in the frame
+		double gpu_ms[PASS_COUNT];
+		GLuint64 vertices[PASS_COUNT];		 //< Vertex shader invocations
+		GLuint64 primitives[PASS_COUNT];	 //< Primitives submitted
+		GLuint64 fragments[PASS_COUNT];		 //< Fragment shader invocations
+	};
+
+	PassQueries(unsigned int latency=3);
+	~PassQueries();
+
+	/**
+	* Starts a new frame, and reads back the earlier frames that are done
+	*/
+	void beginFrame();
+
+	void begin(Passes pass);
+	void end(Passes pass);
+
+	/**
+	* Waits for every frame in flight and reads it back
+	*/
+	void flush();
+
+	/**
+	* Returns the frames read back since the last call, oldest first. Only
+	* the last max_completed are kept.
+	*/
+	std::vector<FrameStats> takeCompleted();
+
+	/**
+	* Gets the oldest frame read back and not taken yet, without
+	* allocating. Returns false if there is none.
+	*/
+	bool popCompleted(FrameStats& stats);
+
+	/**
+	* Returns the CPU time spent between begin and end of the param pass
+	* in the frame being issued, exclusive of the passes inside it
+	*/
+	double getCPUTime(Passes pass) { return cpu_ms[pass]; }
+
+	/**
+	* Returns the number beginFrame will give the next frame
+	*/
+	unsigned int getNextFrame() { return next_frame; }
+
+	bool hasPipelineStatistics() { return pipeline_statistics; }
+
+	/**
+	* Prints the moving average of each pass
+	*/
+	void print(std::ostream& out);
+
+	static const char* passName(Passes pass);
+
+	/**
+	* Returns the GLUtils counter slot counting the GL calls of the param
+	* pass. Slot 0 counts the calls outside of any pass.
+	*/
+	static unsigned int counterSlot(Passes pass) { return pass + 1; }
+
+private:
+	static const unsigned int statistics_count = 3;
+	static const unsigned int max_completed = 1024;
+
+	/**
+	* The queries of one uninterrupted part of a pass
+	*/
+	struct Interval {
+		Passes pass;
+		GLuint timestamps[2];
+		GLuint statistics[statistics_count];
+	};
+
+	/**
+	* The intervals of one frame, reused once the frame is read back
+	*/
+	struct FrameQueries {
+		std::vector<Interval> intervals;
+		unsigned int used;	//< Intervals issued this frame
+		unsigned int frame;
+		bool pending;		//< Issued and not read back yet
+	};
+
+	void openInterval(Passes pass);
+	void closeInterval();
+
+	/**
+	* Reads back the pending frames in order. Without wait it stops at the
+	* first frame not done yet.
+	*/
+	void readBack(bool wait);
+	bool isDone(const FrameQueries& queries);
+	void read(FrameQueries& queries);
+
+	std::vector<FrameQueries> frames;
+	int current;					//< Frame being issued, -1 before the first beginFrame
+	std::vector<Passes> active;		//< Passes begun and not ended, innermost last
+	unsigned int next_frame;
+	bool pipeline_statistics;
+	long long gpu_to_steady_ns;		//< Offset from GL_TIMESTAMP to the profiler clock, measured once
+
+	std::deque<FrameStats> completed;
+	double cpu_ms[PASS_COUNT];		//< CPU time of each pass in the frame being issued
+	long long interval_begin_ns;	//< Profiler clock when the open interval began
+	FrameStats average;				//< Moving average of the frames read back
+	unsigned int averaged_frames;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef _PERFORMANCEHUD_H__
+#define _PERFORMANCEHUD_H__
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GLUtils/GLUtils.hpp"
+#include "GLUtils/BO.hpp"
+#include "GLUtils/GLCounters.hpp"
+#include "PassQueries.h"
+
+/**
+* On-screen performance overlay: CPU and GPU frame time graphs, the GPU
+* and CPU time of each pass, the draw and triangle counts, the culled
+* instances and the GPU memory in use.
+*
+* Text and graphs are quads with a texcoord and color each, textured with
+* a built in 5x7 pixel font whose first cell is solid. They are written to
+* one stream vertex buffer every frame and drawn with a single glDrawArrays
+* through the GUI program, which takes its texcoords and colors from the
+* vertices while its vertex_texcoords uniform is set.
+*/
+class PerformanceHUD {
+public:
+	/**
+	* Keeps the frame times of the last history frames for the graphs
+	*/
+	PerformanceHUD(std::shared_ptr<GLUtils::Program> gui_program, unsigned int history=120);
+	~PerformanceHUD();
+
+	/**
+	* Adds the CPU time of a frame, and of each of its passes
+	*/
+	void addFrame(double cpu_ms, const double pass_cpu_ms[PassQueries::PASS_COUNT]);
+
+	/**
+	* Adds the GPU results of a frame, when they are read back
+	*/
+	void addGPUFrame(const PassQueries::FrameStats& stats);
+
+	/**
+	* Sets the GL calls of the last frame. They stay 0 without PG612_GL_COUNTERS.
+	*/
+	void setGLCounters(const GLUtils::GLCounters& counters) { gl_counters = counters; }
+
+	/**
+	* Sets the number of instances drawn and culled in the last frame
+	*/
+	void setInstances(unsigned int drawn, unsigned int culled) { instances_drawn = drawn; instances_culled = culled; }
+
+	/**
+	* Draws the HUD in the top left corner of a window of the param height,
+	* below the render mode buttons. The GUI program must be in use, with
+	* the orthographic GUI camera.
+	*/
+	void draw(unsigned int window_height);
+
+private:
+	/**
+	* A HUD vertex, in GUI camera pixels
+	*/
+	struct Vertex {
+		GLfloat x, y;
+		GLfloat u, v;
+		GLubyte color[4];
+	};
+
+	static const unsigned int max_quads = 2048;
+	static const unsigned int glyph_width = 6;	//< Font cell size in texels, with a column and a row of spacing
+	static const unsigned int glyph_height = 8;
+	static const unsigned int text_scale = 2;
+
+	void quad(float x, float y, float width, float height, float u0, float v0, float u1, float v1, const glm::vec4& color);
+	void rect(float x, float y, float width, float height, const glm::vec4& color);
+	void text(float x, float y, const char* str, const glm::vec4& color);
+
+	/**
+	* Draws the param ring of frame times, next being its oldest, as a bar
+	* graph with a line at 60 fps
+	*/
+	void graph(float x, float y, float width, float height, const std::vector<float>& frame_ms, unsigned int next, const char* label);
+
+	/**
+	* Queries the GPU memory in use, from GL_NVX_gpu_memory_info or GL_ATI_meminfo
+	*/
+	void updateGPUMemory();
+
+	std::shared_ptr<GLUtils::Program> gui_program;
+	GLuint vao;
+	std::shared_ptr<GLUtils::BO<GL_ARRAY_BUFFER> > vertex_buffer;
+	GLuint font_texture;
+	unsigned int font_texture_width;
+	std::vector<Vertex> vertices;	//< Built every draw, reserved up front
+
+	std::vector<float> cpu_ms;		//< Ring of the last frame times
+	std::vector<float> gpu_ms;
+	unsigned int next_cpu, next_gpu; //< Ring index of the next frame
+
+	double pass_cpu_ms[PassQueries::PASS_COUNT];	//< Of the last frame
+	double pass_gpu_ms[PassQueries::PASS_COUNT];	//< Of the last frame read back
+	bool pass_measured[PassQueries::PASS_COUNT];
+	GLUtils::GLCounters gl_counters;
+	unsigned int instances_drawn, instances_culled;
+
+	enum GPUMemoryInfo {
+		GPU_MEMORY_NONE,
+		GPU_MEMORY_NVX,	//< Total and available video memory
+		GPU_MEMORY_ATI	//< Free texture memory only
+	}gpu_memory_info;
+	unsigned int gpu_memory_total_kb, gpu_memory_free_kb;
+	unsigned int frames_since_memory_query;
+};
+
+#endif
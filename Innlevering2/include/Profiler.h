@@ -0,0 +1,95 @@
+#ifndef _PROFILER_H__
+#define _PROFILER_H__
+
+#include <atomic>
+#include <string>
+
+/**
+* Scoped CPU timing. PROFILE_SCOPE("name") times the rest of the enclosing
+* scope, and PROFILE_FUNCTION() the enclosing function. Every thread records
+* its samples into a ring buffer of its own, without locking, and
+* writeChromeTrace writes the last seconds of all of them as Chrome trace
+* event JSON (chrome://tracing, or ui.perfetto.dev).
+*
+* Disabled, a scope costs the one branch on isEnabled(). Defining
+* PG612_NO_PROFILER removes the scopes entirely.
+*/
+namespace profiler {
+
+extern std::atomic<bool> enabled; //< Use isEnabled() and setEnabled()
+
+inline bool isEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enable);
+
+/**
+* Sets how many seconds back writeChromeTrace goes (default 10)
+*/
+void setTraceSeconds(double seconds);
+double getTraceSeconds();
+
+/**
+* Returns the steady clock time in nanoseconds
+*/
+long long now();
+
+/**
+* Records a sample of the calling thread. The name must outlive the
+* profiler, e.g. a string literal.
+*/
+void record(const char* name, long long begin_ns, long long end_ns);
+
+/**
+* Records a sample on the GPU track, with times converted to the steady
+* clock. Must only be called from the thread owning the GL context.
+*/
+void recordGPU(const char* name, long long begin_ns, long long end_ns);
+
+/**
+* Writes the samples of the last getTraceSeconds() seconds to the param
+* file. Returns false if it could not be written.
+*/
+bool writeChromeTrace(const std::string& filename);
+
+/**
+* Records the time from construction to destruction, if the profiler
+* was enabled at construction
+*/
+class Scope {
+public:
+	Scope(const char* name) {
+		if(isEnabled()) {
+			this->name = name;
+			begin_ns = now();
+		}
+		else
+			this->name = NULL;
+	}
+
+	~Scope() {
+		if(name != NULL)
+			record(name, begin_ns, now());
+	}
+
+private:
+	Scope(const Scope&);
+	Scope& operator=(const Scope&);
+
+	const char* name;
+	long long begin_ns;
+};
+
+}
+
+#ifdef PG612_NO_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#endif
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _SHADOWATLAS_HPP__
+#define _SHADOWATLAS_HPP__
+
+#include <memory>
+#include <vector>
+
+#include "ShadowFBO.h"
+
+/**
+* A single depth texture shared by several shadow casting lights. Each
+* light gets a square tile with a power of two size. When the requested
+* sizes do not fit in the atlas, the largest tiles are halved until they
+* do, and the tiles are packed largest first into a quadtree, which packs
+* power of two squares without gaps.
+*/
+class ShadowAtlas {
+public:
+	struct Tile {
+		unsigned int x, y;	//< Lower left corner in texels
+		unsigned int size;	//< Width and height in texels
+	};
+
+	/**
+	* Creates the atlas as a size x size ShadowFBO with the param depth format
+	*/
+	ShadowAtlas(unsigned int size, GLenum depth_format=GL_DEPTH_COMPONENT24, unsigned int min_tile_size=64);
+
+	/**
+	* Assigns one tile per entry in requested_sizes, in the same order. Sizes
+	* are rounded down to powers of two between the minimum tile size and half
+	* the atlas size. The tiles are only repacked if the rounded sizes differ
+	* from those of the last call.
+	*
+	* @return true if the packing changed
+	*/
+	bool pack(const std::vector<unsigned int>& requested_sizes);
+
+	const Tile& getTile(unsigned int i) { return tiles.at(i); }
+	unsigned int getTileCount() { return tiles.size(); }
+
+	std::shared_ptr<ShadowFBO> getFBO() { return fbo; }
+	unsigned int getSize() { return size; }
+
+private:
+	std::shared_ptr<ShadowFBO> fbo;
+	unsigned int size;
+	unsigned int min_tile_size;
+	std::vector<unsigned int> tile_sizes; //< Sizes the current tiles were packed with
+	std::vector<Tile> tiles;
+};
+
+#endif
@@ -5,7 +5,12 @@
 
 class ShadowFBO {
 public:
-	ShadowFBO(unsigned int width, unsigned int height);
+	/**
+	* Creates a depth only FBO with a depth texture of the param size
+	* and internal format (GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT24
+	* or GL_DEPTH_COMPONENT32F)
+	*/
+	ShadowFBO(unsigned int width, unsigned int height, GLenum depth_format=GL_DEPTH_COMPONENT24);
 	~ShadowFBO();
 
 	void bind();
@@ -13,15 +18,22 @@ public:
 
 	unsigned int getWidth() {return width; }
 	unsigned int getHeight() {return height; }
+	GLenum getDepthFormat() {return depth_format; }
 
 	GLuint getTexture() { return texture; }
 
+	/**
+	* Returns a readable name of the param depth format, e.g. "GL_DEPTH_COMPONENT24"
+	*/
+	static const char* depthFormatName(GLenum depth_format);
+
 private:
 	GLuint fbo;
 	GLuint depth;
 	GLuint texture;
 	unsigned int width, height;
+	GLenum depth_format;
 
 };
 
-#endif
\ No newline at end of file
+#endif
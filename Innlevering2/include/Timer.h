@@ -2,12 +2,9 @@
 #define _TIMER_H_
 
 #ifdef _WIN32
-#include <sys/timeb.h>
 #include <windows.h>
-#include <time.h>
 #else
-#include <sys/time.h>
-#include <unistd.h>
+#include <time.h>
 #endif
 
 
@@ -45,26 +42,21 @@ public:
 	};
 
 	/** 
-	 * Return the current time as number of elapsed seconds of this day.
+	 * Return the current time in seconds of a monotonic clock with an
+	 * arbitrary start, so it never jumps when the system time is set.
 	 */
 	double static getCurrentTime() {
-#ifdef WIN32
-#if 1
-    LARGE_INTEGER f;
+#ifdef _WIN32
+    static LARGE_INTEGER f;
+    if(f.QuadPart == 0)
+        QueryPerformanceFrequency(&f);
     LARGE_INTEGER t;
-    QueryPerformanceFrequency(&f);
     QueryPerformanceCounter(&t);
     return t.QuadPart/(double) f.QuadPart;
 #else
-    struct _timeb ts;
-		_ftime(&ts);
-		return (ts.time + 0.001 * ts.millitm);
-#endif
-#else
-    struct timeval tv;
-    struct timezone tz;
-    gettimeofday(&tv, &tz);
-    return tv.tv_sec+tv.tv_usec*1e-6;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1e-9;
 #endif
   };
 
@@ -0,0 +1,47 @@
+#ifndef _VARIANCESHADOWFBO_HPP__
+#define _VARIANCESHADOWFBO_HPP__
+
+#include <memory>
+
+#include "GLUtils/GLUtils.hpp"
+
+/**
+* FBO for variance shadow mapping. The shadow pass renders the first two
+* depth moments into an RG32F texture, which is then prefiltered with a
+* separable blur at shadow map resolution. The filtered moments are sampled
+* once per fragment with bilinear filtering.
+*/
+class VarianceShadowFBO {
+public:
+	VarianceShadowFBO(unsigned int width, unsigned int height);
+	~VarianceShadowFBO();
+
+	/**
+	* Binds the FBO the moments are rendered into
+	*/
+	void bind();
+	static void unbind();
+
+	/**
+	* Blurs the moments horizontally into the intermediate texture, then
+	* vertically back into the moments texture.
+	*
+	* @param blur_program program sampling the source in texture unit 0, with a
+	*					  "blur_step" uniform holding the texel offset of the pass
+	* @param fullscreen_vao vao drawing a fullscreen quad as a 4 vertex triangle strip
+	*/
+	void blur(std::shared_ptr<GLUtils::Program> blur_program, GLuint fullscreen_vao);
+
+	unsigned int getWidth() {return width; }
+	unsigned int getHeight() {return height; }
+
+	GLuint getTexture() { return textures[0]; }
+
+private:
+	GLuint fbos[2];		//< fbos[0] renders into textures[0] with a depth buffer, fbos[1] into textures[1]
+	GLuint textures[2]; //< textures[0] holds the moments, textures[1] the horizontally blurred moments
+	GLuint depth;
+	unsigned int width, height;
+};
+
+#endif
@@ -2,10 +2,11 @@
 uniform sampler2D texture;
 uniform float gui_alpha;
 in vec2 ex_texcoord;
+in vec4 ex_color;
 
 out vec4 res_Color;
 
 void main() {
 	vec4 texture_color = texture2D(texture, ex_texcoord.xy);
-	res_Color = vec4(texture_color*vec4(1,1,1,gui_alpha));
+	res_Color = vec4(texture_color*ex_color*vec4(1,1,1,gui_alpha));
 }
\ No newline at end of file
@@ -3,14 +3,25 @@
 uniform mat4 model_matrix;
 uniform mat4 projection;
 uniform mat4 view;
+uniform bool vertex_texcoords; //< Take texcoord and color from the vertices, as the performance HUD does
 
 in  vec2 in_Position;
+in  vec2 in_Texcoord;
+in  vec4 in_Color;
 out vec2 ex_texcoord;
+out vec4 ex_color;
 
 void main() {	
 	vec4 pos = vec4(in_Position.x, in_Position.y, 1, 1);
 	gl_Position = projection * view * model_matrix * pos;
 
-	ex_texcoord = in_Position;
+	if(vertex_texcoords) {
+		ex_texcoord = in_Texcoord;
+		ex_color = in_Color;
+	}
+	else {
+		ex_texcoord = in_Position;
+		ex_color = vec4(1);
+	}
 
 }
\ No newline at end of file
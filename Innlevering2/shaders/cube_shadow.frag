@@ -0,0 +1,11 @@
+#version 150
+uniform vec3 light_position;
+uniform float far_clip;
+
+in vec3 f_world_position;
+
+void main() {
+	//Storing the linear distance to the light makes the depth comparable
+	//without knowing which face the fragment is looked up from
+	gl_FragDepth = length(f_world_position - light_position) / far_clip;
+}
@@ -0,0 +1,9 @@
+#version 150
+uniform mat4 model_matrix;
+
+in  vec3 in_Position;
+
+void main(){
+	//The geometry shader projects the world position onto each cube face
+	gl_Position = model_matrix * vec4(in_Position, 1.0f);
+}
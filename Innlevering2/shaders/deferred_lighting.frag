@@ -0,0 +1,46 @@
+#version 330
+uniform sampler2D normal_texture;
+uniform sampler2D albedo_texture;
+uniform sampler2D depth_texture;
+uniform mat4 inverse_viewprojection;
+uniform vec3 camera_position;
+uniform mat4 shadow_matrix; //< World space to shadow map coordinates of the light
+
+uniform samplerCube diffuse_map;
+uniform float diffuse_mix_value;
+
+#include "include/shadows.glsl"
+#include "include/clustered_lights.glsl"
+#include "include/octahedral.glsl"
+
+in vec2 ex_texcoord;
+out vec4 out_color;
+
+void main() {
+	float depth = texture(depth_texture, ex_texcoord).r;
+	if(depth == 1.0)
+		discard; //Nothing was rendered here, so the spacebox shows through
+
+	vec4 world_position = inverse_viewprojection * vec4(vec3(ex_texcoord, depth)*2.0 - 1.0, 1.0);
+	world_position /= world_position.w;
+	vec3 n = decodeNormal(texture(normal_texture, ex_texcoord).xy);
+	vec3 color = texture(albedo_texture, ex_texcoord).rgb;
+
+	vec3 l = normalize(light_world_position - world_position.xyz);
+	vec3 h = normalize(normalize(camera_position - world_position.xyz)+l);
+
+	float diff = max(0.0f, dot(n, l));
+	float spec = pow(max(0.0f, dot(n, h)), 128.0f);
+	vec3 diffuse = vec3(diff*color);
+
+	float shade_factor = shadowFactor(shadow_matrix * world_position, world_position.xyz);
+
+	vec3 diff_cubemap_color = texture(diffuse_map, n).xyz;
+	diff_cubemap_color = mix(diff_cubemap_color, diffuse, diffuse_mix_value);
+
+	out_color = vec4( ( (diff_cubemap_color*color) + (spec*0.1) ) * shade_factor, 1.0);
+	out_color.rgb += atlasLighting(world_position.xyz, n, normalize(camera_position - world_position.xyz), color);
+
+	if(use_clustered_lights)
+		out_color.rgb += clusteredLighting(world_position.xyz, n, color);
+}
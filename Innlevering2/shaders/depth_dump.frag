@@ -2,12 +2,12 @@
 
 uniform sampler2D fbo_texture;
 uniform float gui_alpha;
+uniform float near_clip;
+uniform float far_clip;
 in vec2 ex_texcoord;
 out vec4 res_Color;
 
 float NormalizeDepth(float depth_val){
-		float near_clip = 0.5;
-		float far_clip = 30.0; 
 		return (2.0 * near_clip) / (far_clip + near_clip - depth_val * (far_clip - near_clip));
 	}
 
@@ -0,0 +1,7 @@
+#version 150
+
+out vec4 out_color;
+
+void main() {
+	out_color = vec4(0.0, 0.0, 0.0, 1.0);
+}
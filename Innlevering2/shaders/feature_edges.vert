@@ -0,0 +1,11 @@
+#version 150
+uniform mat4 modelviewprojection_matrix;
+
+in vec3 position;
+
+smooth out vec3 g_position; //< Object space position, for the silhouette test
+
+void main() {
+	g_position = position;
+	gl_Position = modelviewprojection_matrix * vec4(position, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330
+uniform vec3 color;
+
+smooth in vec3 f_n;
+
+layout(location = 0) out vec2 out_normal;
+layout(location = 1) out vec4 out_albedo;
+
+#include "include/octahedral.glsl"
+
+void main() {
+	out_normal = encodeNormal(normalize(f_n));
+	out_albedo = vec4(color, 1.0);
+}
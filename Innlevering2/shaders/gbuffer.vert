@@ -0,0 +1,14 @@
+#version 330
+uniform mat4 modelviewprojection_matrix;
+uniform mat4 model_matrix;
+
+in vec3 position;
+in vec3 normal;
+
+smooth out vec3 f_n;
+
+void main() {
+	//The models are only uniformly scaled, so the model matrix transforms normals too
+	f_n = mat3(model_matrix) * normal;
+	gl_Position = modelviewprojection_matrix * vec4(position, 1.0);
+}
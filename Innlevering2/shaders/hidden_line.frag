@@ -1,14 +1,19 @@
 #version 150
-uniform sampler2DShadow shadowmap_texture;
 uniform samplerCube diffuse_map;
 uniform float diffuse_mix_value;
 uniform vec3 color;
+uniform mat4 model_matrix;
 
 uniform float line_threshold;
 uniform float line_scale;
 uniform float line_offset;
 
+#include "include/shadows.glsl"
+#include "include/clustered_lights.glsl"
+#include "include/lines.glsl"
+
 smooth in vec4 f_shadow_coord;
+smooth in vec3 f_world_position;
 
 smooth in vec3 f_n;
 smooth in vec3 f_v;
@@ -17,13 +22,6 @@ smooth in vec3 beyer_coord;
 
 out vec4 out_color;
 
-float amplify(float d, float scale, float offset) {
-	d= scale * d + offset;
-	d= clamp(d, 0, 1);
-	d = 1-exp2(- 2*d*d);
-	return d;
-}
-
 void main() {
 	vec3 l = normalize(f_l);
     vec3 h = normalize(normalize(f_v)+l);
@@ -33,12 +31,7 @@ void main() {
 	float spec = pow(max(0.0f, dot(n, h)), 128.0f);
 	vec3 diffuse = vec3(diff*color);
 
-	ivec2 o = ivec2(mod(floor(gl_FragCoord.xy), 2.0));
-	float shade_factor = textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(-1, -1)+o);
-	shade_factor += textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(1, -1)+o);
-	shade_factor += textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(-1, 1)+o);
-	shade_factor += textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(1, 1)+o);
-	shade_factor = shade_factor * 0.25 + 0.75;
+	float shade_factor = shadowFactor(f_shadow_coord, f_world_position);
 
 	float k = min(min(beyer_coord.x, beyer_coord.y), beyer_coord.z);
 
@@ -47,6 +40,12 @@ void main() {
 
 	out_color = vec4( ( (diff_cubemap_color*color) + (spec*0.1) ) * shade_factor, 1.0);
 
+	//The models are only uniformly scaled, so the model matrix transforms normals too
+	vec3 world_normal = normalize(mat3(model_matrix)*n);
+	out_color.rgb += atlasLighting(f_world_position, world_normal, normalize(mat3(model_matrix)*f_v), color);
+	if(use_clustered_lights)
+		out_color.rgb += clusteredLighting(f_world_position, world_normal, color);
+
 	if(k < line_threshold )
 		out_color = vec4( out_color.xyz * amplify(k, line_scale, line_offset), 1.0);
-}
\ No newline at end of file
+}
@@ -4,11 +4,16 @@ uniform mat4 modelview_matrix_inverse;
 uniform mat4 light_matrix;
 uniform vec3 light_pos;
 uniform mat4 shadow_matrix;
+uniform mat4 model_matrix;
 
 in vec3 position;
 in vec3 normal;
 
+//Must give the exact depths of the depth pre-pass, which is tested with GL_EQUAL
+invariant gl_Position;
+
 smooth out vec4 g_shadow_coord;
+smooth out vec3 g_world_position;
 
 smooth out vec3 g_v;
 smooth out vec3 g_l;
@@ -25,4 +30,7 @@ void main() {
 	gl_Position = modelviewprojection_matrix * vec4(position, 1.0);
 
 	g_shadow_coord = shadow_matrix * vec4(position, 1.0);
+
+	//World space position for the shadow lookups of the cube map and atlas
+	g_world_position = (model_matrix * vec4(position, 1.0)).xyz;
 }
\ No newline at end of file
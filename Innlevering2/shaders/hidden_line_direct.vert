@@ -0,0 +1,43 @@
+#version 150
+uniform mat4 modelviewprojection_matrix;
+uniform mat4 modelview_matrix_inverse;
+uniform mat4 light_matrix;
+uniform vec3 light_pos;
+uniform mat4 shadow_matrix;
+uniform mat4 model_matrix;
+
+in vec3 position;
+in vec3 normal;
+
+//Must give the exact depths of the depth pre-pass, which is tested with GL_EQUAL
+invariant gl_Position;
+
+//Same as hidden_line.vert, but writes the fragment shader inputs directly.
+//The geometry is drawn de-indexed with glDrawArrays, so gl_VertexID % 3
+//is the corner of the triangle, and gives the coordinates hidden_line.geom assigns
+smooth out vec4 f_shadow_coord;
+smooth out vec3 f_world_position;
+
+smooth out vec3 f_v;
+smooth out vec3 f_l;
+smooth out vec3 f_n;
+smooth out vec3 beyer_coord;
+
+void main() {	
+	float homogeneous_divide = (1.0f/modelview_matrix_inverse[3].w);
+	vec3 cam_pos_world = modelview_matrix_inverse[3].xyz*homogeneous_divide;
+
+	f_v = normalize(cam_pos_world - position);
+	f_l = normalize(light_pos - position);
+	f_n = normalize(normal);
+
+	int corner = gl_VertexID % 3;
+	beyer_coord = vec3(corner==0?1:0, corner==1?2:0, corner==2?3:0);
+
+	gl_Position = modelviewprojection_matrix * vec4(position, 1.0);
+
+	f_shadow_coord = shadow_matrix * vec4(position, 1.0);
+
+	//World space position for the shadow lookups of the cube map and atlas
+	f_world_position = (model_matrix * vec4(position, 1.0)).xyz;
+}
@@ -0,0 +1,75 @@
+#version 330
+uniform sampler2D normal_texture;
+uniform sampler2D albedo_texture;
+uniform sampler2D depth_texture;
+uniform mat4 inverse_viewprojection;
+uniform vec3 light_world_position;
+uniform float near_clip;
+uniform float far_clip;
+
+//Same meaning as in hidden_line.frag, with the edge detector response in
+//place of the distance to the triangle edge: pixels whose discontinuity
+//reaches line_threshold are inked fully, weaker ones are faded out
+uniform float line_threshold;
+uniform float line_scale;
+uniform float line_offset;
+
+in vec2 ex_texcoord;
+out vec4 out_color;
+
+const float depth_edge_weight = 10.0; //< Relative depth discontinuity counting as much as a 90 degree crease
+const float edge_noise_floor = 0.005;  //< Responses below this come from tessellation and depth precision
+
+#include "include/lines.glsl"
+#include "include/octahedral.glsl"
+
+//Reciprocal of the eye space depth, which is affine across the screen on
+//any plane, so its second difference is zero everywhere but at depth edges
+float inverseDepth(float depth) {
+	float z = depth*2.0 - 1.0;
+	return (far_clip + near_clip - z*(far_clip - near_clip)) / (2.0*near_clip*far_clip);
+}
+
+void main() {
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	ivec2 max_p = textureSize(depth_texture, 0) - 1;
+	float depth = texelFetch(depth_texture, p, 0).r;
+	if(depth == 1.0)
+		discard; //Nothing was rendered here, so the spacebox shows through
+
+	float w = inverseDepth(depth);
+	vec3 n = decodeNormal(texelFetch(normal_texture, p, 0).xy);
+
+	//Largest depth and normal discontinuity along the two screen axes
+	float edge = 0.0;
+	for(int axis = 0; axis < 2; axis++) {
+		ivec2 direction = axis == 0 ? ivec2(1, 0) : ivec2(0, 1);
+		ivec2 a = clamp(p - direction, ivec2(0), max_p);
+		ivec2 b = clamp(p + direction, ivec2(0), max_p);
+		float depth_a = texelFetch(depth_texture, a, 0).r;
+		float depth_b = texelFetch(depth_texture, b, 0).r;
+
+		//A neighbour without geometry makes this pixel part of the outline
+		if(depth_a == 1.0 || depth_b == 1.0) {
+			edge = 1.0;
+			break;
+		}
+		float depth_edge = abs(inverseDepth(depth_a) + inverseDepth(depth_b) - 2.0*w) / w;
+		edge = max(edge, depth_edge*depth_edge_weight);
+
+		vec3 n_a = decodeNormal(texelFetch(normal_texture, a, 0).xy);
+		vec3 n_b = decodeNormal(texelFetch(normal_texture, b, 0).xy);
+		edge = max(edge, 1.0 - min(dot(n, n_a), dot(n, n_b)));
+	}
+
+	vec4 world_position = inverse_viewprojection * vec4(vec3(ex_texcoord, depth)*2.0 - 1.0, 1.0);
+	world_position /= world_position.w;
+	vec3 l = normalize(light_world_position - world_position.xyz);
+	vec3 color = texelFetch(albedo_texture, p, 0).rgb;
+	out_color = vec4(color*(0.25 + 0.75*max(0.0, dot(n, l))), 1.0);
+
+	if(edge > edge_noise_floor) {
+		float k = line_threshold*(1.0 - clamp(edge/max(line_threshold, 0.0001), 0.0, 1.0));
+		out_color = vec4(out_color.xyz * amplify(k, line_scale, line_offset), 1.0);
+	}
+}
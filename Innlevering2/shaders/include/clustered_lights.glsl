@@ -0,0 +1,32 @@
+//Point lights binned into froxels by LightClusters
+
+uniform bool use_clustered_lights;
+uniform usamplerBuffer cluster_grid;		  //< Offset and count into cluster_light_indices for each froxel
+uniform usamplerBuffer cluster_light_indices;
+uniform samplerBuffer point_lights;			  //< Two texels per light, position and radius followed by color
+uniform ivec3 cluster_dims;
+uniform vec2 cluster_tile_size;				  //< Froxel width and height in pixels
+uniform vec2 cluster_depth_params;			  //< Near depth of the first slice, and slices per log(depth/near)
+uniform mat4 view_matrix;
+
+//Diffuse light from the point lights binned in the froxel of the fragment
+vec3 clusteredLighting(vec3 world_position, vec3 world_normal, vec3 albedo) {
+	float depth = -(view_matrix * vec4(world_position, 1.0)).z;
+	int slice = clamp(int(log(depth / cluster_depth_params.x) * cluster_depth_params.y), 0, cluster_dims.z-1);
+	ivec2 tile = min(ivec2(gl_FragCoord.xy / cluster_tile_size), cluster_dims.xy-1);
+	int cluster = tile.x + cluster_dims.x*(tile.y + cluster_dims.y*slice);
+
+	uvec2 range = texelFetch(cluster_grid, cluster).xy;
+	vec3 result = vec3(0.0);
+	for(uint i = 0u; i < range.y; i++) {
+		int light = int(texelFetch(cluster_light_indices, int(range.x + i)).x);
+		vec4 position_radius = texelFetch(point_lights, 2*light);
+		vec3 light_color = texelFetch(point_lights, 2*light+1).rgb;
+
+		vec3 l = position_radius.xyz - world_position;
+		float d = length(l);
+		float attenuation = clamp(1.0 - d/position_radius.w, 0.0, 1.0);
+		result += albedo*light_color*max(0.0, dot(world_normal, l/d))*attenuation*attenuation;
+	}
+	return result;
+}
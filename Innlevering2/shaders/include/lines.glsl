@@ -0,0 +1,8 @@
+//Fade of the hidden line ink by the distance d to the line
+
+float amplify(float d, float scale, float offset) {
+	d= scale * d + offset;
+	d= clamp(d, 0, 1);
+	d = 1-exp2(- 2*d*d);
+	return d;
+}
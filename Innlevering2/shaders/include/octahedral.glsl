@@ -0,0 +1,18 @@
+//Octahedral normal encoding: the unit sphere is projected onto the octahedron
+//|x|+|y|+|z| = 1, and the lower half is folded out over the corners
+
+vec2 octWrap(vec2 v) {
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	return n.z >= 0.0 ? n.xy : octWrap(n.xy);
+}
+
+vec3 decodeNormal(vec2 f) {
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
@@ -0,0 +1,117 @@
+//Shadowing from the light with the technique selected by shadow_technique.
+//PCF_TAPS (1, 4 or 16) sets the number of depth map taps of PCF shadows.
+
+#ifndef PCF_TAPS
+#define PCF_TAPS 4
+#endif
+
+uniform sampler2DShadow shadowmap_texture;
+uniform sampler2D vsm_texture;
+uniform samplerCubeShadow cube_shadowmap_texture;
+uniform int shadow_technique; //< 0 = PCF, 1 = variance, 2 = omnidirectional, 3 = atlas
+uniform float cube_shadow_far;
+uniform vec3 light_world_position;
+uniform float light_bleeding_reduction;
+
+#define MAX_SHADOW_LIGHTS 8 //< Must match max_atlas_lights in GameManager
+
+layout(std140) uniform ShadowLights {
+	mat4 light_shadow_matrices[MAX_SHADOW_LIGHTS]; //< World space to [0, 1] shadow coordinates of each light
+	vec4 light_tiles[MAX_SHADOW_LIGHTS];		   //< Atlas offset (xy) and scale (zw) of each light's tile
+	vec4 light_positions[MAX_SHADOW_LIGHTS];	   //< World space position (xyz) of each light
+	vec4 light_colors[MAX_SHADOW_LIGHTS];		   //< Color (rgb) of each light
+	int shadow_light_count;
+};
+
+//Upper bound on the fraction of light reaching the fragment, from the
+//filtered depth moments of the variance shadow map
+float chebyshevUpperBound(vec4 shadow_coord) {
+	vec3 coord = shadow_coord.xyz/shadow_coord.w;
+	vec2 moments = texture(vsm_texture, coord.xy).rg;
+	if(coord.z <= moments.x)
+		return 1.0;
+
+	float variance = max(moments.y - moments.x*moments.x, 0.00002);
+	float d = coord.z - moments.x;
+	float p_max = variance / (variance + d*d);
+
+	//Cutting off the tail of the bound removes light bleeding where shadows overlap
+	return clamp((p_max - light_bleeding_reduction) / (1.0 - light_bleeding_reduction), 0.0, 1.0);
+}
+
+//Visibility of the fragment from atlas light i. Fragments outside the
+//light frustum are lit, so lookups never reach into neighbouring tiles
+float atlasVisibility(int i, vec3 world_position) {
+	vec4 coord = light_shadow_matrices[i] * vec4(world_position, 1.0);
+	if(coord.w <= 0.0)
+		return 1.0;
+	coord.xyz /= coord.w;
+	if(any(lessThan(coord.xy, vec2(0.0))) || any(greaterThan(coord.xy, vec2(1.0))))
+		return 1.0;
+
+	vec2 uv = light_tiles[i].xy + coord.xy*light_tiles[i].zw;
+	return texture(shadowmap_texture, vec3(uv, coord.z));
+}
+
+//Sum of PCF_TAPS depth map comparisons, scaled to four taps
+float pcfShadow(vec4 shadow_coord) {
+#if PCF_TAPS == 1
+	return 4.0*textureProj(shadowmap_texture, shadow_coord);
+#elif PCF_TAPS == 16
+	vec2 texel = shadow_coord.w / vec2(textureSize(shadowmap_texture, 0));
+	float sum = 0.0;
+	for(int y = 0; y < 4; y++)
+		for(int x = 0; x < 4; x++)
+			sum += textureProj(shadowmap_texture, shadow_coord + vec4(vec2(x - 1.5, y - 1.5)*texel, 0.0, 0.0));
+	return sum*0.25;
+#else
+	ivec2 o = ivec2(mod(floor(gl_FragCoord.xy), 2.0));
+	float sum = textureProjOffset(shadowmap_texture, shadow_coord, ivec2(-1, -1)+o);
+	sum += textureProjOffset(shadowmap_texture, shadow_coord, ivec2(1, -1)+o);
+	sum += textureProjOffset(shadowmap_texture, shadow_coord, ivec2(-1, 1)+o);
+	sum += textureProjOffset(shadowmap_texture, shadow_coord, ivec2(1, 1)+o);
+	return sum;
+#endif
+}
+
+//Shade factor in [0.75, 1] of the fragment at the param shadow map
+//coordinates and world space position
+float shadowFactor(vec4 shadow_coord, vec3 world_position) {
+	float shade_factor;
+	if(shadow_technique == 1) {
+		//Scaled like the sum of the four PCF taps
+		shade_factor = 4.0*chebyshevUpperBound(shadow_coord);
+	}
+	else if(shadow_technique == 2) {
+		//The cube map stores linear distance to the light, offset by a small world space bias
+		vec3 light_vec = world_position - light_world_position;
+		float depth = (length(light_vec) - 0.05) / cube_shadow_far;
+		shade_factor = 4.0*texture(cube_shadowmap_texture, vec4(light_vec, depth));
+	}
+	else if(shadow_technique == 3) {
+		//The first atlas light is the light shaded by the caller, the
+		//others add their own light in atlasLighting
+		shade_factor = 4.0*atlasVisibility(0, world_position);
+	}
+	else {
+		shade_factor = pcfShadow(shadow_coord);
+	}
+	return shade_factor * 0.25 + 0.75;
+}
+
+//Diffuse and specular light from the atlas lights after the first, each
+//shadowed by its own tile. The vectors are in world space
+vec3 atlasLighting(vec3 world_position, vec3 world_normal, vec3 world_view, vec3 albedo) {
+	vec3 result = vec3(0.0);
+	if(shadow_technique != 3)
+		return result;
+
+	for(int i = 1; i < shadow_light_count; i++) {
+		vec3 l = normalize(light_positions[i].xyz - world_position);
+		vec3 h = normalize(world_view + l);
+		float diff = max(0.0, dot(world_normal, l));
+		float spec = pow(max(0.0, dot(world_normal, h)), 128.0);
+		result += (albedo*diff + spec*0.1)*light_colors[i].rgb*atlasVisibility(i, world_position);
+	}
+	return result;
+}
@@ -3,6 +3,9 @@ uniform mat4 modelviewprojection_matrix;
 
 in  vec3 in_Position;
 
+//Also used as the camera depth pre-pass, which the color pass tests with GL_EQUAL
+invariant gl_Position;
+
 void main(){
 	gl_Position = modelviewprojection_matrix * vec4(in_Position, 1.0f);
 
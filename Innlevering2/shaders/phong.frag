@@ -1,10 +1,14 @@
 #version 150
-uniform sampler2DShadow shadowmap_texture;
 uniform samplerCube diffuse_map;
 uniform float diffuse_mix_value;
 uniform vec3 color;
+uniform mat4 model_matrix;
+
+#include "include/shadows.glsl"
+#include "include/clustered_lights.glsl"
 
 smooth in vec4 f_shadow_coord;
+smooth in vec3 f_world_position;
 
 smooth in vec3 f_n;
 smooth in vec3 f_v;
@@ -21,16 +25,17 @@ void main() {
 	float spec = pow(max(0.0f, dot(n, h)), 128.0f);
 	vec3 diffuse = vec3(diff*color);
 
-	ivec2 o = ivec2(mod(floor(gl_FragCoord.xy), 2.0));
-	float shade_factor = textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(-1, -1)+o);
-	shade_factor += textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(1, -1)+o);
-	shade_factor += textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(-1, 1)+o);
-	shade_factor += textureProjOffset(shadowmap_texture, f_shadow_coord, ivec2(1, 1)+o);
-	shade_factor = shade_factor * 0.25 + 0.75;	
+	float shade_factor = shadowFactor(f_shadow_coord, f_world_position);
 
 	vec3 diff_cubemap_color = texture(diffuse_map, n).xyz;
 
 	diff_cubemap_color = mix(diff_cubemap_color, diffuse, diffuse_mix_value);
 
     out_color = vec4( ( (diff_cubemap_color*color) + (spec*0.1) ) * shade_factor, 1.0);
-}
\ No newline at end of file
+
+	//The models are only uniformly scaled, so the model matrix transforms normals too
+	vec3 world_normal = normalize(mat3(model_matrix)*n);
+	out_color.rgb += atlasLighting(f_world_position, world_normal, normalize(mat3(model_matrix)*f_v), color);
+	if(use_clustered_lights)
+		out_color.rgb += clusteredLighting(f_world_position, world_normal, color);
+}
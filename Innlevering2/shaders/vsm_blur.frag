@@ -0,0 +1,21 @@
+#version 130
+
+uniform sampler2D moments_texture;
+uniform vec2 blur_step;
+
+in vec2 ex_texcoord;
+out vec4 res_Color;
+
+//9 tap gaussian done in 5 fetches, using the bilinear filtering
+//to sample between two texels with a single fetch
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main() {
+	vec2 moments = texture2D(moments_texture, ex_texcoord).rg * weights[0];
+	for(int i = 1; i < 3; i++) {
+		moments += texture2D(moments_texture, ex_texcoord + offsets[i]*blur_step).rg * weights[i];
+		moments += texture2D(moments_texture, ex_texcoord - offsets[i]*blur_step).rg * weights[i];
+	}
+	res_Color = vec4(moments, 0.0, 1.0);
+}
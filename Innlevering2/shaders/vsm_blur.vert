@@ -0,0 +1,9 @@
+#version 130
+
+in  vec2 in_Position;
+out vec2 ex_texcoord;
+
+void main(){
+	gl_Position = vec4(in_Position, 0.0, 1.0);
+	ex_texcoord = 0.5*in_Position+vec2(0.5);
+}
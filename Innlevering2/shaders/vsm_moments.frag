@@ -0,0 +1,13 @@
+#version 130
+
+out vec4 res_Color;
+
+void main() {
+	float depth = gl_FragCoord.z;
+
+	//Adding the depth slope over the pixel to the second moment
+	//reduces acne on surfaces that are steep as seen from the light
+	float dx = dFdx(depth);
+	float dy = dFdy(depth);
+	res_Color = vec4(depth, depth*depth + 0.25*(dx*dx + dy*dy), 0.0, 1.0);
+}
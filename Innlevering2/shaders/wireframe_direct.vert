@@ -0,0 +1,30 @@
+#version 150
+uniform mat4 modelviewprojection_matrix;
+uniform mat4 modelview_matrix_inverse;
+uniform mat4 light_matrix;
+uniform vec3 light_pos;
+uniform mat4 shadow_matrix;
+
+in vec3 position;
+in vec3 normal;
+
+//Same as wireframe.vert, but writes the fragment shader inputs directly.
+//The triangles are rasterized as lines with glPolygonMode instead of
+//being turned into line strips by wireframe.geom
+smooth out vec3 f_v;
+smooth out vec3 f_l;
+smooth out vec3 f_n;
+smooth out vec4 f_shadow_coord;
+
+void main() {	
+	float homogeneous_divide = (1.0f/modelview_matrix_inverse[3].w);
+	vec3 cam_pos_world = modelview_matrix_inverse[3].xyz*homogeneous_divide;
+
+	f_v = normalize(cam_pos_world - position);
+	f_l = normalize(light_pos - position);
+	f_n = normalize(normal);
+
+	gl_Position = modelviewprojection_matrix * vec4(position, 1.0);
+
+	f_shadow_coord = shadow_matrix * vec4(position, 1.0);
+}
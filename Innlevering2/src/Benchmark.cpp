@@ -0,0 +1,143 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	/**
+	* Nearest rank: the smallest time at least the param fraction of the
+	* sorted frame times are within
+	*/
+	double percentile(const std::vector<double>& sorted, double fraction) {
+		size_t rank = static_cast<size_t>(std::ceil(fraction*sorted.size()));
+		return sorted.at(std::max<size_t>(rank, 1) - 1);
+	}
+}
+
+FrameTimeStats::FrameTimeStats(std::vector<double> frame_ms) {
+	mean = p50 = p95 = p99 = max = 0.0;
+	if(frame_ms.empty())
+		return;
+
+	std::sort(frame_ms.begin(), frame_ms.end());
+	for(unsigned int i = 0; i < frame_ms.size(); i++)
+		mean += frame_ms.at(i);
+	mean /= frame_ms.size();
+
+	p50 = percentile(frame_ms, 0.50);
+	p95 = percentile(frame_ms, 0.95);
+	p99 = percentile(frame_ms, 0.99);
+	max = frame_ms.back();
+}
+
+std::vector<BenchmarkScenario> getBenchmarkScenarios() {
+	struct Entry {
+		const char* name;
+		unsigned int models;
+		bool open_room;
+		BenchmarkScenario::RenderModes render_mode;
+		BenchmarkScenario::CameraPaths camera_path;
+		bool rotate_light;
+	};
+	const Entry entries[] = {
+		{"phong_cube_20_static",		20,  false, BenchmarkScenario::PHONG,		BenchmarkScenario::CAMERA_STATIC, false},
+		{"phong_cube_20_orbit",			20,  false, BenchmarkScenario::PHONG,		BenchmarkScenario::CAMERA_ORBIT,  false},
+		{"phong_cube_20_light",			20,  false, BenchmarkScenario::PHONG,		BenchmarkScenario::CAMERA_STATIC, true},
+		{"phong_room_20_orbit_light",	20,  true,  BenchmarkScenario::PHONG,		BenchmarkScenario::CAMERA_ORBIT,  true},
+		{"phong_cube_100_zoom",			100, false, BenchmarkScenario::PHONG,		BenchmarkScenario::CAMERA_ZOOM,   false},
+		{"phong_room_200_orbit_light",	200, true,  BenchmarkScenario::PHONG,		BenchmarkScenario::CAMERA_ORBIT,  true},
+		{"wireframe_cube_20_orbit",		20,  false, BenchmarkScenario::WIREFRAME,	BenchmarkScenario::CAMERA_ORBIT,  false},
+		{"wireframe_room_100_zoom",		100, true,  BenchmarkScenario::WIREFRAME,	BenchmarkScenario::CAMERA_ZOOM,   false},
+		{"hidden_line_cube_20_orbit",	20,  false, BenchmarkScenario::HIDDEN_LINE, BenchmarkScenario::CAMERA_ORBIT,  false},
+		{"hidden_line_room_100_light",	100, true,  BenchmarkScenario::HIDDEN_LINE, BenchmarkScenario::CAMERA_STATIC, true}
+	};
+
+	std::vector<BenchmarkScenario> scenarios;
+	for(unsigned int i = 0; i < sizeof(entries)/sizeof(entries[0]); i++) {
+		BenchmarkScenario scenario;
+		scenario.name = entries[i].name;
+		scenario.models = entries[i].models;
+		scenario.open_room = entries[i].open_room;
+		scenario.render_mode = entries[i].render_mode;
+		scenario.camera_path = entries[i].camera_path;
+		scenario.rotate_light = entries[i].rotate_light;
+		scenario.warmup_frames = 30;
+		scenario.frames = 300;
+		scenarios.push_back(scenario);
+	}
+	return scenarios;
+}
+
+namespace {
+	std::string escapeJSON(const std::string& str) {
+		std::string escaped;
+		for(unsigned int i = 0; i < str.size(); i++) {
+			if(str[i] == '"' || str[i] == '\\')
+				escaped += '\\';
+			if(static_cast<unsigned char>(str[i]) >= 0x20)
+				escaped += str[i];
+		}
+		return escaped;
+	}
+
+	void writeStats(std::ostream& out, const char* name, const std::vector<double>& frame_ms) {
+		FrameTimeStats stats(frame_ms);
+		out << "\"" << name << "\": {\"mean\": " << stats.mean << ", \"p50\": " << stats.p50
+			<< ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << "}";
+	}
+
+	/**
+	* Writes the mean GL call counts per frame
+	*/
+	void writeCounters(std::ostream& out, const GLUtils::GLCounters& counters, unsigned int frames) {
+		double f = static_cast<double>(frames);
+		out << ", \"draw_calls\": " << counters.draw_calls/f << ", \"vertices\": " << counters.vertices/f
+			<< ", \"triangles\": " << counters.triangles/f << ", \"program_binds\": " << counters.program_binds/f
+			<< ", \"vao_binds\": " << counters.vao_binds/f << ", \"texture_binds\": " << counters.texture_binds/f
+			<< ", \"framebuffer_binds\": " << counters.framebuffer_binds/f
+			<< ", \"uniform_uploads\": " << counters.uniform_uploads/f << ", \"buffer_bytes\": " << counters.buffer_bytes/f;
+	}
+}
+
+void writeBenchmarkJSON(std::ostream& out, const std::vector<BenchmarkResult>& results,
+						unsigned int seed, const std::string& renderer, unsigned int width, unsigned int height,
+						bool pipeline_statistics) {
+	const char* render_modes[] = {"phong", "wireframe", "hidden_line"};
+	const char* camera_paths[] = {"static", "orbit", "zoom"};
+
+	out << "{" << std::endl;
+	out << "  \"seed\": " << seed << "," << std::endl;
+	out << "  \"renderer\": \"" << escapeJSON(renderer) << "\"," << std::endl;
+	out << "  \"width\": " << width << "," << std::endl;
+	out << "  \"height\": " << height << "," << std::endl;
+	out << "  \"pipeline_statistics\": " << (pipeline_statistics ? "true" : "false") << "," << std::endl;
+	out << "  \"scenarios\": [" << std::endl;
+	for(unsigned int i = 0; i < results.size(); i++) {
+		const BenchmarkScenario& scenario = results.at(i).scenario;
+		out << "    {\"name\": \"" << escapeJSON(scenario.name) << "\", \"models\": " << scenario.models
+			<< ", \"environment\": \"" << (scenario.open_room ? "open_room" : "cube") << "\""
+			<< ", \"render_mode\": \"" << render_modes[scenario.render_mode] << "\""
+			<< ", \"camera\": \"" << camera_paths[scenario.camera_path] << "\""
+			<< ", \"rotate_light\": " << (scenario.rotate_light ? "true" : "false")
+			<< ", \"frames\": " << scenario.frames << "," << std::endl << "     ";
+		writeStats(out, "cpu_ms", results.at(i).cpu_ms);
+		out << "," << std::endl << "     ";
+		writeStats(out, "gpu_ms", results.at(i).gpu_ms);
+		out << "," << std::endl << "     \"passes\": [";
+		const std::vector<PassResult>& passes = results.at(i).passes;
+		for(unsigned int j = 0; j < passes.size(); j++) {
+			out << std::endl << "       {\"name\": \"" << passes.at(j).name << "\", ";
+			writeStats(out, "gpu_ms", passes.at(j).gpu_ms);
+			if(pipeline_statistics)
+				out << ", \"vertex_invocations\": " << passes.at(j).vertices
+					<< ", \"primitives\": " << passes.at(j).primitives
+					<< ", \"fragment_invocations\": " << passes.at(j).fragments;
+			if(GLUtils::gl_counters_enabled && passes.at(j).counted_frames > 0)
+				writeCounters(out, passes.at(j).counters, passes.at(j).counted_frames);
+			out << "}" << (j+1 < passes.size() ? "," : "");
+		}
+		out << "]}" << (i+1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
@@ -1,6 +1,7 @@
 #include "CubeMap.h"
 
 #include "GLUtils/GLUtils.hpp"
+#include "Profiler.h"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -40,6 +41,7 @@ GLubyte CubeMap::quad_indices[] = {
 std::shared_ptr<GLUtils::Program> CubeMap::cubemap_program = NULL;
 GLuint CubeMap::vao = -1;
 CubeMap::CubeMap(std::string base_filename, std::string extension) {
+	PROFILE_FUNCTION();
 	//Load cubemap from file
 	cubemap = GLUtils::loadCubeMap(base_filename, extension);
 
@@ -0,0 +1,72 @@
+#include "CubeShadowFBO.h"
+#include "GLUtils/GLUtils.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+
+CubeShadowFBO::CubeShadowFBO(unsigned int size, GLenum depth_format) {
+	this->size = size;
+	this->depth_format = depth_format;
+
+	// Initialize the depth cube map. Linear filtering with compare mode
+	// gives a 2x2 PCF lookup through samplerCubeShadow
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	for(int i = 0; i < 6; i++)
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, 0, depth_format, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	// Attaching the whole cube map makes the FBO layered
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
+
+	//Check for completeness
+	CHECK_GL_FBO_COMPLETENESS();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtils::labelObject(GL_TEXTURE, texture, "cube shadow map depth");
+	GLUtils::labelObject(GL_FRAMEBUFFER, fbo, "cube shadow map");
+	CHECK_GL_ERRORS();
+}
+
+CubeShadowFBO::~CubeShadowFBO() {
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &texture);
+}
+
+void CubeShadowFBO::bind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void CubeShadowFBO::unbind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
+}
+
+glm::mat4 CubeShadowFBO::getFaceMatrix(unsigned int face, const glm::vec3& position, float near_clip, float far_clip) {
+	static const glm::vec3 directions[6] = {
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+		glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+		glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+	};
+	static const glm::vec3 ups[6] = {
+		glm::vec3(0, -1, 0), glm::vec3(0, -1, 0),
+		glm::vec3(0, 0, 1), glm::vec3(0, 0, -1),
+		glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)
+	};
+
+	glm::mat4 projection = glm::perspective(90.0f, 1.0f, near_clip, far_clip);
+	glm::mat4 view = glm::lookAt(position, position+directions[face], ups[face]);
+	return projection*view;
+}
@@ -0,0 +1,116 @@
+#include "FeatureEdges.h"
+#include "GLUtils/GLCounters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace {
+	/**
+	* Lexicographic order of positions, for welding vertices in a std::map
+	*/
+	struct PositionLess {
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+			if(a.x != b.x) return a.x < b.x;
+			if(a.y != b.y) return a.y < b.y;
+			return a.z < b.z;
+		}
+	};
+
+	/**
+	* The triangles sharing an edge. Each triangle is stored as the edge in
+	* its own winding order followed by the vertex opposite the edge.
+	*/
+	struct EdgeTriangles {
+		unsigned int triangle[2][3];
+		unsigned int count;
+	};
+
+	glm::vec3 triangleNormal(const std::vector<glm::vec3>& positions, const unsigned int* triangle) {
+		glm::vec3 a = positions.at(triangle[0]);
+		return glm::cross(positions.at(triangle[1]) - a, positions.at(triangle[2]) - a);
+	}
+}
+
+FeatureEdges::FeatureEdges(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, float crease_angle) {
+	//Weld the vertices by position
+	std::map<glm::vec3, unsigned int, PositionLess> position_ids;
+	std::vector<unsigned int> welded(positions.size());
+	for(unsigned int i = 0; i < positions.size(); i++) {
+		unsigned int id = position_ids.size();
+		welded[i] = position_ids.insert(std::make_pair(positions[i], id)).first->second;
+	}
+
+	//Collect the triangles of each unique edge
+	std::map<std::pair<unsigned int, unsigned int>, EdgeTriangles> edges;
+	for(unsigned int t = 0; t + 2 < indices.size(); t += 3) {
+		for(unsigned int e = 0; e < 3; e++) {
+			unsigned int a = indices[t+e];
+			unsigned int b = indices[t+(e+1)%3];
+			unsigned int c = indices[t+(e+2)%3];
+			if(welded[a] == welded[b])
+				continue;
+
+			std::pair<unsigned int, unsigned int> key(std::min(welded[a], welded[b]), std::max(welded[a], welded[b]));
+			EdgeTriangles& edge = edges[key];
+			if(edge.count < 2) {
+				edge.triangle[edge.count][0] = a;
+				edge.triangle[edge.count][1] = b;
+				edge.triangle[edge.count][2] = c;
+			}
+			edge.count++;
+		}
+	}
+
+	//Classify them
+	float crease_cos = cos(crease_angle*3.14159265f/180.0f);
+	std::vector<unsigned int> boundaries, creases, silhouettes;
+	for(auto it = edges.begin(); it != edges.end(); ++it) {
+		const EdgeTriangles& edge = it->second;
+		const unsigned int* first = edge.triangle[0];
+		if(edge.count != 2) {
+			boundaries.push_back(first[0]);
+			boundaries.push_back(first[1]);
+			continue;
+		}
+
+		glm::vec3 n0 = triangleNormal(positions, edge.triangle[0]);
+		glm::vec3 n1 = triangleNormal(positions, edge.triangle[1]);
+		float length_product = glm::length(n0)*glm::length(n1);
+		if(length_product > 0.0f && glm::dot(n0, n1) < crease_cos*length_product) {
+			creases.push_back(first[0]);
+			creases.push_back(first[1]);
+		}
+		else {
+			silhouettes.push_back(first[2]);
+			silhouettes.push_back(first[0]);
+			silhouettes.push_back(first[1]);
+			silhouettes.push_back(edge.triangle[1][2]);
+		}
+	}
+
+	boundary_count = boundaries.size()/2;
+	crease_count = creases.size()/2;
+	silhouette_count = silhouettes.size()/4;
+
+	std::vector<unsigned int> data;
+	data.reserve(boundaries.size() + creases.size() + silhouettes.size());
+	data.insert(data.end(), boundaries.begin(), boundaries.end());
+	data.insert(data.end(), creases.begin(), creases.end());
+	data.insert(data.end(), silhouettes.begin(), silhouettes.end());
+	edge_indices.reset(new GLUtils::BO<GL_ELEMENT_ARRAY_BUFFER>(data.data(), data.size()*sizeof(unsigned int)));
+}
+
+FeatureEdges::~FeatureEdges() {
+
+}
+
+void FeatureEdges::drawFeatureEdges() {
+	glDrawElements(GL_LINES, 2*(boundary_count + crease_count), GL_UNSIGNED_INT, (void*)0);
+}
+
+void FeatureEdges::drawSilhouetteCandidates() {
+	glDrawElements(GL_LINES_ADJACENCY, 4*silhouette_count, GL_UNSIGNED_INT,
+		(void*)(sizeof(unsigned int)*2*(boundary_count + crease_count)));
+}
@@ -0,0 +1,157 @@
+#include "FlightRecorder.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+namespace {
+	std::atomic<unsigned long long> allocation_count(0);
+	std::atomic<unsigned long long> allocated_bytes(0);
+}
+
+//Counting every heap allocation of the program
+void* operator new(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	void* pointer = std::malloc(size > 0 ? size : 1);
+	if(pointer == NULL)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* pointer) throw() {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) throw() {
+	std::free(pointer);
+}
+
+const double FlightRecorder::dump_cooldown_s = 5.0;
+
+FlightRecorder::FlightRecorder(unsigned int capacity, double budget_ms) {
+	frames.resize(std::max(capacity, frames_after + 1));
+	next = 0;
+	count = 0;
+	this->budget_ms = budget_ms;
+	output_prefix = "hitch_";
+
+	last_allocations = allocationCount();
+	last_allocated_bytes = allocatedBytes();
+	recorded_frames = 0;
+	frames_until_dump = -1;
+	hitch_frame = 0;
+	hitch_ms = 0.0;
+	last_dump_s = -dump_cooldown_s;
+	dumps = 0;
+}
+
+unsigned long long FlightRecorder::allocationCount() {
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+unsigned long long FlightRecorder::allocatedBytes() {
+	return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+void FlightRecorder::recordFrame(FrameRecord record) {
+	unsigned long long allocations = allocationCount();
+	unsigned long long bytes = allocatedBytes();
+	record.allocations = allocations - last_allocations;
+	record.allocated_bytes = bytes - last_allocated_bytes;
+	last_allocations = allocations;
+	last_allocated_bytes = bytes;
+
+	frames[next] = record;
+	next = (next + 1) % frames.size();
+	count = std::min(count + 1, static_cast<unsigned int>(frames.size()));
+	recorded_frames++;
+
+	if(frames_until_dump < 0 && budget_ms > 0.0 && recorded_frames > warmup_frames
+	   && record.frame_ms > budget_ms && record.time_s - last_dump_s >= dump_cooldown_s) {
+		frames_until_dump = frames_after;
+		hitch_frame = record.frame;
+		hitch_ms = record.frame_ms;
+		last_dump_s = record.time_s;
+	}
+	else if(frames_until_dump > 0) {
+		frames_until_dump--;
+	}
+	if(frames_until_dump == 0) {
+		dump();
+		frames_until_dump = -1;
+	}
+}
+
+void FlightRecorder::addGPUResults(const PassQueries::FrameStats& stats) {
+	//Frame numbers follow each other, so the frame is found from the newest one
+	if(count == 0)
+		return;
+	unsigned int size = static_cast<unsigned int>(frames.size());
+	unsigned int newest = (next + size - 1) % size;
+	unsigned int age = frames[newest].frame - stats.frame;
+	if(age >= count)
+		return;
+	FrameRecord& record = frames[(newest + size - age) % size];
+	if(record.frame != stats.frame)
+		return;
+
+	record.gpu_measured = true;
+	for(unsigned int i = 0; i < PassQueries::PASS_COUNT; i++) {
+		record.gpu_ms[i] = stats.measured[i] ? stats.gpu_ms[i] : 0.0;
+		record.primitives[i] = stats.primitives[i];
+		record.fragments[i] = stats.fragments[i];
+	}
+}
+
+void FlightRecorder::dump() {
+	std::ostringstream filename;
+	filename << output_prefix << hitch_frame << ".json";
+	std::ofstream out(filename.str().c_str());
+	if(!out.good()) {
+		std::cout << "Could not write the flight record " << filename.str() << std::endl;
+		return;
+	}
+
+	out << "{\"hitch_frame\": " << hitch_frame << ", \"hitch_ms\": " << hitch_ms
+		<< ", \"budget_ms\": " << budget_ms << ", \"frames\": [" << std::endl;
+	unsigned int size = static_cast<unsigned int>(frames.size());
+	for(unsigned int i = 0; i < count; i++) {
+		const FrameRecord& record = frames[(next + size - count + i) % size];
+		out << "  {\"frame\": " << record.frame << ", \"time_s\": " << record.time_s
+			<< ", \"frame_ms\": " << record.frame_ms;
+		if(GLUtils::gl_counters_enabled)
+			out << ", \"draw_calls\": " << record.draw_calls;
+		out << ", \"allocations\": " << record.allocations << ", \"allocated_bytes\": " << record.allocated_bytes
+			<< ", \"passes\": {";
+		for(unsigned int p = 0; p < PassQueries::PASS_COUNT; p++) {
+			out << (p > 0 ? ", " : "") << "\"" << PassQueries::passName(static_cast<PassQueries::Passes>(p))
+				<< "\": {\"cpu_ms\": " << record.cpu_ms[p];
+			if(record.gpu_measured)
+				out << ", \"gpu_ms\": " << record.gpu_ms[p] << ", \"primitives\": " << record.primitives[p]
+					<< ", \"fragments\": " << record.fragments[p];
+			out << "}";
+		}
+		out << "}}" << (i+1 < count ? "," : "") << std::endl;
+	}
+	out << "]}" << std::endl;
+	dumps++;
+	std::cout << "Frame " << hitch_frame << " took " << hitch_ms << " ms (budget " << budget_ms
+			  << " ms), wrote the last " << count << " frames to " << filename.str() << std::endl;
+
+	if(profiler::isEnabled()) {
+		std::ostringstream trace_filename;
+		trace_filename << output_prefix << hitch_frame << ".trace.json";
+		if(profiler::writeChromeTrace(trace_filename.str()))
+			std::cout << "Wrote the profile to " << trace_filename.str() << std::endl;
+	}
+}
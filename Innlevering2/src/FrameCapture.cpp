@@ -0,0 +1,616 @@
+#include "FrameCapture.h"
+#include "GameException.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+	//Object names are found by asking for each one, until this many in a row are unused
+	const GLuint name_scan_gap = 4096;
+
+	//Texture targets the snapshot handles, with the binding each is queried with
+	const GLenum texture_targets_supported[] = {GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER,
+												GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D};
+	const GLenum texture_bindings[] = {GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_BUFFER,
+									   GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_3D};
+	const unsigned int texture_target_count = 5;
+
+	const unsigned int max_texture_units = 32;
+	const GLint max_texture_levels = 16;
+
+	GLint getInteger(GLenum pname) {
+		GLint value = 0;
+		glGetIntegerv(pname, &value);
+		return value;
+	}
+
+	/**
+	* Returns the target of the param texture, found by binding it to each
+	* target in turn on the active unit, or 0 if it has none of those the
+	* snapshot handles. Errors must not reach the debug callback.
+	*/
+	GLenum probeTextureTarget(GLuint texture) {
+		for(unsigned int i = 0; i < texture_target_count; i++) {
+			while(glGetError() != GL_NO_ERROR);
+			glBindTexture(texture_targets_supported[i], texture);
+			if(glGetError() == GL_NO_ERROR)
+				return texture_targets_supported[i];
+		}
+		return 0;
+	}
+
+	/**
+	* Returns the pixel format and type that read a texture of the param
+	* internal format back without loss
+	*/
+	void transferFormat(GLint internal_format, GLenum& format, GLenum& type) {
+		switch(internal_format) {
+		case GL_DEPTH_COMPONENT16:
+			format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_SHORT; return;
+		case GL_DEPTH_COMPONENT:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+			format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_INT; return;
+		case GL_DEPTH_COMPONENT32F:
+			format = GL_DEPTH_COMPONENT; type = GL_FLOAT; return;
+		case GL_DEPTH24_STENCIL8:
+			format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return;
+		case GL_DEPTH32F_STENCIL8:
+			format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; return;
+
+		case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; return;
+		case GL_RG8: format = GL_RG; type = GL_UNSIGNED_BYTE; return;
+		case GL_RGB:
+		case GL_RGB8:
+		case GL_SRGB8: format = GL_RGB; type = GL_UNSIGNED_BYTE; return;
+		case GL_RGBA:
+		case GL_RGBA8:
+		case GL_SRGB8_ALPHA8: format = GL_RGBA; type = GL_UNSIGNED_BYTE; return;
+
+		case GL_R16F: format = GL_RED; type = GL_HALF_FLOAT; return;
+		case GL_RG16F: format = GL_RG; type = GL_HALF_FLOAT; return;
+		case GL_RGB16F: format = GL_RGB; type = GL_HALF_FLOAT; return;
+		case GL_RGBA16F: format = GL_RGBA; type = GL_HALF_FLOAT; return;
+		case GL_R32F: format = GL_RED; type = GL_FLOAT; return;
+		case GL_RG32F: format = GL_RG; type = GL_FLOAT; return;
+		case GL_RGB32F: format = GL_RGB; type = GL_FLOAT; return;
+
+		case GL_R8UI: format = GL_RED_INTEGER; type = GL_UNSIGNED_BYTE; return;
+		case GL_R16UI: format = GL_RED_INTEGER; type = GL_UNSIGNED_SHORT; return;
+		case GL_R32UI: format = GL_RED_INTEGER; type = GL_UNSIGNED_INT; return;
+		case GL_RG32UI: format = GL_RG_INTEGER; type = GL_UNSIGNED_INT; return;
+		case GL_RGBA32UI: format = GL_RGBA_INTEGER; type = GL_UNSIGNED_INT; return;
+		case GL_R32I: format = GL_RED_INTEGER; type = GL_INT; return;
+		case GL_RG32I: format = GL_RG_INTEGER; type = GL_INT; return;
+		case GL_RGBA32I: format = GL_RGBA_INTEGER; type = GL_INT; return;
+
+		default:
+			format = GL_RGBA; type = GL_FLOAT; return;
+		}
+	}
+}
+
+FrameCapture::FrameCapture(unsigned int width, unsigned int height) : width(width), height(height), recording(false) {
+	if(!GLUtils::gl_capture_enabled)
+		THROW_EXCEPTION("Frame capture needs a build with PG612_GL_CAPTURE");
+	GLUtils::GLCaptureState& capture = GLUtils::glCaptureState();
+	if(capture.active)
+		THROW_EXCEPTION("A frame capture is already recording");
+	capture.window_framebuffer = GLUtils::screenFramebuffer();
+
+	//The texture targets are found by provoking errors, which are not the application's
+	bool debug_output = GLUtils::debugOutputState().enabled && glIsEnabled(GL_DEBUG_OUTPUT) == GL_TRUE;
+	if(debug_output)
+		glDisable(GL_DEBUG_OUTPUT);
+	while(glGetError() != GL_NO_ERROR);
+
+	//The state goes first, as the object snapshots change bindings on the way
+	snapshotState();
+
+	GLint pack_alignment = getInteger(GL_PACK_ALIGNMENT);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	objects.call(GLUtils::GLTRACE_PIXEL_STOREI, GL_UNPACK_ALIGNMENT, 1);
+
+	//In the order they refer to each other
+	snapshotBuffers();
+	snapshotTextures();
+	snapshotRenderbuffers();
+	snapshotFramebuffers();
+	snapshotVertexArrays();
+	snapshotPrograms();
+
+	glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment);
+	while(glGetError() != GL_NO_ERROR);
+	if(debug_output)
+		glEnable(GL_DEBUG_OUTPUT);
+
+	capture.frame.clear();
+	capture.active = true;
+	recording = true;
+}
+
+FrameCapture::~FrameCapture() {
+	GLUtils::GLCaptureState& capture = GLUtils::glCaptureState();
+	if(recording)
+		capture.active = false;
+	capture.frame.clear();
+	std::vector<GLuint>().swap(capture.frame.words);
+}
+
+void FrameCapture::write(const std::string& filename) {
+	GLUtils::GLCaptureState& capture = GLUtils::glCaptureState();
+	capture.active = false;
+	recording = false;
+
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if(!file.good())
+		THROW_EXCEPTION("Could not open " + filename + " for writing");
+
+	const std::vector<GLuint>* sections[] = {&objects.words, &state.words, &capture.frame.words};
+	GLuint header[7] = {GLUtils::gl_trace_magic, GLUtils::gl_trace_version, width, height};
+	for(unsigned int i = 0; i < 3; i++)
+		header[4+i] = static_cast<GLuint>(sections[i]->size());
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for(unsigned int i = 0; i < 3; i++)
+		if(!sections[i]->empty())
+			file.write(reinterpret_cast<const char*>(&sections[i]->at(0)), sections[i]->size()*sizeof(GLuint));
+
+	if(!file.good())
+		THROW_EXCEPTION("Could not write " + filename);
+}
+
+void FrameCapture::snapshotState() {
+	GLint values[4];
+	GLfloat floats[4];
+	GLboolean booleans[4];
+
+	state.call(GLUtils::GLTRACE_PIXEL_STOREI, GL_UNPACK_ALIGNMENT, getInteger(GL_UNPACK_ALIGNMENT));
+	state.call(GLUtils::GLTRACE_PIXEL_STOREI, GL_PACK_ALIGNMENT, getInteger(GL_PACK_ALIGNMENT));
+	glGetIntegerv(GL_VIEWPORT, values);
+	state.call(GLUtils::GLTRACE_VIEWPORT, values[0], values[1], values[2], values[3]);
+	glGetIntegerv(GL_SCISSOR_BOX, values);
+	state.call(GLUtils::GLTRACE_SCISSOR, values[0], values[1], values[2], values[3]);
+
+	const GLenum caps[] = {GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_POLYGON_OFFSET_FILL, GL_SCISSOR_TEST,
+						   GL_STENCIL_TEST, GL_TEXTURE_CUBE_MAP_SEAMLESS, GL_PROGRAM_POINT_SIZE, GL_DEPTH_CLAMP,
+						   GL_RASTERIZER_DISCARD, GL_FRAMEBUFFER_SRGB, GL_MULTISAMPLE};
+	for(unsigned int i = 0; i < sizeof(caps)/sizeof(caps[0]); i++)
+		state.call(glIsEnabled(caps[i]) == GL_TRUE ? GLUtils::GLTRACE_ENABLE : GLUtils::GLTRACE_DISABLE, caps[i]);
+
+	state.call(GLUtils::GLTRACE_BLEND_FUNC_SEPARATE, getInteger(GL_BLEND_SRC_RGB), getInteger(GL_BLEND_DST_RGB),
+			   getInteger(GL_BLEND_SRC_ALPHA), getInteger(GL_BLEND_DST_ALPHA));
+	state.call(GLUtils::GLTRACE_BLEND_EQUATION_SEPARATE, getInteger(GL_BLEND_EQUATION_RGB), getInteger(GL_BLEND_EQUATION_ALPHA));
+	state.call(GLUtils::GLTRACE_DEPTH_FUNC, getInteger(GL_DEPTH_FUNC));
+	glGetBooleanv(GL_DEPTH_WRITEMASK, booleans);
+	state.call(GLUtils::GLTRACE_DEPTH_MASK, booleans[0]);
+	glGetBooleanv(GL_COLOR_WRITEMASK, booleans);
+	state.call(GLUtils::GLTRACE_COLOR_MASK, booleans[0], booleans[1], booleans[2], booleans[3]);
+	state.call(GLUtils::GLTRACE_CULL_FACE, getInteger(GL_CULL_FACE_MODE));
+	state.call(GLUtils::GLTRACE_FRONT_FACE, getInteger(GL_FRONT_FACE));
+	glGetIntegerv(GL_POLYGON_MODE, values);
+	state.call(GLUtils::GLTRACE_POLYGON_MODE, GL_FRONT_AND_BACK, values[0]);
+	glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &floats[0]);
+	glGetFloatv(GL_POLYGON_OFFSET_UNITS, &floats[1]);
+	state.call(GLUtils::GLTRACE_POLYGON_OFFSET, floats[0], floats[1]);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, floats);
+	state.call(GLUtils::GLTRACE_CLEAR_COLOR, floats[0], floats[1], floats[2], floats[3]);
+	glGetFloatv(GL_DEPTH_CLEAR_VALUE, floats);
+	state.call(GLUtils::GLTRACE_CLEAR_DEPTH, floats[0]);
+
+	//Every binding is set, also those to 0, so that each replay of the frame starts alike
+	GLint uniform_buffer_bindings = getInteger(GL_MAX_UNIFORM_BUFFER_BINDINGS);
+	for(GLint i = 0; i < uniform_buffer_bindings; i++) {
+		glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, i, values);
+		state.call(GLUtils::GLTRACE_BIND_BUFFER_BASE, GL_UNIFORM_BUFFER, i, values[0]);
+	}
+
+	GLint active_texture = getInteger(GL_ACTIVE_TEXTURE);
+	GLint texture_units = std::min<GLint>(getInteger(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS), max_texture_units);
+	for(GLint unit = 0; unit < texture_units; unit++) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.call(GLUtils::GLTRACE_ACTIVE_TEXTURE, GL_TEXTURE0 + unit);
+		for(unsigned int i = 0; i < texture_target_count; i++)
+			state.call(GLUtils::GLTRACE_BIND_TEXTURE, texture_targets_supported[i], getInteger(texture_bindings[i]));
+	}
+	glActiveTexture(active_texture);
+	state.call(GLUtils::GLTRACE_ACTIVE_TEXTURE, active_texture);
+
+	const GLenum buffer_targets[] = {GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER, GL_PIXEL_PACK_BUFFER,
+									 GL_PIXEL_UNPACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER};
+	const GLenum buffer_bindings[] = {GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_TEXTURE_BUFFER, GL_PIXEL_PACK_BUFFER_BINDING,
+									  GL_PIXEL_UNPACK_BUFFER_BINDING, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER};
+	for(unsigned int i = 0; i < sizeof(buffer_targets)/sizeof(buffer_targets[0]); i++)
+		state.call(GLUtils::GLTRACE_BIND_BUFFER, buffer_targets[i], getInteger(buffer_bindings[i]));
+
+	state.call(GLUtils::GLTRACE_BIND_RENDERBUFFER, GL_RENDERBUFFER, getInteger(GL_RENDERBUFFER_BINDING));
+	state.call(GLUtils::GLTRACE_BIND_VERTEX_ARRAY, getInteger(GL_VERTEX_ARRAY_BINDING));
+	GLint window_framebuffer = GLUtils::screenFramebuffer();
+	GLint draw_framebuffer = getInteger(GL_DRAW_FRAMEBUFFER_BINDING);
+	GLint read_framebuffer = getInteger(GL_READ_FRAMEBUFFER_BINDING);
+	state.call(GLUtils::GLTRACE_BIND_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER, draw_framebuffer == window_framebuffer ? 0 : draw_framebuffer);
+	state.call(GLUtils::GLTRACE_BIND_FRAMEBUFFER, GL_READ_FRAMEBUFFER, read_framebuffer == window_framebuffer ? 0 : read_framebuffer);
+	state.call(GLUtils::GLTRACE_USE_PROGRAM, getInteger(GL_CURRENT_PROGRAM));
+}
+
+void FrameCapture::snapshotBuffers() {
+	GLint copy_read_buffer = getInteger(GL_COPY_READ_BUFFER);
+	std::vector<char> data;
+
+	GLuint last = 0;
+	for(GLuint name = 1; name <= last + name_scan_gap; name++) {
+		if(glIsBuffer(name) != GL_TRUE)
+			continue;
+		last = name;
+
+		GLint size, usage;
+		glBindBuffer(GL_COPY_READ_BUFFER, name);
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &usage);
+		data.resize(size);
+		if(size > 0)
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, &data[0]);
+
+		objects.call(GLUtils::GLTRACE_GEN_BUFFERS, 1, name);
+		objects.call(GLUtils::GLTRACE_BIND_BUFFER, GL_COPY_WRITE_BUFFER, name);
+		objects.begin(GLUtils::GLTRACE_BUFFER_DATA);
+		objects.arg(GL_COPY_WRITE_BUFFER);
+		objects.arg(static_cast<GLuint>(size));
+		objects.arg(static_cast<GLuint>(usage));
+		objects.blob(size > 0 ? &data[0] : NULL, size);
+		objects.end();
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, copy_read_buffer);
+}
+
+void FrameCapture::snapshotTextures() {
+	GLint bound[texture_target_count];
+	for(unsigned int i = 0; i < texture_target_count; i++)
+		bound[i] = getInteger(texture_bindings[i]);
+
+	const GLenum parameters[] = {GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T,
+								 GL_TEXTURE_WRAP_R, GL_TEXTURE_COMPARE_MODE, GL_TEXTURE_COMPARE_FUNC,
+								 GL_TEXTURE_BASE_LEVEL, GL_TEXTURE_MAX_LEVEL};
+
+	GLuint last = 0;
+	for(GLuint name = 1; name <= last + name_scan_gap; name++) {
+		if(glIsTexture(name) != GL_TRUE)
+			continue;
+		last = name;
+
+		GLenum target = probeTextureTarget(name);
+		if(target == 0) {
+			std::cout << "Frame capture: texture " << name << " has a target the capture does not handle" << std::endl;
+			continue;
+		}
+		texture_targets[name] = target;
+		objects.call(GLUtils::GLTRACE_GEN_TEXTURES, 1, name);
+		objects.call(GLUtils::GLTRACE_BIND_TEXTURE, target, name);
+
+		if(target == GL_TEXTURE_BUFFER) {
+			GLint buffer = 0, internal_format = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_BUFFER, 0, GL_TEXTURE_BUFFER_DATA_STORE_BINDING, &buffer);
+			glGetTexLevelParameteriv(GL_TEXTURE_BUFFER, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+			if(buffer != 0)
+				objects.call(GLUtils::GLTRACE_TEX_BUFFER, GL_TEXTURE_BUFFER, internal_format, buffer);
+			continue;
+		}
+
+		for(GLint level = 0; level < max_texture_levels; level++) {
+			if(target == GL_TEXTURE_CUBE_MAP) {
+				bool stored = false;
+				for(unsigned int face = 0; face < 6; face++)
+					stored |= snapshotTextureLevel(target, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level);
+				if(!stored)
+					break;
+			}
+			else if(!snapshotTextureLevel(target, target, level))
+				break;
+		}
+
+		for(unsigned int i = 0; i < sizeof(parameters)/sizeof(parameters[0]); i++) {
+			GLint value;
+			glGetTexParameteriv(target, parameters[i], &value);
+			objects.call(GLUtils::GLTRACE_TEX_PARAMETERI, target, parameters[i], value);
+		}
+	}
+
+	for(unsigned int i = 0; i < texture_target_count; i++)
+		glBindTexture(texture_targets_supported[i], bound[i]);
+}
+
+bool FrameCapture::snapshotTextureLevel(GLenum target, GLenum face, GLint level) {
+	GLint width = 0, height = 0, depth = 0, internal_format = 0;
+	glGetTexLevelParameteriv(face, level, GL_TEXTURE_WIDTH, &width);
+	if(width == 0)
+		return false;
+	glGetTexLevelParameteriv(face, level, GL_TEXTURE_HEIGHT, &height);
+	glGetTexLevelParameteriv(face, level, GL_TEXTURE_DEPTH, &depth);
+	glGetTexLevelParameteriv(face, level, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+
+	GLenum format, type;
+	transferFormat(internal_format, format, type);
+	std::vector<char> pixels(GLUtils::glImageSize(width, height, depth, format, type, 1));
+	glGetTexImage(face, level, format, type, &pixels[0]);
+
+	bool layered = (target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D);
+	objects.begin(layered ? GLUtils::GLTRACE_TEX_IMAGE_3D : GLUtils::GLTRACE_TEX_IMAGE_2D);
+	objects.arg(face);
+	objects.arg(level);
+	objects.arg(internal_format);
+	objects.arg(width);
+	objects.arg(height);
+	if(layered)
+		objects.arg(depth);
+	objects.arg(0);
+	objects.arg(format);
+	objects.arg(type);
+	objects.blob(&pixels[0], pixels.size());
+	objects.end();
+	return true;
+}
+
+void FrameCapture::snapshotRenderbuffers() {
+	GLint bound = getInteger(GL_RENDERBUFFER_BINDING);
+
+	GLuint last = 0;
+	for(GLuint name = 1; name <= last + name_scan_gap; name++) {
+		if(glIsRenderbuffer(name) != GL_TRUE)
+			continue;
+		last = name;
+
+		GLint internal_format, width, height, samples;
+		glBindRenderbuffer(GL_RENDERBUFFER, name);
+		glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &internal_format);
+		glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &width);
+		glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &height);
+		glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_SAMPLES, &samples);
+
+		//Only the storage, as renderbuffers are rendered to and not sampled
+		objects.call(GLUtils::GLTRACE_GEN_RENDERBUFFERS, 1, name);
+		objects.call(GLUtils::GLTRACE_BIND_RENDERBUFFER, GL_RENDERBUFFER, name);
+		if(width > 0 && height > 0)
+			objects.call(GLUtils::GLTRACE_RENDERBUFFER_STORAGE_MULTISAMPLE, GL_RENDERBUFFER, samples, internal_format, width, height);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, bound);
+}
+
+void FrameCapture::snapshotFramebuffers() {
+	GLint draw_framebuffer = getInteger(GL_DRAW_FRAMEBUFFER_BINDING);
+	GLint read_framebuffer = getInteger(GL_READ_FRAMEBUFFER_BINDING);
+	GLint max_draw_buffers = getInteger(GL_MAX_DRAW_BUFFERS);
+
+	std::vector<GLenum> attachments;
+	GLint max_color_attachments = getInteger(GL_MAX_COLOR_ATTACHMENTS);
+	for(GLint i = 0; i < max_color_attachments; i++)
+		attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
+	attachments.push_back(GL_DEPTH_ATTACHMENT);
+	attachments.push_back(GL_STENCIL_ATTACHMENT);
+
+	GLuint last = 0;
+	for(GLuint name = 1; name <= last + name_scan_gap; name++) {
+		if(glIsFramebuffer(name) != GL_TRUE)
+			continue;
+		last = name;
+		//The headless context's framebuffer is the replayer's own
+		if(name == GLUtils::screenFramebuffer())
+			continue;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, name);
+		objects.call(GLUtils::GLTRACE_GEN_FRAMEBUFFERS, 1, name);
+		objects.call(GLUtils::GLTRACE_BIND_FRAMEBUFFER, GL_FRAMEBUFFER, name);
+
+		for(unsigned int i = 0; i < attachments.size(); i++) {
+			GLenum attachment = attachments.at(i);
+			GLint type = GL_NONE, object = 0;
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+			if(type == GL_NONE)
+				continue;
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &object);
+
+			if(type == GL_RENDERBUFFER) {
+				objects.call(GLUtils::GLTRACE_FRAMEBUFFER_RENDERBUFFER, GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, object);
+				continue;
+			}
+
+			GLint level, face, layered, layer;
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL, &level);
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_CUBE_MAP_FACE, &face);
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_LAYERED, &layered);
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LAYER, &layer);
+			GLenum target = texture_targets[object];
+			if(layered == GL_TRUE)
+				objects.call(GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE, GL_FRAMEBUFFER, attachment, object, level);
+			else if(target == GL_TEXTURE_CUBE_MAP)
+				objects.call(GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE_2D, GL_FRAMEBUFFER, attachment, face, object, level);
+			else if(target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D)
+				objects.call(GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE_LAYER, GL_FRAMEBUFFER, attachment, object, level, layer);
+			else
+				objects.call(GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE_2D, GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, object, level);
+		}
+
+		std::vector<GLint> draw_buffers;
+		for(GLint i = 0; i < max_draw_buffers; i++)
+			draw_buffers.push_back(getInteger(GL_DRAW_BUFFER0 + i));
+		while(!draw_buffers.empty() && draw_buffers.back() == GL_NONE)
+			draw_buffers.pop_back();
+		if(draw_buffers.empty()) {
+			objects.call(GLUtils::GLTRACE_DRAW_BUFFER, GL_NONE);
+		}
+		else {
+			objects.begin(GLUtils::GLTRACE_DRAW_BUFFERS);
+			objects.arg(static_cast<GLint>(draw_buffers.size()));
+			for(unsigned int i = 0; i < draw_buffers.size(); i++)
+				objects.arg(draw_buffers.at(i));
+			objects.end();
+		}
+		objects.call(GLUtils::GLTRACE_READ_BUFFER, getInteger(GL_READ_BUFFER));
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+}
+
+void FrameCapture::snapshotVertexArrays() {
+	GLint bound = getInteger(GL_VERTEX_ARRAY_BINDING);
+	GLint max_attributes = getInteger(GL_MAX_VERTEX_ATTRIBS);
+
+	GLuint last = 0;
+	for(GLuint name = 1; name <= last + name_scan_gap; name++) {
+		if(glIsVertexArray(name) != GL_TRUE)
+			continue;
+		last = name;
+
+		glBindVertexArray(name);
+		objects.call(GLUtils::GLTRACE_GEN_VERTEX_ARRAYS, 1, name);
+		objects.call(GLUtils::GLTRACE_BIND_VERTEX_ARRAY, name);
+		objects.call(GLUtils::GLTRACE_BIND_BUFFER, GL_ELEMENT_ARRAY_BUFFER, getInteger(GL_ELEMENT_ARRAY_BUFFER_BINDING));
+
+		for(GLint i = 0; i < max_attributes; i++) {
+			GLint buffer, enabled, size, type, normalized, stride, integer, divisor;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+			if(buffer == 0 && enabled != GL_TRUE)
+				continue;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &normalized);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &integer);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &divisor);
+			GLvoid* pointer = NULL;
+			glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+			GLuint offset = static_cast<GLuint>(reinterpret_cast<size_t>(pointer));
+
+			if(buffer != 0) {
+				objects.call(GLUtils::GLTRACE_BIND_BUFFER, GL_ARRAY_BUFFER, buffer);
+				if(integer == GL_TRUE)
+					objects.call(GLUtils::GLTRACE_VERTEX_ATTRIB_I_POINTER, i, size, type, stride, offset);
+				else
+					objects.call(GLUtils::GLTRACE_VERTEX_ATTRIB_POINTER, i, size, type, normalized, stride, offset);
+			}
+			if(divisor != 0)
+				objects.call(GLUtils::GLTRACE_VERTEX_ATTRIB_DIVISOR, i, divisor);
+			if(enabled == GL_TRUE)
+				objects.call(GLUtils::GLTRACE_ENABLE_VERTEX_ATTRIB_ARRAY, i);
+		}
+	}
+	objects.call(GLUtils::GLTRACE_BIND_VERTEX_ARRAY, 0);
+	glBindVertexArray(bound);
+}
+
+void FrameCapture::snapshotPrograms() {
+	const std::map<GLuint, GLUtils::GLProgramSources>& programs = GLUtils::glCaptureState().program_sources;
+	std::vector<char> name_buffer;
+
+	for(std::map<GLuint, GLUtils::GLProgramSources>::const_iterator it = programs.begin(); it != programs.end(); it++) {
+		GLuint program = it->first;
+		GLint linked = GL_FALSE;
+		if(glIsProgram(program) == GL_TRUE)
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if(linked != GL_TRUE)
+			continue;
+
+		//Attributes keep their locations, as the application queried them after linking
+		GLint count, max_length;
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+		name_buffer.resize(max_length + 1);
+		std::vector<std::pair<GLint, std::string> > attributes;
+		for(GLint i = 0; i < count; i++) {
+			GLint size;
+			GLenum type;
+			glGetActiveAttrib(program, i, static_cast<GLsizei>(name_buffer.size()), NULL, &size, &type, &name_buffer[0]);
+			GLint location = glGetAttribLocation(program, &name_buffer[0]);
+			if(location >= 0)
+				attributes.push_back(std::make_pair(location, std::string(&name_buffer[0])));
+		}
+
+		const GLUtils::GLProgramSources& sources = it->second;
+		objects.begin(GLUtils::GLTRACE_CREATE_PROGRAM);
+		objects.arg(program);
+		objects.arg(static_cast<GLuint>(sources.sources.size()));
+		for(unsigned int i = 0; i < sources.sources.size(); i++) {
+			objects.arg(sources.types.at(i));
+			objects.string(sources.sources.at(i));
+		}
+		objects.arg(static_cast<GLuint>(attributes.size()));
+		for(unsigned int i = 0; i < attributes.size(); i++) {
+			objects.arg(attributes.at(i).first);
+			objects.string(attributes.at(i).second);
+		}
+		objects.end();
+
+		//The values of the default block uniforms, element by element for arrays
+		objects.call(GLUtils::GLTRACE_USE_PROGRAM, program);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+		name_buffer.resize(max_length + 1);
+		for(GLint i = 0; i < count; i++) {
+			GLuint index = i;
+			GLint size, block_index;
+			GLenum type, base_type;
+			glGetActiveUniform(program, index, static_cast<GLsizei>(name_buffer.size()), NULL, &size, &type, &name_buffer[0]);
+			glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block_index);
+			if(block_index != -1)
+				continue;
+			unsigned int components = GLUtils::glUniformComponents(type, base_type);
+			if(components == 0) {
+				std::cout << "Frame capture: uniform " << &name_buffer[0] << " has a type the capture does not handle" << std::endl;
+				continue;
+			}
+
+			std::string name = &name_buffer[0];
+			bool array = name.size() > 3 && name.compare(name.size()-3, 3, "[0]") == 0;
+			if(array)
+				name.erase(name.size()-3);
+			for(GLint element = 0; element < size; element++) {
+				std::stringstream element_name;
+				element_name << name;
+				if(array)
+					element_name << "[" << element << "]";
+				GLint location = glGetUniformLocation(program, element_name.str().c_str());
+				if(location < 0)
+					continue;
+
+				GLuint values[16];
+				if(base_type == GL_FLOAT)
+					glGetUniformfv(program, location, reinterpret_cast<GLfloat*>(values));
+				else if(base_type == GL_UNSIGNED_INT)
+					glGetUniformuiv(program, location, values);
+				else
+					glGetUniformiv(program, location, reinterpret_cast<GLint*>(values));
+
+				objects.begin(GLUtils::GLTRACE_PROGRAM_UNIFORM);
+				objects.arg(program);
+				objects.arg(location);
+				objects.string(element_name.str());
+				objects.end();
+				objects.begin(GLUtils::GLTRACE_UNIFORM_VALUE);
+				objects.arg(location);
+				objects.arg(type);
+				for(unsigned int c = 0; c < components; c++)
+					objects.arg(values[c]);
+				objects.end();
+			}
+		}
+
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		for(GLint i = 0; i < count; i++) {
+			GLint binding, length;
+			glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+			glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+			name_buffer.resize(length + 1);
+			glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name_buffer.size()), NULL, &name_buffer[0]);
+
+			objects.begin(GLUtils::GLTRACE_UNIFORM_BLOCK_BINDING);
+			objects.arg(program);
+			objects.arg(binding);
+			objects.string(&name_buffer[0]);
+			objects.end();
+		}
+	}
+	objects.call(GLUtils::GLTRACE_USE_PROGRAM, 0);
+}
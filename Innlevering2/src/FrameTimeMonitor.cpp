@@ -0,0 +1,143 @@
+#include "FrameTimeMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+const double FrameTimeMonitor::min_bin_ms = 0.1;
+const double FrameTimeMonitor::max_bin_ms = 1000.0;
+
+FrameTimeMonitor::FrameTimeMonitor(unsigned int window, double stutter_factor) {
+	frame_ms.resize(std::max(window, 2u), 0.0);
+	stutter.resize(frame_ms.size(), false);
+	next = 0;
+	count = 0;
+	std::fill(histogram, histogram + bin_count, 0u);
+	this->stutter_factor = stutter_factor;
+
+	sum = sum_squares = pacing_sum_squares = 0.0;
+	window_stutters = 0;
+	total_frames = total_stutters = 0;
+	last_stutter.frame = 0;
+	last_stutter.frame_ms = last_stutter.median_ms = 0.0;
+	log_bin_scale = bin_count / std::log(max_bin_ms/min_bin_ms);
+}
+
+unsigned int FrameTimeMonitor::binOf(double frame_ms) const {
+	if(frame_ms <= min_bin_ms)
+		return 0;
+	double bin = std::log(frame_ms/min_bin_ms)*log_bin_scale;
+	return std::min(static_cast<unsigned int>(bin), bin_count-1);
+}
+
+double FrameTimeMonitor::binStart(unsigned int bin) const {
+	return min_bin_ms*std::exp(bin/log_bin_scale);
+}
+
+bool FrameTimeMonitor::addFrame(double frame_ms) {
+	unsigned int size = static_cast<unsigned int>(this->frame_ms.size());
+	unsigned int previous = (next + size - 1) % size;
+
+	//A stutter compared with the frames before it, once there are enough of them
+	bool is_stutter = false;
+	if(count >= 10) {
+		double median = percentile(0.5);
+		if(frame_ms > stutter_factor*median) {
+			is_stutter = true;
+			last_stutter.frame = total_frames;
+			last_stutter.frame_ms = frame_ms;
+			last_stutter.median_ms = median;
+			total_stutters++;
+		}
+	}
+
+	//Drop the oldest frame, and its change from the one after it
+	if(count == size) {
+		double oldest = this->frame_ms[next];
+		double after_oldest = this->frame_ms[(next + 1) % size];
+		histogram[binOf(oldest)]--;
+		sum -= oldest;
+		sum_squares -= oldest*oldest;
+		pacing_sum_squares -= (after_oldest - oldest)*(after_oldest - oldest);
+		if(stutter[next])
+			window_stutters--;
+		count--;
+	}
+
+	if(count > 0) {
+		double change = frame_ms - this->frame_ms[previous];
+		pacing_sum_squares += change*change;
+	}
+	this->frame_ms[next] = frame_ms;
+	stutter[next] = is_stutter;
+	histogram[binOf(frame_ms)]++;
+	sum += frame_ms;
+	sum_squares += frame_ms*frame_ms;
+	if(is_stutter)
+		window_stutters++;
+	next = (next + 1) % size;
+	count++;
+	total_frames++;
+
+	//The running sums drift, so they are summed again once per window
+	if(next == 0) {
+		sum = sum_squares = pacing_sum_squares = 0.0;
+		for(unsigned int i = 0; i < size; i++) {
+			sum += this->frame_ms[i];
+			sum_squares += this->frame_ms[i]*this->frame_ms[i];
+			if(i > 0) {
+				double change = this->frame_ms[i] - this->frame_ms[i-1];
+				pacing_sum_squares += change*change;
+			}
+		}
+	}
+	return is_stutter;
+}
+
+double FrameTimeMonitor::percentile(double fraction) const {
+	if(count == 0)
+		return 0.0;
+
+	//Nearest rank, placed within its bin assuming the frames are spread evenly over it
+	double rank = std::max(std::ceil(fraction*count), 1.0);
+	unsigned int below = 0;
+	for(unsigned int bin = 0; bin < bin_count; bin++) {
+		if(below + histogram[bin] >= rank) {
+			double position = (rank - below - 0.5) / histogram[bin];
+			return binStart(bin)*std::exp(position/log_bin_scale);
+		}
+		below += histogram[bin];
+	}
+	return max_bin_ms;
+}
+
+FrameTimeMonitor::Summary FrameTimeMonitor::getSummary() const {
+	Summary summary;
+	summary.frames = count;
+	summary.mean_ms = count > 0 ? sum/count : 0.0;
+	summary.fps = summary.mean_ms > 0.0 ? 1000.0/summary.mean_ms : 0.0;
+	summary.p50_ms = percentile(0.50);
+	summary.p95_ms = percentile(0.95);
+	summary.p99_ms = percentile(0.99);
+
+	summary.max_ms = 0.0;
+	unsigned int size = static_cast<unsigned int>(frame_ms.size());
+	for(unsigned int i = 0; i < count; i++)
+		summary.max_ms = std::max(summary.max_ms, frame_ms[(next + size - 1 - i) % size]);
+
+	double variance = count > 0 ? sum_squares/count - summary.mean_ms*summary.mean_ms : 0.0;
+	summary.stdev_ms = std::sqrt(std::max(variance, 0.0));
+	summary.pacing_ms = count > 1 ? std::sqrt(std::max(pacing_sum_squares, 0.0)/(count-1)) : 0.0;
+	summary.stutters = window_stutters;
+	return summary;
+}
+
+void FrameTimeMonitor::writeJSONLine(std::ostream& out, double time_s) const {
+	Summary summary = getSummary();
+	out << "{\"time\": " << time_s << ", \"frames\": " << summary.frames
+		<< ", \"fps\": " << summary.fps << ", \"mean_ms\": " << summary.mean_ms
+		<< ", \"p50_ms\": " << summary.p50_ms << ", \"p95_ms\": " << summary.p95_ms
+		<< ", \"p99_ms\": " << summary.p99_ms << ", \"max_ms\": " << summary.max_ms
+		<< ", \"stdev_ms\": " << summary.stdev_ms << ", \"pacing_ms\": " << summary.pacing_ms
+		<< ", \"stutters\": " << summary.stutters << ", \"total_frames\": " << total_frames
+		<< ", \"total_stutters\": " << total_stutters << "}\n";
+}
@@ -0,0 +1,66 @@
+#include "GBuffer.h"
+#include "GLUtils/GLUtils.hpp"
+
+
+GBuffer::GBuffer(unsigned int width, unsigned int height) {
+	this->width = width;
+	this->height = height;
+
+	const GLint internal_formats[3] = {GL_RG16F, GL_RGBA8, GL_DEPTH_COMPONENT24};
+	const GLenum formats[3] = {GL_RG, GL_RGBA, GL_DEPTH_COMPONENT};
+	const GLenum types[3] = {GL_FLOAT, GL_UNSIGNED_BYTE, GL_FLOAT};
+
+	// The lighting pass reads one texel per pixel, so no filtering is needed
+	glGenTextures(3, &textures[0]);
+	for(int i = 0; i < 3; i++) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_formats[i], width, height, 0, formats[i], types[i], (void*)0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[0], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textures[1], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[2], 0);
+
+	const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+	glDrawBuffers(2, draw_buffers);
+
+	//Check for completeness
+	CHECK_GL_FBO_COMPLETENESS();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtils::labelObject(GL_TEXTURE, textures[0], "G-buffer normal");
+	GLUtils::labelObject(GL_TEXTURE, textures[1], "G-buffer albedo");
+	GLUtils::labelObject(GL_TEXTURE, textures[2], "G-buffer depth");
+	GLUtils::labelObject(GL_FRAMEBUFFER, fbo, "G-buffer");
+	CHECK_GL_ERRORS();
+}
+
+GBuffer::~GBuffer() {
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(3, &textures[0]);
+}
+
+void GBuffer::bind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void GBuffer::unbind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
+}
+
+void GBuffer::bindTextures(unsigned int first_unit) {
+	for(int i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE0 + first_unit + i);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
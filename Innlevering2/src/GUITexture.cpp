@@ -1,10 +1,12 @@
 #include "GUITexture.h"
+#include "Profiler.h"
 
 namespace gui
 {
 
 	GUITexture::GUITexture(const std::string& texture_path )
 	{
+		PROFILE_FUNCTION();
 		texture = gui::GUITextureFactory::Inst()->LoadTexture(texture_path);
 		dimensions = glm::vec3(texture.width, texture.height, 1.0f);
 		position = glm::vec3(0);
@@ -1,6 +1,7 @@
 #include "GameManager.h"
 #include "GameException.h"
 #include "GLUtils/GLUtils.hpp"
+#include "Profiler.h"
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -9,6 +10,9 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cstdlib>
+#include <limits>
+#include <cmath>
+#include <iomanip>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -25,6 +29,8 @@ const float GameManager::near_plane = 0.5f;
 const float GameManager::far_plane = 50.0f;
 const float GameManager::fovy = 45.0f;
 const float GameManager::cube_scale = GameManager::far_plane*0.75f;
+const float GameManager::depth_prepass_enable_overdraw = 1.5f;
+const float GameManager::depth_prepass_disable_overdraw = 1.25f;
 
 
 #pragma region cube_data
@@ -133,6 +139,9 @@ inline void checkSDLError(int line = -1) {
 #endif
 }
 
+unsigned int window_width = 1280;
+unsigned int window_height = 720;
+
 GLuint GameManager::gui_vbo = -1;
 GLuint GameManager::gui_vao = -1;
 
@@ -141,7 +150,21 @@ GameManager::GameManager() {
 	zoom = 1;
 	render_gui_and_depth = true;
 	rotate_light = true;
+	fit_light_frustum = true;
+	clustered_lighting = false;
+	depth_prepass_mode = DEPTH_PREPASS_AUTO;
+	depth_prepass_active = false;
+	overdraw_ratio = 0.0f;
+	overdraw_frame = 0;
 	current_environment = PLAIN_CUBE_ROOM;
+	current_shadow_technique = PCF_SHADOWS;
+	number_of_models = 20;
+	culled_models = 0;
+	capture_frame = 0;
+	random_seed = static_cast<unsigned int>(time(NULL));
+	use_geometry_shaders = true;
+	shader_quality = SHADER_QUALITY_MEDIUM;
+	frame_log_interval = 1.0;
 }
 
 GameManager::~GameManager() {
@@ -151,6 +174,9 @@ void GameManager::createOpenGLContext() {
 	//Set OpenGL major an minor versions
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+#ifndef NDEBUG
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG); // Ask for every debug message
+#endif
 
 	// Set OpenGL attributes
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1); // Use double buffering
@@ -192,15 +218,46 @@ void GameManager::createOpenGLContext() {
 	// Lets do the ugly thing of swallowing the error....
 	glGetError();
 
+	Init_GLState();
+}
+
+void GameManager::Init_GLState() {
+	//GL errors are reported by the driver as they happen. Release builds
+	//only report the serious ones, as CHECK_GL_ERRORS() is compiled out there
+#ifdef NDEBUG
+	bool debug_output = GLUtils::installDebugOutput(GL_DEBUG_SEVERITY_MEDIUM);
+#else
+	bool debug_output = GLUtils::installDebugOutput(GL_DEBUG_SEVERITY_LOW);
+#endif
+	if(!debug_output)
+		std::cout << "KHR_debug not supported, GL errors are only found by CHECK_GL_ERRORS()" << std::endl;
+
 
 	glViewport(0, 0, window_width, window_height);
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 	glEnable(GL_CULL_FACE);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 	
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+	glGetIntegerv(GL_SAMPLES, &framebuffer_samples);
+	framebuffer_samples = std::max(framebuffer_samples, 1);
+	glGenQueries(2, &overdraw_queries[0]);
+	overdraw_query_issued[0] = overdraw_query_issued[1] = false;
+
+	glGenQueries(2, &color_pass_timer_queries[0]);
+	color_pass_timer_slots[0] = color_pass_timer_slots[1] = -1;
+	color_pass_timer_frame = 0;
+	for(unsigned int i = 0; i < 3; i++){
+		color_pass_gpu_ms[i][0] = color_pass_gpu_ms[i][1] = 0.0f;
+		color_pass_gpu_frames[i][0] = color_pass_gpu_frames[i][1] = 0;
+	}
+	pass_queries.reset(new PassQueries());
+	if(!pass_queries->hasPipelineStatistics())
+		std::cout << "ARB_pipeline_statistics_query not supported, only the GPU time of each pass is measured" << std::endl;
+
 	CHECK_GL_ERRORS();
 	glClearColor(1.0, 1.0, 1.0, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -209,10 +266,40 @@ void GameManager::createOpenGLContext() {
 void GameManager::init() {
 	//Create opengl context before we do anything OGL-stuff
 	createOpenGLContext();
-	
+	Init_Resources();
+}
+
+void GameManager::initHeadless(unsigned int width, unsigned int height) {
+	window_width = width;
+	window_height = height;
+	main_window = NULL;
+
+	headless_context.reset(new HeadlessContext(width, height));
+	cam_trackball.setWindowSize(window_width, window_height);
+	Init_GLState();
+	Init_Resources();
+}
+
+void GameManager::Init_Resources() {
+	PROFILE_FUNCTION();
 	//Initialize IL and ILU
 	ilInit();
 	iluInit();
+
+	//The shaders are compiled into the executable. Setting PG612_SHADER_DIR
+	//to a directory holding shaders/ (e.g. ".") reads them from there instead,
+	//so they can be edited without rebuilding
+	const char* shader_directory = getenv("PG612_SHADER_DIR");
+	if(shader_directory != NULL)
+		GLUtils::shaderOverrideDirectory() = shader_directory;
+
+	//Submit the programs first, so the driver compiles them while the assets
+	//load. Linked programs are kept on disk, so only the first run (or the
+	//first after a shader or driver change) compiles them
+	Program::setBinaryCacheDirectory("shader_cache");
+	Timer program_timer;
+	Init_CreateShaderPrograms();
+	double program_submit_ms = program_timer.elapsed()*1000.0;
 	
 	//Initialize the different stuff we need
 	bunny.reset(new Model("models/bunny.obj", false));
@@ -221,38 +308,82 @@ void GameManager::init() {
 	cube_vertices.reset(new BO<GL_ARRAY_BUFFER>(cube_vertices_data, sizeof(cube_vertices_data)));
 	cube_normals.reset(new BO<GL_ARRAY_BUFFER>(cube_normals_data, sizeof(cube_normals_data)));
 
-	shadow_fbo.reset(new ShadowFBO(window_width, window_height));
+	shadow_fbo.reset(new ShadowFBO(shadow_map_width, shadow_map_height, GL_DEPTH_COMPONENT24));
+	vsm_fbo.reset(new VarianceShadowFBO(shadow_map_width, shadow_map_height));
+	cube_shadow_fbo.reset(new CubeShadowFBO(shadow_map_width, GL_DEPTH_COMPONENT24));
+	shadow_atlas.reset(new ShadowAtlas(shadow_atlas_size, GL_DEPTH_COMPONENT24));
+	shadow_lights_ubo.reset(new BO<GL_UNIFORM_BUFFER>(NULL, sizeof(ShadowLightsBlock), GL_DYNAMIC_DRAW));
+	light_clusters.reset(new LightClusters());
+	gbuffer.reset(new GBuffer(window_width, window_height));
 
 	diffuse_cubemap.reset(new CubeMap("cubemaps/diffuse/", "jpg"));
 	spacebox.reset(new CubeMap("cubemaps/skybox/", "jpg"));
 
 	Init_SetMatrices();
 
-	//Create the random transformations and colors for the bunnys
-	srand(static_cast<int>(time(NULL)));
-	for (int i=0; i<number_of_models; ++i) {
-		float tx = rand() / (float) RAND_MAX - 0.5f;
-		float ty = rand() / (float) RAND_MAX - 0.5f;
-		float tz = rand() / (float) RAND_MAX - 0.5f;
+	srand(random_seed);
+	Init_CreateModels();
 
-		glm::mat4 transformation = bunny->getTransform();
-		transformation = glm::translate(transformation, glm::vec3(tx, ty, tz));
+	//Create the random point lights in a shell around the bunnies
+	for (unsigned int i=0; i<number_of_point_lights; ++i) {
+		glm::vec3 direction = glm::vec3(rand() / (float) RAND_MAX - 0.5f, rand() / (float) RAND_MAX - 0.5f, rand() / (float) RAND_MAX - 0.5f);
+		float distance = 2.0f + 6.0f*rand() / (float) RAND_MAX;
 
-		model_matrices.push_back(transformation);
-		model_inverse_matrices.push_back(glm::inverse(transformation));
-		model_colors.push_back(glm::vec3(tx+0.5, ty+0.5, tz+0.5));
+		PointLight point_light;
+		point_light.position = glm::normalize(direction + glm::vec3(0.0001f))*distance;
+		point_light.radius = 1.0f + 2.0f*rand() / (float) RAND_MAX;
+		point_light.color = glm::vec3(rand() / (float) RAND_MAX, rand() / (float) RAND_MAX, rand() / (float) RAND_MAX)*0.5f;
+		point_lights.push_back(point_light);
 	}
+	light_clusters->setProjection(fovy/zoom, window_width / (float) window_height, near_plane, far_plane);
 
-	Init_CreateShaderPrograms();
+	glGenVertexArrays(4, &vao[0]);
+	glGenVertexArrays(2, &deindexed_vao[0]);
+
+	unsigned int programs_pending = program_cache.pending();
+	Timer program_wait_timer;
+	{
+		PROFILE_SCOPE("ProgramCache::finish");
+		program_cache.finish();
+	}
+	std::cout << (Program::binaryCacheHits() == 0 ? "Cold" : "Warm") << " start: submitted "
+			  << program_cache.size() << " programs in " << program_submit_ms << " ms ("
+			  << Program::binaryCacheHits() << " loaded from the binary cache, "
+			  << Program::binaryCacheMisses() << " compiled), " << programs_pending
+			  << " still compiling after loading the assets, waited "
+			  << program_wait_timer.elapsed()*1000.0 << " ms for them" << std::endl;
 	Init_SetShaderUniforms();
 	Init_set_vao_0_attribPtrs();
 	Init_set_vao_1_attribPtrs();
 	Init_set_vao_2_attribPtrs();
 	Init_set_vao_3_attribPtrs(); 
+	Init_set_edge_vao_attribPtrs();
 	gui::GUITextureFactory::Inst()->Init(gui_program, gui_vao);
 	current_program = phong_program;
+	current_shadow_program = light_pov_program;
 
 	Init_CreateGUIObjects();
+	performance_hud.reset(new PerformanceHUD(gui_program));
+}
+
+void GameManager::Init_CreateModels(){
+	PROFILE_FUNCTION();
+	//Create the random transformations and colors for the bunnys
+	model_matrices.clear();
+	model_inverse_matrices.clear();
+	model_colors.clear();
+	for (unsigned int i=0; i<number_of_models; ++i) {
+		float tx = rand() / (float) RAND_MAX - 0.5f;
+		float ty = rand() / (float) RAND_MAX - 0.5f;
+		float tz = rand() / (float) RAND_MAX - 0.5f;
+
+		glm::mat4 transformation = bunny->getTransform();
+		transformation = glm::translate(transformation, glm::vec3(tx, ty, tz));
+
+		model_matrices.push_back(transformation);
+		model_inverse_matrices.push_back(glm::inverse(transformation));
+		model_colors.push_back(glm::vec3(tx+0.5, ty+0.5, tz+0.5));
+	}
 }
 
 void GameManager::Init_SetMatrices(){
@@ -265,9 +396,27 @@ void GameManager::Init_SetMatrices(){
 	gui_camera.view = glm::mat4(1.0);
 
 	light.position = glm::vec3(0, 0, 8);
-	light.projection = glm::perspective(90.0f, 1.0f, near_plane, far_plane);
+	light.color = glm::vec3(1.0f);
+	light.near_clip = near_plane;
+	light.far_clip = far_plane;
+	light.projection = glm::perspective(90.0f, 1.0f, light.near_clip, light.far_clip);
 	light.view = glm::lookAt(light.position, glm::vec3(0), glm::vec3(0.0, 1.0, 0.0));
 
+	//The atlas lights all aim at the origin with the unfitted 90 degree frustum,
+	//and are dimmer than light so the scene does not wash out
+	const glm::vec3 atlas_light_positions[number_of_atlas_lights-1] = {
+		glm::vec3(7, 4, -4), glm::vec3(-6, -3, -5), glm::vec3(-4, 6, 5)
+	};
+	const glm::vec3 atlas_light_colors[number_of_atlas_lights-1] = {
+		glm::vec3(0.4f, 0.3f, 0.2f), glm::vec3(0.15f, 0.2f, 0.4f), glm::vec3(0.2f, 0.35f, 0.2f)
+	};
+	atlas_lights.assign(number_of_atlas_lights, light);
+	for(unsigned int i = 1; i < number_of_atlas_lights; i++){
+		atlas_lights[i].position = atlas_light_positions[i-1];
+		atlas_lights[i].color = atlas_light_colors[i-1];
+		atlas_lights[i].view = glm::lookAt(atlas_lights[i].position, glm::vec3(0), glm::vec3(0.0, 1.0, 0.0));
+	}
+
 	fbo_projectionMatrix = glm::mat4(1);
 	fbo_viewMatrix = glm::mat4(1);
 	fbo_modelMatrix = glm::mat4(1);
@@ -282,28 +431,86 @@ void GameManager::Init_SetMatrices(){
 }
 
 void GameManager::Init_CreateShaderPrograms(){
-	//Create the programs we will use
-	phong_program.reset(new Program("shaders/phong.vert", "shaders/phong.geom", "shaders/phong.frag"));
-	wireframe_program.reset(new Program("shaders/wireframe.vert", "shaders/wireframe.geom", "shaders/wireframe.frag"));
-	hidden_line_program.reset(new Program("shaders/hidden_line.vert", "shaders/hidden_line.geom", "shaders/hidden_line.frag"));
-	gui_program.reset(new Program("shaders/GUI.vert", "shaders/GUI.frag"));
-
-	light_pov_program.reset(new Program("shaders/light_pov.vert", "shaders/light_pov.frag"));
-	depth_dump_program.reset(new Program("shaders/depth_dump.vert", "shaders/depth_dump.frag"));
+	PROFILE_FUNCTION();
+	//Create the programs we will use. The shading programs are compiled
+	//with the defines of the current shader quality
+	GLUtils::ShaderDefines defines = ShadingDefines();
+	phong_gs_program = program_cache.get("shaders/phong.vert", "shaders/phong.geom", "shaders/phong.frag", defines);
+	wireframe_gs_program = program_cache.get("shaders/wireframe.vert", "shaders/wireframe.geom", "shaders/wireframe.frag");
+	hidden_line_gs_program = program_cache.get("shaders/hidden_line.vert", "shaders/hidden_line.geom", "shaders/hidden_line.frag", defines);
+	phong_direct_program = program_cache.get("shaders/phong_direct.vert", "shaders/phong.frag", defines);
+	wireframe_direct_program = program_cache.get("shaders/wireframe_direct.vert", "shaders/wireframe.frag");
+	hidden_line_direct_program = program_cache.get("shaders/hidden_line_direct.vert", "shaders/hidden_line.frag", defines);
+	SetGeometryShaderVariants(use_geometry_shaders);
+	gui_program = program_cache.get("shaders/GUI.vert", "shaders/GUI.frag");
+
+	light_pov_program = program_cache.get("shaders/light_pov.vert", "shaders/light_pov.frag");
+	depth_dump_program = program_cache.get("shaders/depth_dump.vert", "shaders/depth_dump.frag");
+
+	vsm_moments_program = program_cache.get("shaders/light_pov.vert", "shaders/vsm_moments.frag");
+	vsm_blur_program = program_cache.get("shaders/vsm_blur.vert", "shaders/vsm_blur.frag");
+	cube_shadow_program = program_cache.get("shaders/cube_shadow.vert", "shaders/cube_shadow.geom", "shaders/cube_shadow.frag");
+
+	gbuffer_program = program_cache.get("shaders/gbuffer.vert", "shaders/gbuffer.frag");
+	deferred_lighting_program = program_cache.get("shaders/deferred_lighting.vert", "shaders/deferred_lighting.frag", defines);
+
+	feature_edge_program = program_cache.get("shaders/feature_edges.vert", "shaders/feature_edges.frag");
+	silhouette_edge_program = program_cache.get("shaders/feature_edges.vert", "shaders/silhouette_edges.geom", "shaders/feature_edges.frag");
+	image_edge_program = program_cache.get("shaders/deferred_lighting.vert", "shaders/image_edges.frag");
 	CHECK_GL_ERRORS();
 }
 
+GLUtils::ShaderDefines GameManager::ShadingDefines(){
+	const char* pcf_taps[] = {"PCF_TAPS 1", "PCF_TAPS 4", "PCF_TAPS 16"};
+	GLUtils::ShaderDefines defines;
+	defines.push_back(pcf_taps[shader_quality]);
+	return defines;
+}
+
 void GameManager::Init_SetShaderUniforms(){
 
-	phong_program->use();
-	glUniform1i(phong_program->getUniform("shadowmap_texture"), 0);
-	glUniform1i(phong_program->getUniform("diffuse_map"), 1);
-	phong_program->disuse();
+	//Both variants of the phong and hidden line programs
+	std::shared_ptr<Program> forward_shading_programs[] = {phong_gs_program, phong_direct_program,
+															hidden_line_gs_program, hidden_line_direct_program};
+	for(unsigned int i = 0; i < sizeof(forward_shading_programs)/sizeof(forward_shading_programs[0]); i++){
+		std::shared_ptr<Program>& program = forward_shading_programs[i];
+		program->use();
+		glUniform1i(program->getUniform("shadowmap_texture"), 0);
+		glUniform1i(program->getUniform("diffuse_map"), 1);
+		glUniform1i(program->getUniform("vsm_texture"), 2);
+		glUniform1i(program->getUniform("cube_shadowmap_texture"), 3);
+		glUniform1i(program->getUniform("cluster_grid"), 4);
+		glUniform1i(program->getUniform("cluster_light_indices"), 5);
+		glUniform1i(program->getUniform("point_lights"), 6);
+		program->disuse();
+	}
 
-	hidden_line_program->use();
-	glUniform1i(hidden_line_program->getUniform("shadowmap_texture"), 0);
-	glUniform1i(hidden_line_program->getUniform("diffuse_map"), 1);
-	hidden_line_program->disuse();
+	deferred_lighting_program->use();
+	glUniform1i(deferred_lighting_program->getUniform("shadowmap_texture"), 0);
+	glUniform1i(deferred_lighting_program->getUniform("diffuse_map"), 1);
+	glUniform1i(deferred_lighting_program->getUniform("vsm_texture"), 2);
+	glUniform1i(deferred_lighting_program->getUniform("cube_shadowmap_texture"), 3);
+	glUniform1i(deferred_lighting_program->getUniform("cluster_grid"), 4);
+	glUniform1i(deferred_lighting_program->getUniform("cluster_light_indices"), 5);
+	glUniform1i(deferred_lighting_program->getUniform("point_lights"), 6);
+	glUniform1i(deferred_lighting_program->getUniform("normal_texture"), 7);
+	glUniform1i(deferred_lighting_program->getUniform("albedo_texture"), 8);
+	glUniform1i(deferred_lighting_program->getUniform("depth_texture"), 9);
+	deferred_lighting_program->disuse();
+
+	image_edge_program->use();
+	glUniform1i(image_edge_program->getUniform("normal_texture"), 7);
+	glUniform1i(image_edge_program->getUniform("albedo_texture"), 8);
+	glUniform1i(image_edge_program->getUniform("depth_texture"), 9);
+	glUniform1f(image_edge_program->getUniform("near_clip"), near_plane);
+	glUniform1f(image_edge_program->getUniform("far_clip"), far_plane);
+	image_edge_program->disuse();
+
+	//The atlas lights are read from uniform buffer binding 0
+	for(unsigned int i = 0; i < sizeof(forward_shading_programs)/sizeof(forward_shading_programs[0]); i++)
+		forward_shading_programs[i]->setUniformBlockBinding("ShadowLights", 0);
+	deferred_lighting_program->setUniformBlockBinding("ShadowLights", 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, shadow_lights_ubo->name());
 
 	depth_dump_program->use();
 	glUniformMatrix4fv(depth_dump_program->getUniform("modelviewprojection_matrix"), 1, 0, 
@@ -311,6 +518,10 @@ void GameManager::Init_SetShaderUniforms(){
 	glUniform1i(depth_dump_program->getUniform("fbo_texture"), 0);
 	depth_dump_program->disuse();
 
+	vsm_blur_program->use();
+	glUniform1i(vsm_blur_program->getUniform("moments_texture"), 0);
+	vsm_blur_program->disuse();
+
 	gui_program->use();
 	glUniformMatrix4fv(gui_program->getUniform("projection"), 1, 0, glm::value_ptr(gui_camera.projection));
 	glUniformMatrix4fv(gui_program->getUniform("view"), 1, 0, glm::value_ptr(gui_camera.view));
@@ -321,19 +532,20 @@ void GameManager::Init_SetShaderUniforms(){
 
 void GameManager::Init_set_vao_0_attribPtrs()
 {
-	glGenVertexArrays(4, &vao[0]);
-
 	glBindVertexArray(vao[0]);
 	bunny->getInterleavedVBO()->bind();
 	bunny->getIndices()->bind();
-	phong_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getVerticeOffset());
-	phong_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getNormalOffset());
-
-	wireframe_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getVerticeOffset());
-	wireframe_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getNormalOffset());
+	std::shared_ptr<Program> scene_programs[] = {phong_gs_program, wireframe_gs_program, hidden_line_gs_program,
+												 phong_direct_program, wireframe_direct_program, gbuffer_program};
+	for(unsigned int i = 0; i < sizeof(scene_programs)/sizeof(scene_programs[0]); i++){
+		scene_programs[i]->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getVerticeOffset());
+		scene_programs[i]->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getNormalOffset());
+	}
 
-	hidden_line_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getVerticeOffset());
-	hidden_line_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getNormalOffset());
+	glBindVertexArray(deindexed_vao[0]);
+	bunny->getDeindexedVBO()->bind();
+	hidden_line_direct_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getVerticeOffset());
+	hidden_line_direct_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getNormalOffset());
 
 	bunny->getInterleavedVBO()->unbind();
 	glBindVertexArray(0);
@@ -343,15 +555,17 @@ void GameManager::Init_set_vao_1_attribPtrs()
 {
 	glBindVertexArray(vao[1]);
 
+	//The cube is not indexed, so the hidden line program without geometry shader draws it as is
+	std::shared_ptr<Program> scene_programs[] = {phong_gs_program, wireframe_gs_program, hidden_line_gs_program,
+												 phong_direct_program, wireframe_direct_program, hidden_line_direct_program,
+												 gbuffer_program};
 	cube_vertices->bind();
-	phong_program->setAttributePointer("position", 3);
-	wireframe_program->setAttributePointer("position", 3);
-	hidden_line_program->setAttributePointer("position", 3);
+	for(unsigned int i = 0; i < sizeof(scene_programs)/sizeof(scene_programs[0]); i++)
+		scene_programs[i]->setAttributePointer("position", 3);
 
 	cube_normals->bind();
-	phong_program->setAttributePointer("normal", 3);
-	wireframe_program->setAttributePointer("normal", 3);
-	hidden_line_program->setAttributePointer("normal", 3);
+	for(unsigned int i = 0; i < sizeof(scene_programs)/sizeof(scene_programs[0]); i++)
+		scene_programs[i]->setAttributePointer("normal", 3);
 
 	glBindVertexArray(0);
 }
@@ -361,14 +575,18 @@ void GameManager::Init_set_vao_2_attribPtrs()
 	glBindVertexArray(vao[2]);
 	room->getInterleavedVBO()->bind();
 	room->getIndices()->bind();
-	phong_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getVerticeOffset());
-	phong_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getNormalOffset());
+	std::shared_ptr<Program> scene_programs[] = {phong_gs_program, wireframe_gs_program, hidden_line_gs_program,
+												 phong_direct_program, wireframe_direct_program, gbuffer_program};
+	for(unsigned int i = 0; i < sizeof(scene_programs)/sizeof(scene_programs[0]); i++){
+		scene_programs[i]->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getVerticeOffset());
+		scene_programs[i]->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getNormalOffset());
+	}
 
-	wireframe_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getVerticeOffset());
-	wireframe_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getNormalOffset());
+	glBindVertexArray(deindexed_vao[1]);
+	room->getDeindexedVBO()->bind();
+	hidden_line_direct_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getVerticeOffset());
+	hidden_line_direct_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getNormalOffset());
 
-	hidden_line_program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getVerticeOffset());
-	hidden_line_program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getNormalOffset());
 	room->getInterleavedVBO()->unbind();
 	glBindVertexArray(0);
 }
@@ -388,6 +606,9 @@ void GameManager::Init_set_vao_3_attribPtrs()
 	glBufferData(GL_ARRAY_BUFFER, 4*2*sizeof(float), &positions[0], GL_STATIC_DRAW);
 
 	depth_dump_program->setAttributePointer("in_Position", 2, GL_FLOAT, GL_FALSE, 0, 0);
+	vsm_blur_program->setAttributePointer("in_Position", 2, GL_FLOAT, GL_FALSE, 0, 0);
+	deferred_lighting_program->setAttributePointer("in_Position", 2, GL_FLOAT, GL_FALSE, 0, 0);
+	image_edge_program->setAttributePointer("in_Position", 2, GL_FLOAT, GL_FALSE, 0, 0);
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -410,6 +631,42 @@ void GameManager::Init_set_vao_3_attribPtrs()
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+void GameManager::Init_set_edge_vao_attribPtrs()
+{
+	std::vector<glm::vec3> cube_positions;
+	std::vector<unsigned int> cube_indices;
+	for(unsigned int i = 0; i < sizeof(cube_vertices_data)/(3*sizeof(float)); i++){
+		cube_positions.push_back(glm::vec3(cube_vertices_data[3*i], cube_vertices_data[3*i+1], cube_vertices_data[3*i+2]));
+		cube_indices.push_back(i);
+	}
+	cube_edges.reset(new FeatureEdges(cube_positions, cube_indices));
+
+	std::shared_ptr<Program> edge_programs[] = {feature_edge_program, silhouette_edge_program};
+
+	glGenVertexArrays(3, &edge_vao[0]);
+
+	glBindVertexArray(edge_vao[0]);
+	cube_vertices->bind();
+	cube_edges->getIndices()->bind();
+	for(unsigned int i = 0; i < sizeof(edge_programs)/sizeof(edge_programs[0]); i++)
+		edge_programs[i]->setAttributePointer("position", 3);
+
+	glBindVertexArray(edge_vao[1]);
+	room->getInterleavedVBO()->bind();
+	room->getFeatureEdges()->getIndices()->bind();
+	for(unsigned int i = 0; i < sizeof(edge_programs)/sizeof(edge_programs[0]); i++)
+		edge_programs[i]->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, room->getStride(), room->getVerticeOffset());
+
+	glBindVertexArray(edge_vao[2]);
+	bunny->getInterleavedVBO()->bind();
+	bunny->getFeatureEdges()->getIndices()->bind();
+	for(unsigned int i = 0; i < sizeof(edge_programs)/sizeof(edge_programs[0]); i++)
+		edge_programs[i]->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, bunny->getStride(), bunny->getVerticeOffset());
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void GameManager::Init_CreateGUIObjects(){
 	slider_line_threshold = std::make_shared<gui::SliderWithText>("GUI/hiddenline/line_threashold.png",glm::vec2(950.0f, 5.0f));
 	slider_line_scale	  = std::make_shared<gui::SliderWithText>("GUI/hiddenline/amplify_scale.png",  glm::vec2(950.0f, 75.0f));
@@ -417,16 +674,22 @@ void GameManager::Init_CreateGUIObjects(){
 	slider_diffuse_mix	  = std::make_shared<gui::SliderWithText>("GUI/diffuse_colormix_value.png", glm::vec2(950.0f, 650.0f));
 	slider_gui_alpha	  = std::make_shared<gui::SliderWithText>("GUI/gui_alpha.png", glm::vec2(10.0f, 220.0f), glm::vec2(0.4f, 0.4f));
 	slider_gui_alpha->SetClampRange(0.2f, 1.0f);
+	slider_light_bleeding = std::make_shared<gui::SliderWithText>("GUI/Shadowmode/light_bleeding.png", glm::vec2(950.0f, 580.0f));
+	slider_light_bleeding->SetClampRange(0.0f, 0.9f);
 	gui_sliders.push_back(slider_line_threshold);
 	gui_sliders.push_back(slider_line_scale);
 	gui_sliders.push_back(slider_line_offset);
 	gui_sliders.push_back(slider_diffuse_mix);
 	gui_sliders.push_back(slider_gui_alpha);
+	gui_sliders.push_back(slider_light_bleeding);
 
 	std::vector<gui::RadioButtonEntry> rendermode_entries;
 	rendermode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UsePhongProgram, this), true, "GUI/Rendermode/PhongWShadows.png"));
 	rendermode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseWireframeProgram, this), false, "GUI/Rendermode/Wireframe.png"));
 	rendermode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseHiddenLineProgram, this), false, "GUI/Rendermode/Hidden Line.png"));
+	rendermode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseDeferredProgram, this), false, "GUI/Rendermode/Deferred.png"));
+	rendermode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseFeatureEdgeProgram, this), false, "GUI/Rendermode/Feature edges.png"));
+	rendermode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseImageEdgeProgram, this), false, "GUI/Rendermode/Image edges.png"));
 	rendermode_radiobtn.reset(new gui::RadioButtonCollection(rendermode_entries, glm::vec2(0, window_height-40), glm::vec2(0.5, 0.5)));
 
 
@@ -434,37 +697,80 @@ void GameManager::Init_CreateGUIObjects(){
 	environment_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::SetBackgroundToCube, this), true, "GUI/CubeBackground.png"));
 	environment_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::SetBackgroundToOpenRoom, this), false, "GUI/OpenBackground.png"));
 	environment_radiobtn.reset(new gui::RadioButtonCollection(environment_entries, glm::vec2(250, window_height-40), glm::vec2(0.5, 0.5)));
+
+	std::vector<gui::RadioButtonEntry> shadowmode_entries;
+	shadowmode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UsePCFShadows, this), true, "GUI/Shadowmode/PCF.png"));
+	shadowmode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseVarianceShadows, this), false, "GUI/Shadowmode/Variance.png"));
+	shadowmode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseCubeShadows, this), false, "GUI/Shadowmode/Omnidirectional.png"));
+	shadowmode_entries.push_back(gui::RadioButtonEntry(std::bind(&GameManager::UseAtlasShadows, this), false, "GUI/Shadowmode/Atlas.png"));
+	shadowmode_radiobtn.reset(new gui::RadioButtonCollection(shadowmode_entries, glm::vec2(500, window_height-40), glm::vec2(0.5, 0.5)));
 }
 
 void GameManager::renderColorPass() {
+	PROFILE_FUNCTION();
+	if(current_program == gbuffer_program){
+		renderDeferredColorPass();
+		return;
+	}
+	if(current_program == feature_edge_program){
+		renderFeatureEdgeColorPass();
+		return;
+	}
+	if(current_program == image_edge_program){
+		renderImageEdgeColorPass();
+		return;
+	}
+	UpdateDepthPrepass();
+	UpdateColorPassTimers();
+
 	glViewport(0, 0, window_width, window_height);
-	glBindFramebufferEXT(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//Create the new view matrix that takes the trackball view into account
-	cam_trackball_view_matrix = camera.view*cam_trackball.getTransform();
-
-	glDepthMask(GL_FALSE);	
+	glDepthMask(GL_FALSE);
+	pass_queries->begin(PassQueries::SKYBOX);
 	spacebox->render(camera.projection, cam_trackball_view_matrix);
+	pass_queries->end(PassQueries::SKYBOX);
 	glDepthMask(GL_TRUE);
 
+	//The overdraw is measured on the first pass depth testing the scene in draw
+	//order: the pre-pass if there is one, otherwise the color pass itself
+	bool measure_overdraw = current_program != wireframe_program;
+	bool depth_prepass = measure_overdraw && depth_prepass_active;
+	GLuint overdraw_query = overdraw_queries[overdraw_frame % 2];
+	if(measure_overdraw)
+		glBeginQuery(GL_SAMPLES_PASSED, overdraw_query);
+
+	if(depth_prepass){
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		light_pov_program->use();
+		RenderSceneGeometry(light_pov_program, false);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glEndQuery(GL_SAMPLES_PASSED);
+
+		//Only the visible fragment of each sample passes, so each is shaded once
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
+	//Timed from here, as only the shading of the color pass differs between the variants
+	unsigned int timer_index = color_pass_timer_frame % 2;
+	glBeginQuery(GL_TIME_ELAPSED, color_pass_timer_queries[timer_index]);
+
 	current_program->use();
 
-	if(current_program == hidden_line_program)
-	{
-		glUniform1f(current_program->getUniform("line_threshold"), slider_line_threshold->get_slider_value()/10);
-		glUniform1f(current_program->getUniform("line_scale"), slider_line_scale->get_slider_value()*100);
-		glUniform1f(current_program->getUniform("line_offset"), (slider_line_offset->get_slider_value()-0.5f)*10);
-		
+	//Without geometry shader the wireframe is the triangles rasterized as lines.
+	//Lines are never culled, so back faces keep their edges as in the geometry shader variant
+	if(current_program == wireframe_direct_program){
+		glDisable(GL_CULL_FACE);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	}
-	if(current_program != wireframe_program)
-		glUniform1f(current_program->getUniform("diffuse_mix_value"), slider_diffuse_mix->get_slider_value());
 
-	//Bind shadow map and diffuse cube map
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, shadow_fbo->getTexture());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-	diffuse_cubemap->bind(GL_TEXTURE1);
+	if(current_program == hidden_line_program)
+		SetLineUniforms(current_program);
+	if(current_program != wireframe_program)
+		SetShadingUniforms(current_program);
+	BindShadingTextures();
 
 	if(current_environment == PLAIN_CUBE_ROOM)
 		RenderCubeColorpass();
@@ -472,29 +778,468 @@ void GameManager::renderColorPass() {
 		RenderRoomModelColorpass();
 
 	RenderModelsColorpass();
+
+	if(current_program == wireframe_direct_program){
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glEnable(GL_CULL_FACE);
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	int render_mode = current_program == phong_program ? 0 : (current_program == wireframe_program ? 1 : 2);
+	color_pass_timer_slots[timer_index] = render_mode*2 + (use_geometry_shaders ? 0 : 1);
+	color_pass_timer_frame++;
+
+	if(depth_prepass){
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_TRUE);
+	}
+	else if(measure_overdraw){
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	if(measure_overdraw){
+		overdraw_query_issued[overdraw_frame % 2] = true;
+		overdraw_frame++;
+	}
 }
 
-void GameManager::renderShadowPass() {	
+void GameManager::UpdateColorPassTimers(){
+	unsigned int previous = (color_pass_timer_frame + 1) % 2;
+	int slot = color_pass_timer_slots[previous];
+	if(slot < 0)
+		return;
+
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(color_pass_timer_queries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(!available)
+		return;
+
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(color_pass_timer_queries[previous], GL_QUERY_RESULT, &elapsed);
+	color_pass_timer_slots[previous] = -1;
+
+	//The mean of the first frames, then a moving average following the current view
+	float& average = color_pass_gpu_ms[slot/2][slot%2];
+	unsigned int& frames = color_pass_gpu_frames[slot/2][slot%2];
+	float ms = elapsed / 1000000.0f;
+	if(frames < 100)
+		average = (average*frames + ms) / (frames + 1);
+	else
+		average = 0.99f*average + 0.01f*ms;
+	frames++;
+}
+
+void GameManager::PrintColorPassTimes(){
+	const char* names[] = {"Phong", "Wireframe", "Hidden line"};
+	std::cout << "Color pass GPU time with / without geometry shader:" << std::endl;
+	for(unsigned int i = 0; i < 3; i++){
+		std::cout << "  " << names[i] << ": ";
+		for(unsigned int variant = 0; variant < 2; variant++){
+			if(variant == 1)
+				std::cout << " / ";
+			if(color_pass_gpu_frames[i][variant] > 0)
+				std::cout << color_pass_gpu_ms[i][variant] << " ms";
+			else
+				std::cout << "not measured";
+		}
+		std::cout << std::endl;
+	}
+}
+
+void GameManager::PrintGLCounters(){
+	if(!GLUtils::gl_counters_enabled)
+		return;
+	std::cout << "GL calls of the last frame (draws / vertices / triangles / program, vao, texture, fbo binds / uniforms / buffer bytes):" << std::endl;
+	for(unsigned int slot = 0; slot <= PassQueries::PASS_COUNT; slot++){
+		const GLUtils::GLCounters& counters = GLUtils::getGLCounters(slot);
+		std::cout << "  " << (slot == 0 ? "outside passes" : PassQueries::passName(static_cast<PassQueries::Passes>(slot-1))) << ": "
+				  << counters.draw_calls << " / " << counters.vertices << " / " << counters.triangles << " / "
+				  << counters.program_binds << ", " << counters.vao_binds << ", " << counters.texture_binds << ", "
+				  << counters.framebuffer_binds << " / " << counters.uniform_uploads << " / " << counters.buffer_bytes << std::endl;
+	}
+}
+
+void GameManager::SetGeometryShaderVariants(bool use_geometry_shaders){
+	bool phong = current_program && current_program == phong_program;
+	bool wireframe = current_program && current_program == wireframe_program;
+	bool hidden_line = current_program && current_program == hidden_line_program;
+
+	this->use_geometry_shaders = use_geometry_shaders;
+	phong_program = use_geometry_shaders ? phong_gs_program : phong_direct_program;
+	wireframe_program = use_geometry_shaders ? wireframe_gs_program : wireframe_direct_program;
+	hidden_line_program = use_geometry_shaders ? hidden_line_gs_program : hidden_line_direct_program;
+
+	if(phong)
+		current_program = phong_program;
+	else if(wireframe)
+		current_program = wireframe_program;
+	else if(hidden_line)
+		current_program = hidden_line_program;
+}
+
+void GameManager::SetShaderQuality(ShaderQualities quality){
+	PROFILE_FUNCTION();
+	bool phong = current_program && current_program == phong_program;
+	bool wireframe = current_program && current_program == wireframe_program;
+	bool hidden_line = current_program && current_program == hidden_line_program;
+
+	//Programs without defines come back unchanged from the cache, so only
+	//the shading programs change. Their uniforms and attributes are set again
+	shader_quality = quality;
+	Init_CreateShaderPrograms();
+	program_cache.finish();
+	Init_SetShaderUniforms();
+	Init_set_vao_0_attribPtrs();
+	Init_set_vao_1_attribPtrs();
+	Init_set_vao_2_attribPtrs();
+
+	if(phong)
+		current_program = phong_program;
+	else if(wireframe)
+		current_program = wireframe_program;
+	else if(hidden_line)
+		current_program = hidden_line_program;
+
+	const char* names[] = {"low", "medium", "high"};
+	std::cout << "Shader quality " << names[shader_quality] << ", "
+			  << program_cache.size() << " programs compiled" << std::endl;
+}
+
+void GameManager::UpdateDepthPrepass(){
+	//The query of the previous frame is normally done, so this does not stall
+	unsigned int previous = (overdraw_frame + 1) % 2;
+	if(overdraw_query_issued[previous]){
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(overdraw_queries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available){
+			GLuint samples = 0;
+			glGetQueryObjectuiv(overdraw_queries[previous], GL_QUERY_RESULT, &samples);
+			overdraw_ratio = samples / static_cast<float>(window_width*window_height*framebuffer_samples);
+			overdraw_query_issued[previous] = false;
+		}
+	}
+
+	bool active;
+	if(depth_prepass_mode == DEPTH_PREPASS_AUTO){
+		//Separate on and off thresholds keep it from toggling every frame
+		if(depth_prepass_active)
+			active = overdraw_ratio > depth_prepass_disable_overdraw;
+		else
+			active = overdraw_ratio > depth_prepass_enable_overdraw;
+		if(active != depth_prepass_active)
+			std::cout << "Depth pre-pass " << (active ? "on" : "off") << " at overdraw " << overdraw_ratio << std::endl;
+	}
+	else{
+		active = depth_prepass_mode == DEPTH_PREPASS_ON;
+	}
+	depth_prepass_active = active;
+}
+
+void GameManager::RenderGBuffer() {
+	PROFILE_FUNCTION();
+	//Geometry pass, storing normal, albedo and depth of the visible surfaces
+	gbuffer->bind();
+	glViewport(0, 0, gbuffer->getWidth(), gbuffer->getHeight());
+	glDisable(GL_BLEND);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	gbuffer_program->use();
+	RenderSceneGeometry(gbuffer_program, true);
+	gbuffer_program->disuse();
+
+	gbuffer->unbind();
+	glEnable(GL_BLEND);
+}
+
+void GameManager::SetLineUniforms(std::shared_ptr<Program> program) {
+	glUniform1f(program->getUniform("line_threshold"), slider_line_threshold->get_slider_value()/10);
+	glUniform1f(program->getUniform("line_scale"), slider_line_scale->get_slider_value()*100);
+	glUniform1f(program->getUniform("line_offset"), (slider_line_offset->get_slider_value()-0.5f)*10);
+}
+
+void GameManager::renderImageEdgeColorPass() {
+	PROFILE_FUNCTION();
+	RenderGBuffer();
+
+	//Edge pass, O(pixels) however dense the meshes are
+	glViewport(0, 0, window_width, window_height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glDepthMask(GL_FALSE);
+	pass_queries->begin(PassQueries::SKYBOX);
+	spacebox->render(camera.projection, cam_trackball_view_matrix);
+	pass_queries->end(PassQueries::SKYBOX);
+	glDepthMask(GL_TRUE);
+
+	glm::mat4 inverse_viewprojection = glm::inverse(camera.projection*cam_trackball_view_matrix);
+
+	image_edge_program->use();
+	SetLineUniforms(image_edge_program);
+	glUniformMatrix4fv(image_edge_program->getUniform("inverse_viewprojection"), 1, 0, glm::value_ptr(inverse_viewprojection));
+	glUniform3fv(image_edge_program->getUniform("light_world_position"), 1, glm::value_ptr(light.position));
+	gbuffer->bindTextures(7);
+
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(vao[3]);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+
+	image_edge_program->disuse();
+	CHECK_GL_ERRORS();
+}
+
+void GameManager::renderDeferredColorPass() {
+	PROFILE_FUNCTION();
+	RenderGBuffer();
+
+	//Lighting pass, shading each pixel once
+	glViewport(0, 0, window_width, window_height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glDepthMask(GL_FALSE);
+	pass_queries->begin(PassQueries::SKYBOX);
+	spacebox->render(camera.projection, cam_trackball_view_matrix);
+	pass_queries->end(PassQueries::SKYBOX);
+	glDepthMask(GL_TRUE);
+
+	glm::mat4 inverse_viewprojection = glm::inverse(camera.projection*cam_trackball_view_matrix);
+	glm::vec3 camera_position = glm::vec3(glm::inverse(cam_trackball_view_matrix)[3]);
+	glm::mat4 shadow_matrix = GetShadowMatrix(glm::mat4(1.0f));
+
+	deferred_lighting_program->use();
+	SetShadingUniforms(deferred_lighting_program);
+	glUniformMatrix4fv(deferred_lighting_program->getUniform("inverse_viewprojection"), 1, 0, glm::value_ptr(inverse_viewprojection));
+	glUniform3fv(deferred_lighting_program->getUniform("camera_position"), 1, glm::value_ptr(camera_position));
+	glUniformMatrix4fv(deferred_lighting_program->getUniform("shadow_matrix"), 1, 0, glm::value_ptr(shadow_matrix));
+	BindShadingTextures();
+	gbuffer->bindTextures(7);
+
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(vao[3]);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+
+	deferred_lighting_program->disuse();
+	CHECK_GL_ERRORS();
+}
+
+void GameManager::renderFeatureEdgeColorPass() {
+	PROFILE_FUNCTION();
+	glViewport(0, 0, window_width, window_height);
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glDepthMask(GL_FALSE);
+	pass_queries->begin(PassQueries::SKYBOX);
+	spacebox->render(camera.projection, cam_trackball_view_matrix);
+	pass_queries->end(PassQueries::SKYBOX);
+	glDepthMask(GL_TRUE);
+
+	//The surfaces are filled flat white with the depth pre-pass program and
+	//pushed back a little, so the edges on them pass the depth test while
+	//hidden edges still fail it
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.0f, 1.0f);
 	light_pov_program->use();
+	RenderSceneGeometry(light_pov_program, false);
+	light_pov_program->disuse();
+	glDisable(GL_POLYGON_OFFSET_FILL);
+
+	//Boundaries and creases are drawn as they are, while the geometry
+	//shader keeps the silhouette candidates that are silhouettes now
+	glDepthMask(GL_FALSE);
+	for(unsigned int pass = 0; pass < 2; pass++){
+		bool silhouettes = pass == 1;
+		std::shared_ptr<Program> program = silhouettes ? silhouette_edge_program : feature_edge_program;
+		program->use();
+
+		if(current_environment == PLAIN_CUBE_ROOM)
+			RenderEdges(program, edge_vao[0], cube_edges, cube_model_matrix, silhouettes);
+		else if(current_environment == OPEN_HALFROOM)
+			RenderEdges(program, edge_vao[1], room->getFeatureEdges(), room_model_matrix, silhouettes);
+
+		for (unsigned int i=0; i<number_of_models; ++i)
+			if(model_visible.at(i))
+				RenderEdges(program, edge_vao[2], bunny->getFeatureEdges(), model_matrices.at(i), silhouettes);
+
+		program->disuse();
+	}
+	glDepthMask(GL_TRUE);
+	glBindVertexArray(0);
+	CHECK_GL_ERRORS();
+}
+
+void GameManager::RenderEdges(std::shared_ptr<Program> program, GLuint vao, std::shared_ptr<FeatureEdges> edges,
+							  const glm::mat4& model_matrix, bool silhouettes){
+	glm::mat4 modelview_matrix = cam_trackball_view_matrix*model_matrix;
+	glm::mat4 modelviewprojection_matrix = camera.projection*modelview_matrix;
+
+	glBindVertexArray(vao);
+	glUniformMatrix4fv(program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+	if(silhouettes){
+		glm::mat4 modelview_matrix_inverse = glm::inverse(modelview_matrix);
+		glm::vec3 eye_position = glm::vec3(modelview_matrix_inverse[3])/modelview_matrix_inverse[3].w;
+		glUniform3fv(program->getUniform("eye_position"), 1, glm::value_ptr(eye_position));
+		edges->drawSilhouetteCandidates();
+	}
+	else{
+		edges->drawFeatureEdges();
+	}
+}
+
+void GameManager::RenderSceneGeometry(std::shared_ptr<Program> program, bool surface_uniforms){
+	//The matrices are multiplied in the same order as in the color pass, so the
+	//depth pre-pass produces the exact same depths for GL_EQUAL testing
+	if(current_environment == PLAIN_CUBE_ROOM){
+		glBindVertexArray(vao[1]);
+		glm::mat4 modelviewprojection_matrix = camera.projection*(cam_trackball_view_matrix*cube_model_matrix);
+		glUniformMatrix4fv(program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+		if(surface_uniforms){
+			glUniformMatrix4fv(program->getUniform("model_matrix"), 1, 0, glm::value_ptr(cube_model_matrix));
+			glUniform3fv(program->getUniform("color"), 1, glm::value_ptr(glm::vec3(0.1f, 0.1f, 0.7f)));
+		}
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+	}
+	else if(current_environment == OPEN_HALFROOM){
+		glBindVertexArray(vao[2]);
+		glm::mat4 modelviewprojection_matrix = camera.projection*(cam_trackball_view_matrix*room_model_matrix);
+		glUniformMatrix4fv(program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+		if(surface_uniforms){
+			glUniformMatrix4fv(program->getUniform("model_matrix"), 1, 0, glm::value_ptr(room_model_matrix));
+			glUniform3fv(program->getUniform("color"), 1, glm::value_ptr(glm::vec3(0.1f, 0.5f, 0.7f)));
+		}
+		MeshPart& mesh = room->getMesh();
+		glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
+	}
 
+	glBindVertexArray(vao[0]);
+	MeshPart& mesh = bunny->getMesh();
+	for (unsigned int i=0; i<number_of_models; ++i) {
+		if(!model_visible.at(i))
+			continue;
+		glm::mat4 modelviewprojection_matrix = camera.projection*(cam_trackball_view_matrix*model_matrices.at(i));
+		glUniformMatrix4fv(program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+		if(surface_uniforms){
+			glUniformMatrix4fv(program->getUniform("model_matrix"), 1, 0, glm::value_ptr(model_matrices.at(i)));
+			glUniform3fv(program->getUniform("color"), 1, glm::value_ptr(model_colors.at(i)));
+		}
+		glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
+	}
+	glBindVertexArray(0);
+}
+
+void GameManager::SetShadingUniforms(std::shared_ptr<Program> program){
+	glUniform1f(program->getUniform("diffuse_mix_value"), slider_diffuse_mix->get_slider_value());
+	glUniform1i(program->getUniform("shadow_technique"), current_shadow_technique);
+	glUniform1f(program->getUniform("light_bleeding_reduction"), slider_light_bleeding->get_slider_value());
+	glUniform3fv(program->getUniform("light_world_position"), 1, glm::value_ptr(light.position));
+	glUniform1f(program->getUniform("cube_shadow_far"), far_plane);
+
+	glUniform1i(program->getUniform("use_clustered_lights"), clustered_lighting);
+	if(clustered_lighting)
+	{
+		glm::ivec3 dims = light_clusters->getDimensions();
+		glm::vec2 tile_size = glm::vec2(window_width/(float) dims.x, window_height/(float) dims.y);
+		glm::vec2 depth_params = glm::vec2(light_clusters->getNear(), light_clusters->getSlicesPerLogDepth());
+		glUniform3iv(program->getUniform("cluster_dims"), 1, glm::value_ptr(dims));
+		glUniform2fv(program->getUniform("cluster_tile_size"), 1, glm::value_ptr(tile_size));
+		glUniform2fv(program->getUniform("cluster_depth_params"), 1, glm::value_ptr(depth_params));
+		glUniformMatrix4fv(program->getUniform("view_matrix"), 1, 0, glm::value_ptr(cam_trackball_view_matrix));
+	}
+}
+
+void GameManager::BindShadingTextures(){
+	//Bind shadow map, diffuse cube map, variance shadow map and cube shadow map
+	glActiveTexture(GL_TEXTURE0);
+	if(current_shadow_technique == ATLAS_SHADOWS)
+		glBindTexture(GL_TEXTURE_2D, shadow_atlas->getFBO()->getTexture());
+	else
+		glBindTexture(GL_TEXTURE_2D, shadow_fbo->getTexture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	diffuse_cubemap->bind(GL_TEXTURE1);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, vsm_fbo->getTexture());
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cube_shadow_fbo->getTexture());
+	glActiveTexture(GL_TEXTURE0);
+
+	if(clustered_lighting)
+		light_clusters->bind(4);
+}
+
+void GameManager::renderShadowPass() {	
+	PROFILE_FUNCTION();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	current_shadow_program->use();
+
+	if(current_shadow_technique == CUBE_SHADOWS)
+	{
+		glm::mat4 face_matrices[6];
+		for(unsigned int i = 0; i < 6; i++)
+			face_matrices[i] = CubeShadowFBO::getFaceMatrix(i, light.position, near_plane, far_plane);
+		glUniformMatrix4fv(current_shadow_program->getUniform("face_matrices"), 6, 0, glm::value_ptr(face_matrices[0]));
+		glUniform3fv(current_shadow_program->getUniform("light_position"), 1, glm::value_ptr(light.position));
+		glUniform1f(current_shadow_program->getUniform("far_clip"), far_plane);
+	}
+
+	if(current_shadow_technique == ATLAS_SHADOWS)
+	{
+		//All lights are rendered in this pass, each into the viewport of its tile
+		for(unsigned int i = 0; i < atlas_lights.size(); i++){
+			const ShadowAtlas::Tile& tile = shadow_atlas->getTile(i);
+			glViewport(tile.x, tile.y, tile.size, tile.size);
+			shadow_pass_viewprojection = atlas_lights[i].projection*atlas_lights[i].view;
+			RenderShadowCasters();
+		}
+	}
+	else
+	{
+		shadow_pass_viewprojection = light.projection*light.view;
+		RenderShadowCasters();
+	}
+
+	current_shadow_program->disuse();
+	ShadowFBO::unbind();
+}
+
+void GameManager::RenderShadowCasters(){
 	if(current_environment == PLAIN_CUBE_ROOM)
 		RenderCubeShadowpass();
 	else if(current_environment == OPEN_HALFROOM)
 		RenderRooomModelShadowpass();
 
 	RenderModelsShadowpass();
-
-	light_pov_program->disuse();
-	shadow_fbo->unbind();
 }
 
 void GameManager::renderDepthDump(){
+	PROFILE_FUNCTION();
+	//The depth dump shows a single 2D map, which the cube shadows do not have
+	if(current_shadow_technique == CUBE_SHADOWS)
+		return;
+
 	depth_dump_program->use();
 	glUniform1f(depth_dump_program->getUniform("gui_alpha"), slider_gui_alpha->get_slider_value());
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, shadow_fbo->getTexture());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	if(current_shadow_technique == ATLAS_SHADOWS){
+		//The atlas lights use the unfitted near and far planes
+		glUniform1f(depth_dump_program->getUniform("near_clip"), near_plane);
+		glUniform1f(depth_dump_program->getUniform("far_clip"), far_plane);
+		glBindTexture(GL_TEXTURE_2D, shadow_atlas->getFBO()->getTexture());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	}
+	else if(current_shadow_technique == VARIANCE_SHADOWS){
+		glUniform1f(depth_dump_program->getUniform("near_clip"), light.near_clip);
+		glUniform1f(depth_dump_program->getUniform("far_clip"), light.far_clip);
+		//The first moment is the depth, so the moments texture can be shown as is
+		glBindTexture(GL_TEXTURE_2D, vsm_fbo->getTexture());
+	}
+	else{
+		glUniform1f(depth_dump_program->getUniform("near_clip"), light.near_clip);
+		glUniform1f(depth_dump_program->getUniform("far_clip"), light.far_clip);
+		glBindTexture(GL_TEXTURE_2D, shadow_fbo->getTexture());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	}
 	glBindVertexArray(vao[3]);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -507,49 +1252,120 @@ void GameManager::renderDepthDump(){
 }
 
 void GameManager::render() {
+	PROFILE_FUNCTION();
+	if(!capture_file.empty() && pass_queries->getNextFrame() == capture_frame)
+		frame_capture.reset(new FrameCapture(window_width, window_height));
+	pass_queries->beginFrame();
+	performance_hud->setGLCounters(GLUtils::getTotalGLCounters());
+	GLUtils::resetGLCounters();
+
 	if(rotate_light){
 		glm::mat4 rotation = glm::rotate(delta_time*10.f, 0.0f, 1.0f, 0.0f);
 		light.position = glm::mat3(rotation)*light.position;
 		light.view = glm::lookAt(light.position,  glm::vec3(0), glm::vec3(0.0, 1.0, 0.0));
+		for(unsigned int i = 1; i < atlas_lights.size(); i++){
+			atlas_lights[i].position = glm::mat3(rotation)*atlas_lights[i].position;
+			atlas_lights[i].view = glm::lookAt(atlas_lights[i].position, glm::vec3(0), glm::vec3(0.0, 1.0, 0.0));
+		}
+		for(unsigned int i = 0; i < point_lights.size(); i++)
+			point_lights[i].position = glm::mat3(rotation)*point_lights[i].position;
 	}
-	
-	shadow_fbo->bind();
-	glViewport(0, 0, window_width, window_height);
-	renderShadowPass();
-	shadow_fbo->unbind();
+
+	//Create the new view matrix that takes the trackball view into account
+	cam_trackball_view_matrix = camera.view*cam_trackball.getTransform();
+	CullModels();
+
+	if(fit_light_frustum && current_shadow_technique != CUBE_SHADOWS && current_shadow_technique != ATLAS_SHADOWS)
+		FitLightFrustum();
+
+	if(clustered_lighting && current_program != wireframe_program && current_program != feature_edge_program)
+		light_clusters->update(cam_trackball_view_matrix, point_lights);
+
+	pass_queries->begin(PassQueries::SHADOW_PASS);
+	if(current_program == feature_edge_program){
+		//The flat fill of the feature edges is not shadowed
+	}
+	else if(current_shadow_technique == VARIANCE_SHADOWS){
+		vsm_fbo->bind();
+		glViewport(0, 0, vsm_fbo->getWidth(), vsm_fbo->getHeight());
+		glDisable(GL_BLEND);
+		renderShadowPass();
+		glEnable(GL_BLEND);
+		vsm_fbo->blur(vsm_blur_program, vao[3]);
+	}
+	else if(current_shadow_technique == CUBE_SHADOWS){
+		//All six faces are rendered in this one pass, see cube_shadow.geom
+		cube_shadow_fbo->bind();
+		glViewport(0, 0, cube_shadow_fbo->getSize(), cube_shadow_fbo->getSize());
+		renderShadowPass();
+	}
+	else if(current_shadow_technique == ATLAS_SHADOWS){
+		UpdateShadowAtlas();
+		shadow_atlas->getFBO()->bind();
+		renderShadowPass();
+	}
+	else{
+		shadow_fbo->bind();
+		glViewport(0, 0, shadow_fbo->getWidth(), shadow_fbo->getHeight());
+		renderShadowPass();
+		shadow_fbo->unbind();
+	}
+	pass_queries->end(PassQueries::SHADOW_PASS);
+
+	pass_queries->begin(PassQueries::COLOR_PASS);
 	renderColorPass();
+	pass_queries->end(PassQueries::COLOR_PASS);
 	
-	glBindFramebufferEXT(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
 
 	//Clearing the depth buffer to always draw on top of the previously rendered stuff
 	//before rendering GUI
 	glClear(GL_DEPTH_BUFFER_BIT);
 	if(render_gui_and_depth){
+		pass_queries->begin(PassQueries::DEPTH_DUMP);
 		renderDepthDump();
+		pass_queries->end(PassQueries::DEPTH_DUMP);
 
 		glDisable(GL_CULL_FACE);
+		pass_queries->begin(PassQueries::GUI);
 		RenderGUI();
+		pass_queries->end(PassQueries::GUI);
 		glEnable(GL_CULL_FACE);
 	}
 	CHECK_GL_ERRORS();
+
+	if(frame_capture){
+		frame_capture->write(capture_file);
+		std::cout << "Wrote the " << frame_capture->getCallCount() << " GL calls of frame " << capture_frame
+			<< " to " << capture_file << std::endl;
+		frame_capture.reset();
+		capture_file.clear();
+	}
 }
 
 void GameManager::RenderGUI(){
+	PROFILE_FUNCTION();
 	glBindVertexArray(gui_vao);
 	gui_program->use();
 	glUniform1f(gui_program->getUniform("gui_alpha"), slider_gui_alpha->get_slider_value());
 	rendermode_radiobtn->Draw();
 	environment_radiobtn->Draw();
+	shadowmode_radiobtn->Draw();
 	slider_gui_alpha->Draw();
 
-	if(current_program == hidden_line_program)
+	if(current_program == hidden_line_program || current_program == image_edge_program)
 	{
 		slider_line_threshold->Draw();
 		slider_line_scale->Draw();
 		slider_line_offset->Draw();
 	}
 	if(current_program != wireframe_program)
+	{
 		slider_diffuse_mix->Draw();
+		if(current_shadow_technique == VARIANCE_SHADOWS)
+			slider_light_bleeding->Draw();
+	}
+	performance_hud->draw(window_height);
 
 	gui_program->disuse();
 	glBindVertexArray(0);
@@ -557,104 +1373,437 @@ void GameManager::RenderGUI(){
 
 void GameManager::play() {
 	bool doExit = false;
-	float fps = 0.0f;
-	float fpsTimer = 0.0f;
+	double title_timer = 0.0;
+	Timer run_timer, frame_log_timer;
+	unsigned int frame = 0;
+	//The first frame starts now, not when loading started
+	my_timer.restart();
 	//SDL main loop
 	while (!doExit) {
-		delta_time = static_cast<float>(my_timer.elapsedAndRestart());
+		PROFILE_SCOPE("frame");
+		double frame_seconds = my_timer.elapsedAndRestart();
+		delta_time = static_cast<float>(frame_seconds);
+		frame_time_monitor.addFrame(frame_seconds*1000.0);
 		SDL_Event event;
-		while (SDL_PollEvent(&event)) {// poll for pending events
-			switch (event.type) {
-			case SDL_MOUSEWHEEL:
-				if (event.wheel.y > 0 )
-					zoomIn();
-				else if (event.wheel.y < 0 )
-					zoomOut();
-				break;
-			case SDL_MOUSEBUTTONDOWN:
-				{
-					bool started_interaction = false;
-					unsigned int slider_counter = 0;
-					while(!started_interaction && (slider_counter  < gui_sliders.size()) )
-					{
-						started_interaction = gui_sliders.at(slider_counter)->BeginInteraction(glm::vec2(event.motion.x, event.motion.y));
-						slider_counter ++;
-					}
-					if(!started_interaction)
-						cam_trackball.rotateBegin(event.motion.x, event.motion.y);
-
-					rendermode_radiobtn->OnClick(glm::vec2(event.motion.x, event.motion.y));
-					environment_radiobtn->OnClick(glm::vec2(event.motion.x, event.motion.y));
-				}
-				break;
-			case SDL_MOUSEBUTTONUP:
-				for(unsigned int i = 0; i < gui_sliders.size(); i++)
-					gui_sliders.at(i)->EndInteraction(glm::vec2(event.motion.x, event.motion.y));
-				cam_trackball.rotateEnd(event.motion.x, event.motion.y);
-				break;
-			case SDL_MOUSEMOTION:
-				for(unsigned int i = 0; i < gui_sliders.size(); i++)
-					gui_sliders.at(i)->Update(delta_time, glm::vec2(event.motion.x, event.motion.y));
-				cam_trackball.rotate(event.motion.x, event.motion.y, zoom);
+		if(input_replay) {
+			//The recorded events and time step replace the live ones, only
+			//closing the window still works
+			std::vector<SDL_Event> events;
+			if(!input_replay->nextFrame(events, delta_time))
 				break;
-			case SDL_KEYDOWN:
-				switch(event.key.keysym.sym) {
-				case SDLK_t:
-					render_gui_and_depth = !render_gui_and_depth;
-					break;
-				case SDLK_ESCAPE:
+			for(unsigned int i = 0; i < events.size(); i++)
+				HandleEvent(events.at(i), doExit);
+			while (SDL_PollEvent(&event)) {
+				if(event.type == SDL_QUIT)
 					doExit = true;
-					break;
-				case SDLK_q:
-					if (event.key.keysym.mod & KMOD_CTRL) 
-						doExit = true;
-					break;
-				case SDLK_PLUS:zoomIn();break;
-				case SDLK_MINUS:zoomOut();break;
-				case SDLK_1:UsePhongProgram();break;
-				case SDLK_2:UseWireframeProgram();break;
-				case SDLK_3:UseHiddenLineProgram();break;
-				case SDLK_5:
-					rotate_light = !rotate_light;
-				}
-				break;
-			case SDL_QUIT: //e.g., user clicks the upper right x
-				doExit = true;
-				break;
 			}
 		}
+		else {
+			while (SDL_PollEvent(&event)) {// poll for pending events
+				if(input_recorder)
+					input_recorder->record(frame, event);
+				HandleEvent(event, doExit);
+			}
+			if(input_recorder)
+				input_recorder->endFrame(frame, delta_time);
+		}
+		frame++;
 
 		//Render, and swap front and back buffers
 		render();
-		SDL_GL_SwapWindow(main_window);
+		double pass_cpu_ms[PassQueries::PASS_COUNT];
+		for(unsigned int i = 0; i < PassQueries::PASS_COUNT; i++)
+			pass_cpu_ms[i] = pass_queries->getCPUTime(static_cast<PassQueries::Passes>(i));
+		performance_hud->addFrame(my_timer.elapsed()*1000.0, pass_cpu_ms);
+		{
+			PROFILE_SCOPE("SDL_GL_SwapWindow");
+			SDL_GL_SwapWindow(main_window);
+		}
 
-		fpsTimer += delta_time;
-		if(fpsTimer >= 0.3f)//updating the fps counter once every .3sec
+		title_timer += frame_seconds;
+		if(title_timer >= 0.3)//updating the frame time statistics once every .3sec
 		{
-			fps = 1/delta_time;
-			std::ostringstream captionStream;		
-			captionStream << "FPS: " << fps;
+			FrameTimeMonitor::Summary summary = frame_time_monitor.getSummary();
+			std::ostringstream captionStream;
+			captionStream << std::fixed << std::setprecision(1) << "FPS: " << summary.fps
+				<< std::setprecision(2) << "  p99: " << summary.p99_ms << " ms  pacing: " << summary.pacing_ms
+				<< " ms  stutters: " << summary.stutters;
 			SDL_SetWindowTitle(main_window, captionStream.str().c_str());
-			fps = 0;
-			fpsTimer = 0;
+			title_timer = 0.0;
+		}
+		RecordFlightFrame(my_timer.elapsed()*1000.0, run_timer.elapsed());
+		if(frame_log && frame_log_timer.elapsed() >= frame_log_interval) {
+			frame_time_monitor.writeJSONLine(*frame_log, run_timer.elapsed());
+			frame_log->flush();
+			frame_log_timer.restart();
 		}
 	}
+	if(input_replay)
+		std::cout << "Replayed " << frame << " of " << input_replay->getFrameCount() << " recorded frames" << std::endl;
 	quit();
 }
 
-void GameManager::zoomIn() {
-	zoom *= 1.1f;
+void GameManager::HandleEvent(const SDL_Event& event, bool& doExit) {
+	PROFILE_FUNCTION();
+	switch (event.type) {
+	case SDL_MOUSEWHEEL:
+		if (event.wheel.y > 0 )
+			zoomIn();
+		else if (event.wheel.y < 0 )
+			zoomOut();
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+		{
+			bool started_interaction = false;
+			unsigned int slider_counter = 0;
+			while(!started_interaction && (slider_counter  < gui_sliders.size()) )
+			{
+				started_interaction = gui_sliders.at(slider_counter)->BeginInteraction(glm::vec2(event.motion.x, event.motion.y));
+				slider_counter ++;
+			}
+			if(!started_interaction)
+				cam_trackball.rotateBegin(event.motion.x, event.motion.y);
+
+			rendermode_radiobtn->OnClick(glm::vec2(event.motion.x, event.motion.y));
+			environment_radiobtn->OnClick(glm::vec2(event.motion.x, event.motion.y));
+			shadowmode_radiobtn->OnClick(glm::vec2(event.motion.x, event.motion.y));
+		}
+		break;
+	case SDL_MOUSEBUTTONUP:
+		for(unsigned int i = 0; i < gui_sliders.size(); i++)
+			gui_sliders.at(i)->EndInteraction(glm::vec2(event.motion.x, event.motion.y));
+		cam_trackball.rotateEnd(event.motion.x, event.motion.y);
+		break;
+	case SDL_MOUSEMOTION:
+		for(unsigned int i = 0; i < gui_sliders.size(); i++)
+			gui_sliders.at(i)->Update(delta_time, glm::vec2(event.motion.x, event.motion.y));
+		cam_trackball.rotate(event.motion.x, event.motion.y, zoom);
+		break;
+	case SDL_KEYDOWN:
+		switch(event.key.keysym.sym) {
+		case SDLK_t:
+			render_gui_and_depth = !render_gui_and_depth;
+			break;
+		case SDLK_ESCAPE:
+			doExit = true;
+			break;
+		case SDLK_q:
+			if (event.key.keysym.mod & KMOD_CTRL) 
+				doExit = true;
+			break;
+		case SDLK_PLUS:zoomIn();break;
+		case SDLK_MINUS:zoomOut();break;
+		case SDLK_1:UsePhongProgram();break;
+		case SDLK_2:UseWireframeProgram();break;
+		case SDLK_3:UseHiddenLineProgram();break;
+		case SDLK_4:UseDeferredProgram();break;
+		case SDLK_6:UseFeatureEdgeProgram();break;
+		case SDLK_7:UseImageEdgeProgram();break;
+		case SDLK_5:
+			rotate_light = !rotate_light;
+			break;
+		case SDLK_F1:
+			{
+				//Cycle the shadow map size between 512 and 4096
+				unsigned int size = shadow_fbo->getWidth()*2;
+				if(size > 4096)
+					size = 512;
+				SetShadowMapSize(size, size);
+			}
+			break;
+		case SDLK_F2:
+			switch(shadow_fbo->getDepthFormat()) {
+			case GL_DEPTH_COMPONENT16: SetShadowMapFormat(GL_DEPTH_COMPONENT24); break;
+			case GL_DEPTH_COMPONENT24: SetShadowMapFormat(GL_DEPTH_COMPONENT32F); break;
+			default: SetShadowMapFormat(GL_DEPTH_COMPONENT16); break;
+			}
+			break;
+		case SDLK_F3:
+			fit_light_frustum = !fit_light_frustum;
+			if(!fit_light_frustum){
+				light.near_clip = near_plane;
+				light.far_clip = far_plane;
+				light.projection = glm::perspective(90.0f, 1.0f, light.near_clip, light.far_clip);
+			}
+			std::cout << "Light frustum fitting " << (fit_light_frustum ? "on" : "off") << std::endl;
+			break;
+		case SDLK_F10:
+			captureFrame("frame.gltrace", pass_queries->getNextFrame());
+			break;
+		case SDLK_F9:
+			//The first press starts recording, the next ones write what was recorded
+			if(!profiler::isEnabled()){
+				profiler::setEnabled(true);
+				std::cout << "Profiling, F9 again writes the last " << profiler::getTraceSeconds() << " s to trace.json" << std::endl;
+			}
+			else if(profiler::writeChromeTrace("trace.json"))
+				std::cout << "Wrote trace.json" << std::endl;
+			else
+				std::cout << "Could not write trace.json" << std::endl;
+			break;
+		case SDLK_F8:
+			SetShaderQuality(static_cast<ShaderQualities>((shader_quality+1)%3));
+			break;
+		case SDLK_F7:
+			PrintColorPassTimes();
+			SetGeometryShaderVariants(!use_geometry_shaders);
+			std::cout << "Geometry shaders " << (use_geometry_shaders ? "on" : "off") << std::endl;
+			break;
+		case SDLK_F6:
+			{
+				//Cycle the depth pre-pass between off, on and auto
+				const char* names[] = {"off", "on", "auto"};
+				depth_prepass_mode = static_cast<DepthPrepassModes>((depth_prepass_mode+1) % 3);
+				std::cout << "Depth pre-pass " << names[depth_prepass_mode] << std::endl;
+			}
+			break;
+		case SDLK_F5:
+			clustered_lighting = !clustered_lighting;
+			std::cout << "Clustered point lights (" << point_lights.size() << ") " << (clustered_lighting ? "on" : "off") << std::endl;
+			break;
+		case SDLK_F4:
+			if(current_shadow_technique == PCF_SHADOWS)
+				UseVarianceShadows();
+			else if(current_shadow_technique == VARIANCE_SHADOWS)
+				UseCubeShadows();
+			else if(current_shadow_technique == CUBE_SHADOWS)
+				UseAtlasShadows();
+			else
+				UsePCFShadows();
+			break;
+		}
+		break;
+	case SDL_QUIT: //e.g., user clicks the upper right x
+		doExit = true;
+		break;
+	}
+}
+
+void GameManager::RecordFlightFrame(double frame_ms, double time_s) {
+	FlightRecorder::FrameRecord record;
+	record.frame = pass_queries->getNextFrame() - 1;
+	record.time_s = time_s;
+	record.frame_ms = frame_ms;
+	for(unsigned int i = 0; i < PassQueries::PASS_COUNT; i++)
+		record.cpu_ms[i] = pass_queries->getCPUTime(static_cast<PassQueries::Passes>(i));
+	record.gpu_measured = false;
+	record.draw_calls = GLUtils::getTotalGLCounters().draw_calls;
+	flight_recorder.recordFrame(record);
+
+	PassQueries::FrameStats stats;
+	while(pass_queries->popCompleted(stats)) {
+		flight_recorder.addGPUResults(stats);
+		performance_hud->addGPUFrame(stats);
+	}
+}
+
+void GameManager::setFrameLog(const std::string& filename, double interval_s) {
+	frame_log.reset(new std::ofstream(filename.c_str()));
+	if(!frame_log->good())
+		THROW_EXCEPTION("Could not open " + filename + " for the frame time log");
+	frame_log_interval = interval_s;
+}
+
+void GameManager::captureFrame(const std::string& filename, unsigned int frame) {
+	if(!FrameCapture::isAvailable()){
+		std::cout << "Frame capture needs a build with PG612_GL_CAPTURE" << std::endl;
+		return;
+	}
+	capture_file = filename;
+	capture_frame = frame;
+	std::cout << "Capturing frame " << frame << " to " << filename << std::endl;
+}
+
+void GameManager::recordInput(const std::string& filename) {
+	input_recorder.reset(new InputRecorder(filename, random_seed, window_width, window_height));
+}
+
+void GameManager::setInputReplay(std::shared_ptr<InputReplay> replay) {
+	input_replay = replay;
+}
+
+void GameManager::playHeadless(unsigned int frames) {
+	//A fixed time step, so every run renders the same frames
+	delta_time = 1.0f/60.0f;
+
+	Timer run_timer;
+	double min_frame_ms = 0.0, max_frame_ms = 0.0;
+	for(unsigned int i = 0; i < frames; i++) {
+		Timer frame_timer;
+		render();
+		double frame_ms = frame_timer.elapsed()*1000.0;
+		if(i == 0 || frame_ms < min_frame_ms)
+			min_frame_ms = frame_ms;
+		max_frame_ms = std::max(max_frame_ms, frame_ms);
+	}
+	//Nothing is swapped, so wait for the GPU before stopping the clock
+	glFinish();
+	double total_ms = run_timer.elapsed()*1000.0;
+
+	std::cout << "Rendered " << frames << " headless frames in " << total_ms << " ms: "
+			  << total_ms/std::max(frames, 1u) << " ms per frame, " << frames*1000.0/std::max(total_ms, 0.001) << " FPS "
+			  << "(CPU submit " << min_frame_ms << " to " << max_frame_ms << " ms)" << std::endl;
+	quit();
+}
+
+void GameManager::runBenchmark(const std::vector<BenchmarkScenario>& scenarios, std::ostream& json) {
+	//The frame rate must not be capped by the display
+	if(main_window != NULL)
+		SDL_GL_SetSwapInterval(0);
+
+	//Every scenario starts with the lights as they were created
+	Light initial_light = light;
+	std::vector<Light> initial_atlas_lights = atlas_lights;
+	std::vector<PointLight> initial_point_lights = point_lights;
+
+	std::vector<BenchmarkResult> results;
+	for(unsigned int s = 0; s < scenarios.size(); s++) {
+		const BenchmarkScenario& scenario = scenarios.at(s);
+		std::cout << "Benchmark " << scenario.name << std::endl;
+
+		//The same bunnies whatever scenarios ran before
+		number_of_models = scenario.models;
+		srand(random_seed);
+		Init_CreateModels();
+
+		light = initial_light;
+		atlas_lights = initial_atlas_lights;
+		point_lights = initial_point_lights;
+		rotate_light = scenario.rotate_light;
+		if(scenario.open_room)
+			SetBackgroundToOpenRoom();
+		else
+			SetBackgroundToCube();
+		if(scenario.render_mode == BenchmarkScenario::WIREFRAME)
+			UseWireframeProgram();
+		else if(scenario.render_mode == BenchmarkScenario::HIDDEN_LINE)
+			UseHiddenLineProgram();
+		else
+			UsePhongProgram();
+
+		cam_trackball = VirtualTrackball();
+		cam_trackball.setWindowSize(window_width, window_height);
+		SetZoom(1.0f);
+		delta_time = 1.0f/60.0f;
+
+		//Two timestamps per measured frame, read back when the scenario is done so nothing stalls
+		std::vector<GLuint> timestamps(2*scenario.frames);
+		if(!timestamps.empty())
+			glGenQueries(static_cast<GLsizei>(timestamps.size()), &timestamps[0]);
+
+		BenchmarkResult result;
+		result.scenario = scenario;
+		std::vector<GLUtils::GLCounters> pass_counters(PassQueries::PASS_COUNT);
+		unsigned int total_frames = scenario.warmup_frames + scenario.frames;
+		pass_queries->flush();
+		pass_queries->takeCompleted();
+		unsigned int first_measured_frame = pass_queries->getNextFrame() + scenario.warmup_frames;
+		if(scenario.camera_path == BenchmarkScenario::CAMERA_ORBIT)
+			cam_trackball.rotateBegin(window_width/4, window_height/2);
+		for(unsigned int i = 0; i < total_frames; i++) {
+			float t = i / static_cast<float>(std::max(total_frames-1, 1u));
+			if(scenario.camera_path == BenchmarkScenario::CAMERA_ORBIT)
+				cam_trackball.rotate(static_cast<int>(window_width*(0.25f + 0.5f*t)), window_height/2, zoom);
+			else if(scenario.camera_path == BenchmarkScenario::CAMERA_ZOOM)
+				SetZoom(0.5f + 2.0f*t);
+
+			bool measured = i >= scenario.warmup_frames;
+			unsigned int frame = i - scenario.warmup_frames;
+			if(measured)
+				glQueryCounter(timestamps.at(2*frame), GL_TIMESTAMP);
+			Timer frame_timer;
+			render();
+			double frame_ms = frame_timer.elapsed()*1000.0;
+			if(measured) {
+				glQueryCounter(timestamps.at(2*frame+1), GL_TIMESTAMP);
+				result.cpu_ms.push_back(frame_ms);
+				for(unsigned int p = 0; p < PassQueries::PASS_COUNT; p++)
+					pass_counters[p].add(GLUtils::getGLCounters(PassQueries::counterSlot(static_cast<PassQueries::Passes>(p))));
+			}
+
+			if(main_window != NULL) {
+				SDL_GL_SwapWindow(main_window);
+				SDL_PumpEvents();
+			}
+		}
+		if(scenario.camera_path == BenchmarkScenario::CAMERA_ORBIT)
+			cam_trackball.rotateEnd(window_width*3/4, window_height/2);
+
+		glFinish();
+		for(unsigned int i = 0; i < scenario.frames; i++) {
+			GLuint64 begin, end;
+			glGetQueryObjectui64v(timestamps.at(2*i), GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(timestamps.at(2*i+1), GL_QUERY_RESULT, &end);
+			result.gpu_ms.push_back((end - begin)/1.0e6);
+		}
+		if(!timestamps.empty())
+			glDeleteQueries(static_cast<GLsizei>(timestamps.size()), &timestamps[0]);
+		CHECK_GL_ERRORS();
+
+		pass_queries->flush();
+		std::vector<PassQueries::FrameStats> pass_frames = pass_queries->takeCompleted();
+		for(unsigned int p = 0; p < PassQueries::PASS_COUNT; p++) {
+			PassResult pass;
+			pass.name = PassQueries::passName(static_cast<PassQueries::Passes>(p));
+			pass.vertices = pass.primitives = pass.fragments = 0.0;
+			pass.counters = pass_counters[p];
+			pass.counted_frames = scenario.frames;
+			for(unsigned int i = 0; i < pass_frames.size(); i++) {
+				const PassQueries::FrameStats& stats = pass_frames.at(i);
+				if(stats.frame < first_measured_frame || !stats.measured[p])
+					continue;
+				pass.gpu_ms.push_back(stats.gpu_ms[p]);
+				pass.vertices += stats.vertices[p];
+				pass.primitives += stats.primitives[p];
+				pass.fragments += stats.fragments[p];
+			}
+			if(pass.gpu_ms.empty())
+				continue;
+			pass.vertices /= pass.gpu_ms.size();
+			pass.primitives /= pass.gpu_ms.size();
+			pass.fragments /= pass.gpu_ms.size();
+			result.passes.push_back(pass);
+		}
+
+		FrameTimeStats cpu(result.cpu_ms), gpu(result.gpu_ms);
+		std::cout << "  CPU mean " << cpu.mean << " ms, p99 " << cpu.p99 << " ms; GPU mean "
+				  << gpu.mean << " ms, p99 " << gpu.p99 << " ms" << std::endl;
+		results.push_back(result);
+	}
+
+	writeBenchmarkJSON(json, results, random_seed, reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+					   window_width, window_height, pass_queries->hasPipelineStatistics());
+
+	if(main_window != NULL)
+		SDL_GL_SetSwapInterval(1);
+}
+
+void GameManager::SetZoom(float zoom) {
+	this->zoom = zoom;
 	camera.projection = glm::perspective(fovy/zoom,
 			window_width / (float) window_height, near_plane, far_plane);
+	light_clusters->setProjection(fovy/zoom, window_width / (float) window_height, near_plane, far_plane);
+}
+
+void GameManager::zoomIn() {
+	SetZoom(zoom*1.1f);
 }
 
 void GameManager::zoomOut() {
-	zoom = std::max(zoom*0.9f, 0.5f);
-	camera.projection = glm::perspective(fovy/zoom,
-			window_width / (float) window_height, near_plane, far_plane);
+	SetZoom(std::max(zoom*0.9f, 0.5f));
 }
 
 void GameManager::quit() {
+	PrintColorPassTimes();
+	if(frame_time_monitor.getTotalFrames() > 0) {
+		FrameTimeMonitor::Summary summary = frame_time_monitor.getSummary();
+		std::cout << "Frame times of the last " << summary.frames << " frames: mean " << summary.mean_ms
+				  << " ms, p50 " << summary.p50_ms << " ms, p99 " << summary.p99_ms << " ms, pacing "
+				  << summary.pacing_ms << " ms; " << frame_time_monitor.getTotalStutters() << " stutters in "
+				  << frame_time_monitor.getTotalFrames() << " frames" << std::endl;
+	}
+	pass_queries->print(std::cout);
+	PrintGLCounters();
 	std::cout << "Bye bye..." << std::endl;
 }
 
@@ -679,6 +1828,27 @@ void GameManager::UseHiddenLineProgram(){
 	}
 }
 
+void GameManager::UseDeferredProgram(){
+	if(current_program != gbuffer_program){
+		current_program = gbuffer_program;
+		rendermode_radiobtn->SetActive(3);
+	}
+}
+
+void GameManager::UseFeatureEdgeProgram(){
+	if(current_program != feature_edge_program){
+		current_program = feature_edge_program;
+		rendermode_radiobtn->SetActive(4);
+	}
+}
+
+void GameManager::UseImageEdgeProgram(){
+	if(current_program != image_edge_program){
+		current_program = image_edge_program;
+		rendermode_radiobtn->SetActive(5);
+	}
+}
+
 void GameManager::RenderCubeColorpass(){
 	glBindVertexArray(vao[1]);
 
@@ -687,9 +1857,7 @@ void GameManager::RenderCubeColorpass(){
 	glm::mat4 modelviewprojection_matrix = camera.projection*modelview_matrix;
 	glm::vec3 light_pos = glm::mat3(cube_model_matrix_inverse)*light.position/cube_model_matrix_inverse[3].w;
 
-	glm::mat4 light_modelview_matrix = light.view*cube_model_matrix;
-	glm::mat4 shadowMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5-0.01f));
-	shadowMatrix = glm::scale(shadowMatrix, glm::vec3(0.5f, 0.5f, 0.5f*1.01f)) * light.projection * light_modelview_matrix;
+	glm::mat4 shadowMatrix = GetShadowMatrix(cube_model_matrix);
 
 	glUniformMatrix4fv(current_program->getUniform("shadow_matrix"), 1, 0, glm::value_ptr(shadowMatrix));
 
@@ -698,6 +1866,8 @@ void GameManager::RenderCubeColorpass(){
 	glUniform3fv(current_program->getUniform("color"), 1, glm::value_ptr(glm::vec3(0.1f, 0.1f, 0.7f)));
 	glUniformMatrix4fv(current_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
 	glUniformMatrix4fv(current_program->getUniform("modelview_matrix_inverse"),	1, 0, glm::value_ptr(modelview_matrix_inverse));
+	if(current_program != wireframe_program)
+		glUniformMatrix4fv(current_program->getUniform("model_matrix"), 1, 0, glm::value_ptr(cube_model_matrix));
 
 	glDrawArrays(GL_TRIANGLES, 0, 36);
 }
@@ -705,19 +1875,17 @@ void GameManager::RenderCubeColorpass(){
 void GameManager::RenderCubeShadowpass(){
 	glBindVertexArray(vao[1]);
 
-	glm::mat4 modelview_matrix = light.view*cube_model_matrix;
-	glm::mat4 modelview_matrix_inverse = glm::inverse(modelview_matrix);
-	glm::mat4 modelviewprojection_matrix = light.projection*modelview_matrix;
-	glm::vec3 light_pos = glm::mat3(cube_model_matrix_inverse)*light.position/cube_model_matrix_inverse[3].w;
-
-	glUniformMatrix4fv(light_pov_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+	SetShadowPassModelMatrix(cube_model_matrix);
 	CHECK_GL_ERRORS();
 	glDrawArrays(GL_TRIANGLES, 0, 36);
 }
 
 void GameManager::RenderModelsColorpass(){
-	glBindVertexArray(vao[0]);
-	for (int i=0; i<number_of_models; ++i) {
+	bool deindexed = current_program == hidden_line_direct_program;
+	glBindVertexArray(deindexed ? deindexed_vao[0] : vao[0]);
+	for (unsigned int i=0; i<number_of_models; ++i) {
+		if(!model_visible.at(i))
+			continue;
 		glm::mat4 model_matrix = model_matrices.at(i);
 		glm::mat4 model_matrix_inverse = model_inverse_matrices.at(i);
 		glm::mat4 modelview_matrix = cam_trackball_view_matrix*model_matrix;
@@ -725,9 +1893,7 @@ void GameManager::RenderModelsColorpass(){
 		glm::mat4 modelviewprojection_matrix = camera.projection*modelview_matrix;
 		glm::vec3 light_pos = glm::mat3(model_matrix_inverse)*light.position/model_matrix_inverse[3].w;
 
-		glm::mat4 light_modelview_matrix = light.view*model_matrix;
-		glm::mat4 shadowMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5-0.01f));
-		shadowMatrix = glm::scale(shadowMatrix, glm::vec3(0.5f, 0.5f, 0.5f*1.01f)) * light.projection * light_modelview_matrix;
+		glm::mat4 shadowMatrix = GetShadowMatrix(model_matrix);
 
 		glUniformMatrix4fv(current_program->getUniform("shadow_matrix"), 1, 0, glm::value_ptr(shadowMatrix));
 
@@ -735,20 +1901,21 @@ void GameManager::RenderModelsColorpass(){
 		glUniform3fv(current_program->getUniform("color"), 1, glm::value_ptr(model_colors.at(i)));
 		glUniformMatrix4fv(current_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
 		glUniformMatrix4fv(current_program->getUniform("modelview_matrix_inverse"), 1, 0, glm::value_ptr(modelview_matrix_inverse));
+		if(current_program != wireframe_program)
+			glUniformMatrix4fv(current_program->getUniform("model_matrix"), 1, 0, glm::value_ptr(model_matrix));
 
 		MeshPart& mesh = bunny->getMesh();
-		glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
+		if(deindexed)
+			glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+		else
+			glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
 	}
 }
 
 void GameManager::RenderModelsShadowpass(){
 	glBindVertexArray(vao[0]);
-	for (int i=0; i<number_of_models; ++i) {
-		glm::mat4 model_matrix = model_matrices.at(i);
-		glm::mat4 modelview_matrix = light.view*model_matrix;
-		glm::mat4 modelviewprojection_matrix = light.projection*modelview_matrix;
-
-		glUniformMatrix4fv(light_pov_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+	for (unsigned int i=0; i<number_of_models; ++i) {
+		SetShadowPassModelMatrix(model_matrices.at(i));
 
 		MeshPart& mesh = bunny->getMesh();
 		glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
@@ -757,27 +1924,32 @@ void GameManager::RenderModelsShadowpass(){
 }
 
 void GameManager::RenderRoomModelColorpass(){
-	glBindVertexArray(vao[2]);
+	bool deindexed = current_program == hidden_line_direct_program;
+	glBindVertexArray(deindexed ? deindexed_vao[1] : vao[2]);
 
 	glm::mat4 modelview_matrix = cam_trackball_view_matrix*room_model_matrix;
 	glm::mat4 modelviewprojection_matrix = camera.projection*modelview_matrix;
+	glm::mat4 shadowMatrix = GetShadowMatrix(room_model_matrix);
 
+	glUniformMatrix4fv(current_program->getUniform("shadow_matrix"), 1, 0, glm::value_ptr(shadowMatrix));
 	glUniform3fv(current_program->getUniform("color"), 1, glm::value_ptr(glm::vec3(0.1f, 0.5f, 0.7f)));
 	glUniformMatrix4fv(current_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
 	glUniformMatrix4fv(current_program->getUniform("modelview_matrix_inverse"), 1, 0, glm::value_ptr(room_model_matrix_inverse));
+	if(current_program != wireframe_program)
+		glUniformMatrix4fv(current_program->getUniform("model_matrix"), 1, 0, glm::value_ptr(room_model_matrix));
 
 	MeshPart& mesh = room->getMesh();
-	glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
+	if(deindexed)
+		glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+	else
+		glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.first));
 	glBindVertexArray(0);
 }
 
 void GameManager::RenderRooomModelShadowpass(){
 	glBindVertexArray(vao[2]);
 
-	glm::mat4 modelview_matrix = light.view*room_model_matrix;
-	glm::mat4 modelviewprojection_matrix = light.projection*modelview_matrix;
-
-	glUniformMatrix4fv(light_pov_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+	SetShadowPassModelMatrix(room_model_matrix);
 
 	CHECK_GL_ERRORS();
 	MeshPart& mesh = room->getMesh();
@@ -786,6 +1958,212 @@ void GameManager::RenderRooomModelShadowpass(){
 	CHECK_GL_ERRORS();
 }
 
+void GameManager::SetShadowMapSize(unsigned int width, unsigned int height){
+	GLenum depth_format = shadow_fbo->getDepthFormat();
+	shadow_fbo.reset(new ShadowFBO(width, height, depth_format));
+	vsm_fbo.reset(new VarianceShadowFBO(width, height));
+	cube_shadow_fbo.reset(new CubeShadowFBO(width, depth_format));
+	std::cout << "Shadow map: " << width << "x" << height << " " << ShadowFBO::depthFormatName(depth_format) << std::endl;
+}
+
+void GameManager::SetShadowMapFormat(GLenum depth_format){
+	unsigned int width = shadow_fbo->getWidth();
+	unsigned int height = shadow_fbo->getHeight();
+	shadow_fbo.reset(new ShadowFBO(width, height, depth_format));
+	cube_shadow_fbo.reset(new CubeShadowFBO(width, depth_format));
+	shadow_atlas.reset(new ShadowAtlas(shadow_atlas_size, depth_format));
+	std::cout << "Shadow map: " << width << "x" << height << " " << ShadowFBO::depthFormatName(depth_format) << std::endl;
+}
+
+AABB GameManager::GetCasterBounds(){
+	//The cube room encloses the light, so its walls only receive shadows
+	AABB bounds;
+	if(current_environment == OPEN_HALFROOM)
+		bounds.extend(room->getBounds().transformed(room_model_matrix));
+
+	AABB bunny_bounds = bunny->getBounds();
+	for (unsigned int i=0; i<number_of_models; ++i)
+		bounds.extend(bunny_bounds.transformed(model_matrices.at(i)));
+
+	return bounds;
+}
+
+AABB GameManager::GetSceneBounds(){
+	AABB bounds = GetCasterBounds();
+	if(current_environment == PLAIN_CUBE_ROOM)
+		bounds.extend(AABB(glm::vec3(-0.5f), glm::vec3(0.5f)).transformed(cube_model_matrix));
+	return bounds;
+}
+
+AABB GameManager::GetViewFrustumBounds(){
+	//The frustum is the NDC cube transformed back to world space
+	glm::mat4 inverse_viewprojection = glm::inverse(camera.projection*cam_trackball_view_matrix);
+	return AABB(glm::vec3(-1.0f), glm::vec3(1.0f)).transformed(inverse_viewprojection);
+}
+
+/**
+* Finds the extents of the param box as seen from the light. The slopes are x/depth
+* and y/depth in light view space, clamped to the 90 degree frustum [-1, 1]. If the box
+* reaches behind min_depth, the slopes cover the whole 90 degree frustum.
+*/
+static void getLightSpaceExtents(const AABB& box, const glm::mat4& light_view, float min_depth,
+								 glm::vec2& slope_min, glm::vec2& slope_max,
+								 float& depth_min, float& depth_max)
+{
+	bool behind_light = false;
+	slope_min = glm::vec2(std::numeric_limits<float>::max());
+	slope_max = -glm::vec2(std::numeric_limits<float>::max());
+	depth_min = std::numeric_limits<float>::max();
+	depth_max = -std::numeric_limits<float>::max();
+
+	for(unsigned int i = 0; i < 8; i++){
+		glm::vec3 p = glm::vec3(light_view*glm::vec4(box.corner(i), 1.0f));
+		float depth = -p.z;
+		depth_min = std::min(depth_min, depth);
+		depth_max = std::max(depth_max, depth);
+
+		if(depth < min_depth){
+			behind_light = true;
+			continue;
+		}
+		glm::vec2 slope = glm::vec2(p.x, p.y)/depth;
+		slope_min = glm::min(slope_min, slope);
+		slope_max = glm::max(slope_max, slope);
+	}
+
+	if(behind_light){
+		slope_min = glm::vec2(-1.0f);
+		slope_max = glm::vec2(1.0f);
+	}
+	slope_min = glm::clamp(slope_min, glm::vec2(-1.0f), glm::vec2(1.0f));
+	slope_max = glm::clamp(slope_max, glm::vec2(-1.0f), glm::vec2(1.0f));
+}
+
+void GameManager::CullModels(){
+	model_visible.resize(number_of_models);
+	culled_models = 0;
+	AABB bunny_bounds = bunny->getBounds();
+	glm::mat4 viewprojection = camera.projection*cam_trackball_view_matrix;
+	for (unsigned int i=0; i<number_of_models; ++i) {
+		model_visible.at(i) = !bunny_bounds.outsideFrustum(viewprojection*model_matrices.at(i));
+		if(!model_visible.at(i))
+			culled_models++;
+	}
+	performance_hud->setInstances(number_of_models - culled_models, culled_models);
+}
+
+void GameManager::FitLightFrustum(){
+	PROFILE_FUNCTION();
+	AABB caster_bounds = GetCasterBounds();
+	AABB receiver_bounds = AABB::intersection(GetViewFrustumBounds(), GetSceneBounds());
+	if(!caster_bounds.valid() || !receiver_bounds.valid())
+		return;
+
+	glm::vec2 caster_slope_min, caster_slope_max, receiver_slope_min, receiver_slope_max;
+	float caster_near, caster_far, receiver_near, receiver_far;
+	getLightSpaceExtents(caster_bounds, light.view, near_plane, caster_slope_min, caster_slope_max, caster_near, caster_far);
+	getLightSpaceExtents(receiver_bounds, light.view, near_plane, receiver_slope_min, receiver_slope_max, receiver_near, receiver_far);
+
+	//Only the part of the visible receivers that casters can shadow needs texels,
+	//while the depth range must reach from the nearest caster to the farthest receiver
+	glm::vec2 slope_min = glm::max(caster_slope_min, receiver_slope_min);
+	glm::vec2 slope_max = glm::min(caster_slope_max, receiver_slope_max);
+	float near_clip = std::max(near_plane, caster_near);
+	float far_clip = std::min(far_plane, receiver_far);
+
+	if(slope_min.x >= slope_max.x || slope_min.y >= slope_max.y || far_clip <= near_clip)
+		return;
+
+	light.near_clip = near_clip;
+	light.far_clip = far_clip;
+	light.projection = glm::frustum(slope_min.x*near_clip, slope_max.x*near_clip,
+									slope_min.y*near_clip, slope_max.y*near_clip,
+									near_clip, far_clip);
+}
+
+glm::mat4 GameManager::GetShadowMatrix(const glm::mat4& model_matrix){
+	glm::mat4 light_modelview_matrix = light.view*model_matrix;
+
+	//Variance shadows handle depth bias through the variance, so only the
+	//depth map compared with PCF gets the offset against shadow acne
+	glm::mat4 shadowMatrix;
+	if(current_shadow_technique == VARIANCE_SHADOWS){
+		shadowMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f));
+		shadowMatrix = glm::scale(shadowMatrix, glm::vec3(0.5f, 0.5f, 0.5f));
+	}
+	else{
+		shadowMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5-0.01f));
+		shadowMatrix = glm::scale(shadowMatrix, glm::vec3(0.5f, 0.5f, 0.5f*1.01f));
+	}
+	return shadowMatrix * light.projection * light_modelview_matrix;
+}
+
+void GameManager::SetShadowPassModelMatrix(const glm::mat4& model_matrix){
+	if(current_shadow_technique == CUBE_SHADOWS){
+		glUniformMatrix4fv(current_shadow_program->getUniform("model_matrix"), 1, 0, glm::value_ptr(model_matrix));
+	}
+	else{
+		glm::mat4 modelviewprojection_matrix = shadow_pass_viewprojection*model_matrix;
+		glUniformMatrix4fv(current_shadow_program->getUniform("modelviewprojection_matrix"), 1, 0, glm::value_ptr(modelviewprojection_matrix));
+	}
+}
+
+float GameManager::GetScreenImportance(const Light& shadow_light){
+	AABB light_bounds = AABB(glm::vec3(-1.0f), glm::vec3(1.0f)).transformed(glm::inverse(shadow_light.projection*shadow_light.view));
+	AABB receiver_bounds = AABB::intersection(AABB::intersection(light_bounds, GetSceneBounds()), GetViewFrustumBounds());
+	if(!receiver_bounds.valid())
+		return 0.0f;
+
+	glm::mat4 viewprojection = camera.projection*cam_trackball_view_matrix;
+	glm::vec2 screen_min(1.0f), screen_max(-1.0f);
+	for(unsigned int i = 0; i < 8; i++){
+		glm::vec4 p = viewprojection*glm::vec4(receiver_bounds.corner(i), 1.0f);
+		//A corner behind the camera means the receivers surround it
+		if(p.w <= 0.0f)
+			return 1.0f;
+		glm::vec2 ndc = glm::vec2(p)/p.w;
+		screen_min = glm::min(screen_min, ndc);
+		screen_max = glm::max(screen_max, ndc);
+	}
+	screen_min = glm::clamp(screen_min, glm::vec2(-1.0f), glm::vec2(1.0f));
+	screen_max = glm::clamp(screen_max, glm::vec2(-1.0f), glm::vec2(1.0f));
+	glm::vec2 extent = glm::max(screen_max-screen_min, glm::vec2(0.0f));
+	return extent.x*extent.y*0.25f;
+}
+
+void GameManager::UpdateShadowAtlas(){
+	PROFILE_FUNCTION();
+	atlas_lights[0].position = light.position;
+	atlas_lights[0].view = light.view;
+
+	//A light covering the whole screen gets half the atlas side, and the side
+	//shrinks with the square root of the covered screen fraction
+	std::vector<unsigned int> tile_sizes;
+	for(unsigned int i = 0; i < atlas_lights.size(); i++){
+		float importance = GetScreenImportance(atlas_lights[i]);
+		tile_sizes.push_back(static_cast<unsigned int>(shadow_atlas_size*0.5f*sqrt(importance)));
+	}
+	shadow_atlas->pack(tile_sizes);
+
+	ShadowLightsBlock block;
+	float atlas_size = static_cast<float>(shadow_atlas->getSize());
+	for(unsigned int i = 0; i < atlas_lights.size(); i++){
+		glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5-0.01f));
+		bias = glm::scale(bias, glm::vec3(0.5f, 0.5f, 0.5f*1.01f));
+		block.shadow_matrices[i] = bias*atlas_lights[i].projection*atlas_lights[i].view;
+		block.positions[i] = glm::vec4(atlas_lights[i].position, 1.0f);
+		block.colors[i] = glm::vec4(atlas_lights[i].color, 1.0f);
+
+		const ShadowAtlas::Tile& tile = shadow_atlas->getTile(i);
+		block.tiles[i] = glm::vec4(tile.x, tile.y, tile.size, tile.size)/atlas_size;
+	}
+	block.count = static_cast<GLint>(atlas_lights.size());
+
+	shadow_lights_ubo->bind();
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowLightsBlock), &block);
+	shadow_lights_ubo->unbind();
+}
+
 void GameManager::SetBackgroundToCube(){
 	current_environment = PLAIN_CUBE_ROOM;
 }
@@ -794,4 +2172,36 @@ void GameManager::SetBackgroundToOpenRoom(){
 	current_environment = OPEN_HALFROOM;
 }
 
+void GameManager::UsePCFShadows(){
+	if(current_shadow_technique != PCF_SHADOWS){
+		current_shadow_technique = PCF_SHADOWS;
+		current_shadow_program = light_pov_program;
+		shadowmode_radiobtn->SetActive(0);
+	}
+}
+
+void GameManager::UseVarianceShadows(){
+	if(current_shadow_technique != VARIANCE_SHADOWS){
+		current_shadow_technique = VARIANCE_SHADOWS;
+		current_shadow_program = vsm_moments_program;
+		shadowmode_radiobtn->SetActive(1);
+	}
+}
 
+void GameManager::UseCubeShadows(){
+	if(current_shadow_technique != CUBE_SHADOWS){
+		current_shadow_technique = CUBE_SHADOWS;
+		current_shadow_program = cube_shadow_program;
+		shadowmode_radiobtn->SetActive(2);
+	}
+}
+
+void GameManager::UseAtlasShadows(){
+	if(current_shadow_technique != ATLAS_SHADOWS){
+		current_shadow_technique = ATLAS_SHADOWS;
+		current_shadow_program = light_pov_program;
+		shadowmode_radiobtn->SetActive(3);
+	}
+}
+
+
@@ -0,0 +1,165 @@
+#include "HeadlessContext.h"
+#include "GLUtils/GLUtils.hpp"
+#include "GameException.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+HeadlessContext::HeadlessContext(unsigned int width, unsigned int height) {
+	this->width = width;
+	this->height = height;
+
+	createContext();
+
+	// glewExperimental is required in openGL 3.3
+	// to create forward compatible contexts
+	glewExperimental = GL_TRUE;
+	GLenum glewErr = glewInit();
+	if (glewErr != GLEW_OK) {
+		std::stringstream err;
+		err << "Error initializing GLEW: " << glewGetErrorString(glewErr);
+		THROW_EXCEPTION(err.str());
+	}
+	//Swallow the error glewInit generates on core contexts
+	glGetError();
+
+	createFramebuffer();
+
+	std::string threads = getRasterizerThreads();
+	std::cout << "Headless " << width << "x" << height << " rendering through " << backend_name
+			  << " on " << glGetString(GL_RENDERER) << ", "
+			  << (threads.empty() ? "default" : threads) << " llvmpipe threads" << std::endl;
+}
+
+HeadlessContext::~HeadlessContext() {
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &color);
+	glDeleteRenderbuffers(1, &depth);
+	GLUtils::screenFramebuffer() = 0;
+
+#ifdef PG612_HEADLESS_EGL
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+#elif defined(PG612_HEADLESS_OSMESA)
+	OSMesaDestroyContext(context);
+#else
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(window);
+#endif
+}
+
+void HeadlessContext::setRasterizerThreads(unsigned int threads) {
+	std::stringstream value;
+	value << threads;
+#ifdef _WIN32
+	_putenv_s("LP_NUM_THREADS", value.str().c_str());
+#else
+	setenv("LP_NUM_THREADS", value.str().c_str(), 1);
+#endif
+}
+
+std::string HeadlessContext::getRasterizerThreads() {
+	const char* threads = getenv("LP_NUM_THREADS");
+	return threads != NULL ? threads : "";
+}
+
+void HeadlessContext::createContext() {
+#ifdef PG612_HEADLESS_EGL
+	backend_name = "surfaceless EGL";
+
+	//The Mesa surfaceless platform needs no display server, the default display may
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(getPlatformDisplay != NULL)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	else
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		THROW_EXCEPTION("eglInitialize failed");
+	if(!eglBindAPI(EGL_OPENGL_API))
+		THROW_EXCEPTION("eglBindAPI(EGL_OPENGL_API) failed");
+
+	//No surface type is required, the default would ask for window surfaces
+	const EGLint config_attribs[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	if(!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0)
+		THROW_EXCEPTION("eglChooseConfig found no OpenGL config");
+
+	const EGLint context_attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+									  EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+									  EGL_NONE};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+	if(context == EGL_NO_CONTEXT)
+		THROW_EXCEPTION("eglCreateContext failed to create an OpenGL 3.3 core context");
+
+	//EGL_KHR_surfaceless_context: current without any surface
+	if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		THROW_EXCEPTION("eglMakeCurrent without a surface failed");
+#elif defined(PG612_HEADLESS_OSMESA)
+	backend_name = "OSMesa";
+
+	const int attribs[] = {OSMESA_FORMAT, OSMESA_RGBA,
+						   OSMESA_DEPTH_BITS, 24,
+						   OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+						   OSMESA_CONTEXT_MAJOR_VERSION, 3,
+						   OSMESA_CONTEXT_MINOR_VERSION, 3,
+						   0};
+	context = OSMesaCreateContextAttribs(attribs, NULL);
+	if(context == NULL)
+		THROW_EXCEPTION("OSMesaCreateContextAttribs failed to create an OpenGL 3.3 core context");
+
+	osmesa_buffer.resize(width*height*4);
+	if(!OSMesaMakeCurrent(context, &osmesa_buffer[0], GL_UNSIGNED_BYTE, width, height))
+		THROW_EXCEPTION("OSMesaMakeCurrent failed");
+#else
+	backend_name = "a hidden SDL window";
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+	window = SDL_CreateWindow("NITH - PG612 Assignment 2", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if (!window) {
+		THROW_EXCEPTION("SDL_CreateWindow failed");
+	}
+	context = SDL_GL_CreateContext(window);
+	if (!context) {
+		THROW_EXCEPTION("SDL_GL_CreateContext failed");
+	}
+	//Frames are never swapped, but make sure nothing waits for vsync
+	SDL_GL_SetSwapInterval(0);
+#endif
+}
+
+void HeadlessContext::createFramebuffer() {
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	//Check for completeness
+	CHECK_GL_FBO_COMPLETENESS();
+
+	//Every pass that would end on the window framebuffer now ends here
+	GLUtils::screenFramebuffer() = fbo;
+	CHECK_GL_ERRORS();
+}
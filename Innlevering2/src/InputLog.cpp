@@ -0,0 +1,135 @@
+#include "InputLog.h"
+#include "GameException.h"
+
+#include <cstring>
+
+namespace {
+	const char log_magic[4] = {'P', 'G', 'I', 'N'};
+	const unsigned int log_version = 1;
+}
+
+InputRecorder::InputRecorder(const std::string& filename, unsigned int seed, unsigned int width, unsigned int height) {
+	file.open(filename.c_str(), std::ios::binary);
+	if(!file.good())
+		THROW_EXCEPTION("Could not open " + filename + " for recording");
+
+	file.write(log_magic, sizeof(log_magic));
+	unsigned int header[4] = {log_version, seed, width, height};
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	start_ms = SDL_GetTicks();
+}
+
+void InputRecorder::record(unsigned int frame, const SDL_Event& event) {
+	InputRecord record;
+	record.frame = frame;
+	record.time_ms = event.common.timestamp - start_ms;
+	record.type = event.type;
+	record.a = record.b = record.c = 0;
+
+	switch(event.type) {
+	case SDL_MOUSEMOTION:
+		record.a = event.motion.x;
+		record.b = event.motion.y;
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		record.a = event.button.x;
+		record.b = event.button.y;
+		record.c = event.button.button;
+		break;
+	case SDL_MOUSEWHEEL:
+		record.a = event.wheel.x;
+		record.b = event.wheel.y;
+		break;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		record.a = event.key.keysym.sym;
+		record.b = event.key.keysym.mod;
+		break;
+	case SDL_QUIT:
+		break;
+	default:
+		//Window and other events do not change what is rendered
+		return;
+	}
+	write(record);
+}
+
+void InputRecorder::endFrame(unsigned int frame, float delta_time) {
+	InputRecord record;
+	record.frame = frame;
+	record.time_ms = SDL_GetTicks() - start_ms;
+	record.type = InputRecord::FRAME_END;
+	std::memcpy(&record.a, &delta_time, sizeof(float));
+	record.b = record.c = 0;
+	write(record);
+}
+
+void InputRecorder::write(const InputRecord& record) {
+	file.write(reinterpret_cast<const char*>(&record), sizeof(InputRecord));
+}
+
+InputReplay::InputReplay(const std::string& filename) {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if(!file.good())
+		THROW_EXCEPTION("Could not open input log " + filename);
+
+	char magic[4];
+	unsigned int header[4];
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if(!file.good() || std::memcmp(magic, log_magic, sizeof(magic)) != 0 || header[0] != log_version)
+		THROW_EXCEPTION(filename + " is not a version 1 input log");
+	seed = header[1];
+	width = header[2];
+	height = header[3];
+
+	InputRecord record;
+	frames = 0;
+	while(file.read(reinterpret_cast<char*>(&record), sizeof(InputRecord))) {
+		records.push_back(record);
+		if(record.type == InputRecord::FRAME_END)
+			frames++;
+	}
+	next = 0;
+}
+
+bool InputReplay::nextFrame(std::vector<SDL_Event>& events, float& delta_time) {
+	events.clear();
+	while(next < records.size()) {
+		const InputRecord& record = records.at(next++);
+		if(record.type == InputRecord::FRAME_END) {
+			std::memcpy(&delta_time, &record.a, sizeof(float));
+			return true;
+		}
+
+		SDL_Event event;
+		std::memset(&event, 0, sizeof(SDL_Event));
+		event.type = record.type;
+		event.common.timestamp = record.time_ms;
+		switch(record.type) {
+		case SDL_MOUSEMOTION:
+			event.motion.x = record.a;
+			event.motion.y = record.b;
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+			event.button.x = record.a;
+			event.button.y = record.b;
+			event.button.button = static_cast<Uint8>(record.c);
+			break;
+		case SDL_MOUSEWHEEL:
+			event.wheel.x = record.a;
+			event.wheel.y = record.b;
+			break;
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			event.key.keysym.sym = static_cast<SDL_Keycode>(record.a);
+			event.key.keysym.mod = static_cast<Uint16>(record.b);
+			break;
+		}
+		events.push_back(event);
+	}
+	//A frame cut short by the end of the log is not replayed
+	return false;
+}
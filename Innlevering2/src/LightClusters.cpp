@@ -0,0 +1,243 @@
+#include "LightClusters.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHTCLUSTERS_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+
+LightClusters::LightClusters(unsigned int dim_x, unsigned int dim_y, unsigned int dim_z, unsigned int max_lights_per_cluster) {
+	this->dim_x = dim_x;
+	this->dim_y = dim_y;
+	this->dim_z = dim_z;
+	this->max_lights_per_cluster = max_lights_per_cluster;
+	fovy = aspect = near_clip = far_clip = 0.0f;
+
+	unsigned int clusters = dim_x*dim_y*dim_z;
+	cluster_counts.resize(clusters);
+	cluster_lights.resize(clusters*max_lights_per_cluster);
+	grid.resize(clusters*2);
+
+	const GLenum formats[3] = {GL_RG32UI, GL_R32UI, GL_RGBA32F};
+	glGenBuffers(3, &buffers[0]);
+	glGenTextures(3, &textures[0]);
+	for(int i = 0; i < 3; i++) {
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	GLUtils::labelObject(GL_TEXTURE, textures[0], "cluster grid");
+	GLUtils::labelObject(GL_TEXTURE, textures[1], "cluster light indices");
+	GLUtils::labelObject(GL_TEXTURE, textures[2], "point lights");
+	CHECK_GL_ERRORS();
+
+	//Starting threads costs tens of microseconds each, so they are started once
+	work_generation = 0;
+	work_pending = 0;
+	work_lights = NULL;
+	work_stopping = false;
+	thread_count = std::min(std::max(std::thread::hardware_concurrency(), 1u), dim_z);
+	for(unsigned int t = 1; t < thread_count; t++)
+		workers.push_back(std::thread(&LightClusters::workerLoop, this, t));
+}
+
+LightClusters::~LightClusters() {
+	{
+		std::lock_guard<std::mutex> lock(work_mutex);
+		work_stopping = true;
+	}
+	work_ready.notify_all();
+	for(unsigned int t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	glDeleteTextures(3, &textures[0]);
+	glDeleteBuffers(3, &buffers[0]);
+}
+
+void LightClusters::setProjection(float fovy, float aspect, float near_clip, float far_clip) {
+	if(fovy == this->fovy && aspect == this->aspect && near_clip == this->near_clip && far_clip == this->far_clip)
+		return;
+
+	this->fovy = fovy;
+	this->aspect = aspect;
+	this->near_clip = near_clip;
+	this->far_clip = far_clip;
+	computeFroxelBounds();
+}
+
+void LightClusters::computeFroxelBounds() {
+	unsigned int clusters = dim_x*dim_y*dim_z;
+	min_x.resize(clusters); min_y.resize(clusters); min_z.resize(clusters);
+	max_x.resize(clusters); max_y.resize(clusters); max_z.resize(clusters);
+
+	float tan_y = tan(glm::radians(fovy*0.5f));
+	float tan_x = tan_y*aspect;
+
+	for(unsigned int z = 0; z < dim_z; z++) {
+		float depth_near = near_clip*pow(far_clip/near_clip, z/(float) dim_z);
+		float depth_far = near_clip*pow(far_clip/near_clip, (z+1)/(float) dim_z);
+
+		for(unsigned int y = 0; y < dim_y; y++) {
+			float ndc_y0 = 2.0f*y/dim_y - 1.0f;
+			float ndc_y1 = 2.0f*(y+1)/dim_y - 1.0f;
+
+			for(unsigned int x = 0; x < dim_x; x++) {
+				float ndc_x0 = 2.0f*x/dim_x - 1.0f;
+				float ndc_x1 = 2.0f*(x+1)/dim_x - 1.0f;
+
+				//The tile edges are planes through the eye, so the extremes
+				//are at either the near or the far depth of the slice
+				unsigned int i = x + dim_x*(y + dim_y*z);
+				min_x[i] = std::min(ndc_x0*tan_x*depth_near, ndc_x0*tan_x*depth_far);
+				max_x[i] = std::max(ndc_x1*tan_x*depth_near, ndc_x1*tan_x*depth_far);
+				min_y[i] = std::min(ndc_y0*tan_y*depth_near, ndc_y0*tan_y*depth_far);
+				max_y[i] = std::max(ndc_y1*tan_y*depth_near, ndc_y1*tan_y*depth_far);
+				min_z[i] = -depth_far;
+				max_z[i] = -depth_near;
+			}
+		}
+	}
+}
+
+void LightClusters::binSlices(unsigned int first_slice, unsigned int last_slice, const std::vector<glm::vec4>& view_lights) {
+	PROFILE_FUNCTION();
+	float slices_per_log_depth = getSlicesPerLogDepth();
+
+	for(unsigned int light = 0; light < view_lights.size(); light++) {
+		const glm::vec4& sphere = view_lights[light];
+		float depth_min = -sphere.z - sphere.w;
+		float depth_max = -sphere.z + sphere.w;
+		if(depth_max < near_clip || depth_min > far_clip)
+			continue;
+
+		//Only the slices the depth range of the sphere overlaps are tested
+		int slice_min = (depth_min <= near_clip) ? 0 : static_cast<int>(log(depth_min/near_clip)*slices_per_log_depth);
+		int slice_max = static_cast<int>(log(depth_max/near_clip)*slices_per_log_depth);
+		slice_min = std::max(slice_min, static_cast<int>(first_slice));
+		slice_max = std::min(slice_max, static_cast<int>(last_slice)-1);
+
+		for(int z = slice_min; z <= slice_max; z++) {
+			for(unsigned int y = 0; y < dim_y; y++) {
+				unsigned int row = dim_x*(y + dim_y*z);
+				unsigned int x = 0;
+#ifdef LIGHTCLUSTERS_USE_SSE
+				//Sphere against four froxel boxes at a time
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 cx = _mm_set1_ps(sphere.x);
+				const __m128 cy = _mm_set1_ps(sphere.y);
+				const __m128 cz = _mm_set1_ps(sphere.z);
+				const __m128 r2 = _mm_set1_ps(sphere.w*sphere.w);
+				for(; x+4 <= dim_x; x += 4) {
+					unsigned int i = row + x;
+					__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_x[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&max_x[i]))), zero);
+					__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_y[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&max_y[i]))), zero);
+					__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_z[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&max_z[i]))), zero);
+					__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+
+					for(unsigned int j = 0; mask != 0; j++, mask >>= 1) {
+						unsigned int& count = cluster_counts[i+j];
+						if((mask & 1) && count < max_lights_per_cluster)
+							cluster_lights[(i+j)*max_lights_per_cluster + count++] = light;
+					}
+				}
+#endif
+				for(; x < dim_x; x++) {
+					unsigned int i = row + x;
+					float dx = std::max(std::max(min_x[i] - sphere.x, sphere.x - max_x[i]), 0.0f);
+					float dy = std::max(std::max(min_y[i] - sphere.y, sphere.y - max_y[i]), 0.0f);
+					float dz = std::max(std::max(min_z[i] - sphere.z, sphere.z - max_z[i]), 0.0f);
+					unsigned int& count = cluster_counts[i];
+					if(dx*dx + dy*dy + dz*dz <= sphere.w*sphere.w && count < max_lights_per_cluster)
+						cluster_lights[i*max_lights_per_cluster + count++] = light;
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::workerLoop(unsigned int share) {
+	unsigned int generation = 0;
+	for(;;) {
+		const std::vector<glm::vec4>* view_lights;
+		{
+			std::unique_lock<std::mutex> lock(work_mutex);
+			while(!work_stopping && work_generation == generation)
+				work_ready.wait(lock);
+			if(work_stopping)
+				return;
+			generation = work_generation;
+			view_lights = work_lights;
+		}
+
+		binSlices(dim_z*share/thread_count, dim_z*(share+1)/thread_count, *view_lights);
+
+		std::lock_guard<std::mutex> lock(work_mutex);
+		if(--work_pending == 0)
+			work_done.notify_one();
+	}
+}
+
+void LightClusters::update(const glm::mat4& view_matrix, const std::vector<PointLight>& lights) {
+	PROFILE_FUNCTION();
+	std::vector<glm::vec4> view_lights(lights.size());
+	light_data.resize(std::max<size_t>(lights.size()*2, 1));
+	for(unsigned int i = 0; i < lights.size(); i++) {
+		view_lights[i] = glm::vec4(glm::vec3(view_matrix*glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+		light_data[2*i] = glm::vec4(lights[i].position, lights[i].radius);
+		light_data[2*i+1] = glm::vec4(lights[i].color, 1.0f);
+	}
+
+	std::fill(cluster_counts.begin(), cluster_counts.end(), 0);
+
+	{
+		std::lock_guard<std::mutex> lock(work_mutex);
+		work_lights = &view_lights;
+		work_pending = workers.size();
+		work_generation++;
+	}
+	work_ready.notify_all();
+	binSlices(0, dim_z/thread_count, view_lights);
+	{
+		std::unique_lock<std::mutex> lock(work_mutex);
+		while(work_pending > 0)
+			work_done.wait(lock);
+	}
+
+	//Compact the fixed size slots into one index list
+	light_indices.clear();
+	for(unsigned int i = 0; i < cluster_counts.size(); i++) {
+		grid[2*i] = light_indices.size();
+		grid[2*i+1] = cluster_counts[i];
+		light_indices.insert(light_indices.end(), cluster_lights.begin() + i*max_lights_per_cluster,
+							 cluster_lights.begin() + i*max_lights_per_cluster + cluster_counts[i]);
+	}
+	if(light_indices.empty())
+		light_indices.push_back(0);
+
+	PROFILE_SCOPE("LightClusters upload");
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, grid.size()*sizeof(unsigned int), &grid[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, light_indices.size()*sizeof(unsigned int), &light_indices[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[2]);
+	glBufferData(GL_TEXTURE_BUFFER, light_data.size()*sizeof(glm::vec4), &light_data[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	CHECK_GL_ERRORS();
+}
+
+void LightClusters::bind(unsigned int first_unit) {
+	for(int i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE0 + first_unit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
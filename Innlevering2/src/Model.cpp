@@ -1,9 +1,11 @@
 #include "Model.h"
+#include "Profiler.h"
 
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
 
 Model::Model(std::string filename, bool invert) {
+	PROFILE_FUNCTION();
 	std::vector<Vertex> vertex_data;
 	std::vector<unsigned int> indices_data;
 
@@ -39,6 +41,19 @@ Model::Model(std::string filename, bool invert) {
 	{
 		InterleavedVBO.reset(new GLUtils::BO<GL_ARRAY_BUFFER>(vertex_data.data(), vertex_data.size()*sizeof(Vertex)));
 		indices.reset(new GLUtils::BO<GL_ELEMENT_ARRAY_BUFFER>(indices_data.data(), indices_data.size() * sizeof(unsigned int)));
+
+		//Every triangle gets its own three vertices, so a shader can tell the corners apart by gl_VertexID
+		std::vector<Vertex> deindexed_data;
+		deindexed_data.reserve(indices_data.size());
+		for(unsigned int i = 0; i < indices_data.size(); i++)
+			deindexed_data.push_back(vertex_data.at(indices_data.at(i)));
+		DeindexedVBO.reset(new GLUtils::BO<GL_ARRAY_BUFFER>(deindexed_data.data(), deindexed_data.size()*sizeof(Vertex)));
+
+		std::vector<glm::vec3> positions;
+		positions.reserve(vertex_data.size());
+		for(unsigned int i = 0; i < vertex_data.size(); i++)
+			positions.push_back(vertex_data.at(i).vertex);
+		feature_edges.reset(new FeatureEdges(positions, indices_data));
 
 		stride = sizeof(Vertex);
 		verticeOffset = NULL;
@@ -0,0 +1,243 @@
+#include "PassQueries.h"
+#include "GameException.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace {
+	const GLenum statistics_targets[] = {
+		GL_VERTEX_SHADER_INVOCATIONS_ARB,
+		GL_PRIMITIVES_SUBMITTED_ARB,
+		GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+	};
+}
+
+PassQueries::PassQueries(unsigned int latency) {
+	frames.resize(std::max(latency, 1u));
+	for(unsigned int i = 0; i < frames.size(); i++) {
+		frames.at(i).used = 0;
+		frames.at(i).frame = 0;
+		frames.at(i).pending = false;
+	}
+	current = -1;
+	next_frame = 0;
+	std::fill(cpu_ms, cpu_ms + PASS_COUNT, 0.0);
+	interval_begin_ns = 0;
+	pipeline_statistics = GLUtils::hasExtension("GL_ARB_pipeline_statistics_query");
+
+	GLint64 gpu_now = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	gpu_to_steady_ns = profiler::now() - gpu_now;
+
+	averaged_frames = 0;
+	for(unsigned int i = 0; i < PASS_COUNT; i++) {
+		average.measured[i] = false;
+		average.gpu_ms[i] = 0.0;
+		average.vertices[i] = average.primitives[i] = average.fragments[i] = 0;
+	}
+}
+
+PassQueries::~PassQueries() {
+	for(unsigned int i = 0; i < frames.size(); i++) {
+		std::vector<Interval>& intervals = frames.at(i).intervals;
+		for(unsigned int j = 0; j < intervals.size(); j++) {
+			glDeleteQueries(2, intervals.at(j).timestamps);
+			glDeleteQueries(statistics_count, intervals.at(j).statistics);
+		}
+	}
+}
+
+void PassQueries::beginFrame() {
+	if(current >= 0 && frames.at(current).used > 0)
+		frames.at(current).pending = true;
+	readBack(false);
+
+	//A frame not read back keeps its queries, and the next frame gets a free
+	//set, or a new one if the GPU is more than latency frames behind
+	current = -1;
+	for(unsigned int i = 0; i < frames.size() && current < 0; i++) {
+		if(!frames.at(i).pending)
+			current = i;
+	}
+	if(current < 0) {
+		FrameQueries queries;
+		queries.pending = false;
+		frames.push_back(queries);
+		current = static_cast<int>(frames.size()) - 1;
+	}
+	frames.at(current).used = 0;
+	frames.at(current).frame = next_frame++;
+	active.clear();
+	std::fill(cpu_ms, cpu_ms + PASS_COUNT, 0.0);
+}
+
+void PassQueries::begin(Passes pass) {
+	if(current < 0)
+		return;
+	if(!active.empty())
+		closeInterval();
+	active.push_back(pass);
+	openInterval(pass);
+}
+
+void PassQueries::end(Passes pass) {
+	if(current < 0)
+		return;
+	if(active.empty() || active.back() != pass)
+		THROW_EXCEPTION(std::string("Ending ") + passName(pass) + " pass that is not the innermost one begun");
+	closeInterval();
+	active.pop_back();
+	if(!active.empty())
+		openInterval(active.back());
+}
+
+void PassQueries::openInterval(Passes pass) {
+	FrameQueries& queries = frames.at(current);
+	if(queries.used == queries.intervals.size()) {
+		Interval interval;
+		glGenQueries(2, interval.timestamps);
+		glGenQueries(statistics_count, interval.statistics);
+		queries.intervals.push_back(interval);
+	}
+
+	Interval& interval = queries.intervals.at(queries.used++);
+	interval.pass = pass;
+	interval_begin_ns = profiler::now();
+	GLUtils::setGLCounterSlot(counterSlot(pass));
+	glQueryCounter(interval.timestamps[0], GL_TIMESTAMP);
+	if(pipeline_statistics) {
+		for(unsigned int i = 0; i < statistics_count; i++)
+			glBeginQuery(statistics_targets[i], interval.statistics[i]);
+	}
+}
+
+void PassQueries::closeInterval() {
+	FrameQueries& queries = frames.at(current);
+	Interval& interval = queries.intervals.at(queries.used-1);
+	if(pipeline_statistics) {
+		for(unsigned int i = 0; i < statistics_count; i++)
+			glEndQuery(statistics_targets[i]);
+	}
+	glQueryCounter(interval.timestamps[1], GL_TIMESTAMP);
+	cpu_ms[interval.pass] += (profiler::now() - interval_begin_ns)/1.0e6;
+	GLUtils::setGLCounterSlot(0);
+}
+
+void PassQueries::flush() {
+	if(current >= 0 && frames.at(current).used > 0) {
+		frames.at(current).pending = true;
+		current = -1;
+	}
+	readBack(true);
+}
+
+void PassQueries::readBack(bool wait) {
+	while(true) {
+		FrameQueries* oldest = NULL;
+		for(unsigned int i = 0; i < frames.size(); i++) {
+			if(frames.at(i).pending && (oldest == NULL || frames.at(i).frame < oldest->frame))
+				oldest = &frames.at(i);
+		}
+		if(oldest == NULL || (!wait && !isDone(*oldest)))
+			return;
+		read(*oldest);
+	}
+}
+
+bool PassQueries::isDone(const FrameQueries& queries) {
+	//The last timestamp is written after everything before it is done
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(queries.intervals.at(queries.used-1).timestamps[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(available && pipeline_statistics)
+		glGetQueryObjectuiv(queries.intervals.at(queries.used-1).statistics[statistics_count-1], GL_QUERY_RESULT_AVAILABLE, &available);
+	return available == GL_TRUE;
+}
+
+void PassQueries::read(FrameQueries& queries) {
+	FrameStats stats;
+	stats.frame = queries.frame;
+	for(unsigned int i = 0; i < PASS_COUNT; i++) {
+		stats.measured[i] = false;
+		stats.gpu_ms[i] = 0.0;
+		stats.vertices[i] = stats.primitives[i] = stats.fragments[i] = 0;
+	}
+
+	for(unsigned int i = 0; i < queries.used; i++) {
+		const Interval& interval = queries.intervals.at(i);
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(interval.timestamps[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(interval.timestamps[1], GL_QUERY_RESULT, &end);
+		stats.measured[interval.pass] = true;
+		stats.gpu_ms[interval.pass] += (end - begin)/1.0e6;
+		if(profiler::isEnabled())
+			profiler::recordGPU(passName(interval.pass), begin + gpu_to_steady_ns, end + gpu_to_steady_ns);
+		if(pipeline_statistics) {
+			GLuint64 counts[statistics_count];
+			for(unsigned int j = 0; j < statistics_count; j++)
+				glGetQueryObjectui64v(interval.statistics[j], GL_QUERY_RESULT, &counts[j]);
+			stats.vertices[interval.pass] += counts[0];
+			stats.primitives[interval.pass] += counts[1];
+			stats.fragments[interval.pass] += counts[2];
+		}
+	}
+	queries.pending = false;
+	completed.push_back(stats);
+	if(completed.size() > max_completed)
+		completed.pop_front();
+
+	//The mean of the first frames, then a moving average following the current view
+	float weight = averaged_frames < 100 ? 1.0f/(averaged_frames+1) : 0.01f;
+	for(unsigned int i = 0; i < PASS_COUNT; i++) {
+		if(!stats.measured[i])
+			continue;
+		average.measured[i] = true;
+		average.gpu_ms[i] += weight*(stats.gpu_ms[i] - average.gpu_ms[i]);
+		average.vertices[i] = static_cast<GLuint64>(average.vertices[i] + weight*(static_cast<double>(stats.vertices[i]) - average.vertices[i]));
+		average.primitives[i] = static_cast<GLuint64>(average.primitives[i] + weight*(static_cast<double>(stats.primitives[i]) - average.primitives[i]));
+		average.fragments[i] = static_cast<GLuint64>(average.fragments[i] + weight*(static_cast<double>(stats.fragments[i]) - average.fragments[i]));
+	}
+	averaged_frames++;
+}
+
+std::vector<PassQueries::FrameStats> PassQueries::takeCompleted() {
+	std::vector<FrameStats> result(completed.begin(), completed.end());
+	completed.clear();
+	return result;
+}
+
+bool PassQueries::popCompleted(FrameStats& stats) {
+	if(completed.empty())
+		return false;
+	stats = completed.front();
+	completed.pop_front();
+	return true;
+}
+
+void PassQueries::print(std::ostream& out) {
+	out << "GPU time per pass";
+	if(pipeline_statistics)
+		out << " (vertex shader invocations / primitives / fragment shader invocations)";
+	out << ":" << std::endl;
+	for(unsigned int i = 0; i < PASS_COUNT; i++) {
+		out << "  " << passName(static_cast<Passes>(i)) << ": ";
+		if(!average.measured[i]) {
+			out << "not measured" << std::endl;
+			continue;
+		}
+		out << average.gpu_ms[i] << " ms";
+		if(pipeline_statistics)
+			out << " (" << average.vertices[i] << " / " << average.primitives[i] << " / " << average.fragments[i] << ")";
+		out << std::endl;
+	}
+}
+
+const char* PassQueries::passName(Passes pass) {
+	switch(pass) {
+	case SHADOW_PASS: return "shadow";
+	case SKYBOX: return "skybox";
+	case COLOR_PASS: return "color";
+	case DEPTH_DUMP: return "depth_dump";
+	case GUI: return "gui";
+	default: return "unknown pass";
+	}
+}
@@ -0,0 +1,320 @@
+#include "PerformanceHUD.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#ifndef GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+namespace {
+	const char font_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:/%-()_";
+	const unsigned int font_char_count = sizeof(font_chars) - 1;
+
+	/**
+	* 5x7 pixel glyphs of font_chars, a row per byte from the top, bit 4 leftmost
+	*/
+	const unsigned char font_glyphs[font_char_count][7] = {
+		{0x0E,0x11,0x13,0x15,0x19,0x11,0x0E}, {0x04,0x0C,0x04,0x04,0x04,0x04,0x0E},
+		{0x0E,0x11,0x01,0x02,0x04,0x08,0x1F}, {0x1F,0x02,0x04,0x02,0x01,0x11,0x0E},
+		{0x02,0x06,0x0A,0x12,0x1F,0x02,0x02}, {0x1F,0x10,0x1E,0x01,0x01,0x11,0x0E},
+		{0x06,0x08,0x10,0x1E,0x11,0x11,0x0E}, {0x1F,0x01,0x02,0x04,0x08,0x08,0x08},
+		{0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E}, {0x0E,0x11,0x11,0x0F,0x01,0x02,0x0C},
+		{0x0E,0x11,0x11,0x11,0x1F,0x11,0x11}, {0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E},
+		{0x0E,0x11,0x10,0x10,0x10,0x11,0x0E}, {0x1C,0x12,0x11,0x11,0x11,0x12,0x1C},
+		{0x1F,0x10,0x10,0x1E,0x10,0x10,0x1F}, {0x1F,0x10,0x10,0x1E,0x10,0x10,0x10},
+		{0x0E,0x11,0x10,0x17,0x11,0x11,0x0F}, {0x11,0x11,0x11,0x1F,0x11,0x11,0x11},
+		{0x0E,0x04,0x04,0x04,0x04,0x04,0x0E}, {0x07,0x02,0x02,0x02,0x02,0x12,0x0C},
+		{0x11,0x12,0x14,0x18,0x14,0x12,0x11}, {0x10,0x10,0x10,0x10,0x10,0x10,0x1F},
+		{0x11,0x1B,0x15,0x15,0x11,0x11,0x11}, {0x11,0x11,0x19,0x15,0x13,0x11,0x11},
+		{0x0E,0x11,0x11,0x11,0x11,0x11,0x0E}, {0x1E,0x11,0x11,0x1E,0x10,0x10,0x10},
+		{0x0E,0x11,0x11,0x11,0x15,0x12,0x0D}, {0x1E,0x11,0x11,0x1E,0x14,0x12,0x11},
+		{0x0F,0x10,0x10,0x0E,0x01,0x01,0x1E}, {0x1F,0x04,0x04,0x04,0x04,0x04,0x04},
+		{0x11,0x11,0x11,0x11,0x11,0x11,0x0E}, {0x11,0x11,0x11,0x11,0x11,0x0A,0x04},
+		{0x11,0x11,0x11,0x15,0x15,0x15,0x0A}, {0x11,0x11,0x0A,0x04,0x0A,0x11,0x11},
+		{0x11,0x11,0x11,0x0A,0x04,0x04,0x04}, {0x1F,0x01,0x02,0x04,0x08,0x10,0x1F},
+		{0x00,0x00,0x00,0x00,0x00,0x0C,0x0C}, {0x00,0x0C,0x0C,0x00,0x0C,0x0C,0x00},
+		{0x00,0x01,0x02,0x04,0x08,0x10,0x00}, {0x18,0x19,0x02,0x04,0x08,0x13,0x03},
+		{0x00,0x00,0x00,0x1F,0x00,0x00,0x00}, {0x02,0x04,0x08,0x08,0x08,0x04,0x02},
+		{0x08,0x04,0x02,0x02,0x02,0x04,0x08}, {0x00,0x00,0x00,0x00,0x00,0x00,0x1F}
+	};
+
+	/**
+	* Returns the font cell of the param character, 0 (solid) for a space
+	* or a character not in the font. Lower case is drawn as upper case.
+	*/
+	unsigned int fontCell(char c) {
+		c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+		const char* found = c != '\0' ? strchr(font_chars, c) : NULL;
+		return found ? static_cast<unsigned int>(found - font_chars) + 1 : 0;
+	}
+
+	const float budget_ms = 1000.0f/60.0f; //< Frame time of 60 fps, marked in the graphs
+	const float graph_max_ms = 2.0f*budget_ms;
+	const float pass_bar_max_ms = 10.0f;
+
+	const glm::vec4 background_color(0.0f, 0.0f, 0.0f, 0.6f);
+	const glm::vec4 text_color(1.0f);
+	const glm::vec4 cpu_color(1.0f, 0.6f, 0.2f, 1.0f);
+	const glm::vec4 gpu_color(0.3f, 0.6f, 1.0f, 1.0f);
+}
+
+PerformanceHUD::PerformanceHUD(std::shared_ptr<GLUtils::Program> gui_program, unsigned int history) {
+	this->gui_program = gui_program;
+	cpu_ms.resize(std::max(history, 1u), 0.0f);
+	gpu_ms.resize(std::max(history, 1u), 0.0f);
+	next_cpu = next_gpu = 0;
+	std::fill(pass_cpu_ms, pass_cpu_ms + PassQueries::PASS_COUNT, 0.0);
+	std::fill(pass_gpu_ms, pass_gpu_ms + PassQueries::PASS_COUNT, 0.0);
+	std::fill(pass_measured, pass_measured + PassQueries::PASS_COUNT, false);
+	instances_drawn = instances_culled = 0;
+	vertices.reserve(6*max_quads);
+
+	//Cell 0 is solid for the rectangles, followed by a cell per glyph
+	font_texture_width = (font_char_count + 1)*glyph_width;
+	std::vector<GLubyte> texels(font_texture_width*glyph_height*4, 255);
+	for(unsigned int i = 0; i < font_char_count; i++) {
+		for(unsigned int y = 0; y < glyph_height; y++) {
+			for(unsigned int x = 0; x < glyph_width; x++) {
+				//Row 0 of the texture is the bottom, and the glyph top is at row 7
+				bool set = y >= 1 && x < 5 && (font_glyphs[i][glyph_height-1-y] & (0x10 >> x)) != 0;
+				texels.at(4*(y*font_texture_width + (i+1)*glyph_width + x) + 3) = set ? 255 : 0;
+			}
+		}
+	}
+	glGenTextures(1, &font_texture);
+	glBindTexture(GL_TEXTURE_2D, font_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, font_texture_width, glyph_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GLUtils::labelObject(GL_TEXTURE, font_texture, "performance HUD font");
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	vertex_buffer.reset(new GLUtils::BO<GL_ARRAY_BUFFER>(NULL, 6*max_quads*sizeof(Vertex), GL_STREAM_DRAW));
+	vertex_buffer->bind();
+	gui_program->setAttributePointer("in_Position", 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, x));
+	gui_program->setAttributePointer("in_Texcoord", 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, u));
+	gui_program->setAttributePointer("in_Color", 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, color));
+	glBindVertexArray(0);
+	vertex_buffer->unbind();
+
+	if(GLUtils::hasExtension("GL_NVX_gpu_memory_info"))
+		gpu_memory_info = GPU_MEMORY_NVX;
+	else if(GLUtils::hasExtension("GL_ATI_meminfo"))
+		gpu_memory_info = GPU_MEMORY_ATI;
+	else
+		gpu_memory_info = GPU_MEMORY_NONE;
+	gpu_memory_total_kb = gpu_memory_free_kb = 0;
+	frames_since_memory_query = 0;
+	updateGPUMemory();
+	CHECK_GL_ERRORS();
+}
+
+PerformanceHUD::~PerformanceHUD() {
+	glDeleteVertexArrays(1, &vao);
+	glDeleteTextures(1, &font_texture);
+}
+
+void PerformanceHUD::addFrame(double cpu_ms, const double pass_cpu_ms[PassQueries::PASS_COUNT]) {
+	this->cpu_ms.at(next_cpu) = static_cast<float>(cpu_ms);
+	next_cpu = (next_cpu + 1) % this->cpu_ms.size();
+	std::copy(pass_cpu_ms, pass_cpu_ms + PassQueries::PASS_COUNT, this->pass_cpu_ms);
+}
+
+void PerformanceHUD::addGPUFrame(const PassQueries::FrameStats& stats) {
+	double frame_ms = 0.0;
+	for(unsigned int i = 0; i < PassQueries::PASS_COUNT; i++) {
+		pass_measured[i] = stats.measured[i];
+		pass_gpu_ms[i] = stats.measured[i] ? stats.gpu_ms[i] : 0.0;
+		frame_ms += pass_gpu_ms[i];
+	}
+	gpu_ms.at(next_gpu) = static_cast<float>(frame_ms);
+	next_gpu = (next_gpu + 1) % gpu_ms.size();
+}
+
+void PerformanceHUD::updateGPUMemory() {
+	if(gpu_memory_info == GPU_MEMORY_NVX) {
+		GLint total = 0, available = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		gpu_memory_total_kb = total;
+		gpu_memory_free_kb = available;
+	}
+	else if(gpu_memory_info == GPU_MEMORY_ATI) {
+		GLint free_memory[4] = {0, 0, 0, 0};
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free_memory);
+		gpu_memory_free_kb = free_memory[0];
+	}
+	frames_since_memory_query = 0;
+}
+
+void PerformanceHUD::quad(float x, float y, float width, float height, float u0, float v0, float u1, float v1, const glm::vec4& color) {
+	if(vertices.size() + 6 > vertices.capacity())
+		return;
+
+	Vertex corners[4];
+	for(unsigned int i = 0; i < 4; i++) {
+		bool right = (i & 1) != 0;
+		bool top = (i & 2) != 0;
+		corners[i].x = right ? x + width : x;
+		corners[i].y = top ? y + height : y;
+		corners[i].u = right ? u1 : u0;
+		corners[i].v = top ? v1 : v0;
+		for(unsigned int j = 0; j < 4; j++)
+			corners[i].color[j] = static_cast<GLubyte>(glm::clamp(color[j], 0.0f, 1.0f)*255.0f + 0.5f);
+	}
+	const unsigned int order[6] = {0, 1, 3, 0, 3, 2};
+	for(unsigned int i = 0; i < 6; i++)
+		vertices.push_back(corners[order[i]]);
+}
+
+void PerformanceHUD::rect(float x, float y, float width, float height, const glm::vec4& color) {
+	//Any texcoord inside the solid cell 0
+	float u = 0.5f*glyph_width/font_texture_width;
+	quad(x, y, width, height, u, 0.5f, u, 0.5f, color);
+}
+
+void PerformanceHUD::text(float x, float y, const char* str, const glm::vec4& color) {
+	float cell_u = static_cast<float>(glyph_width)/font_texture_width;
+	for(; *str != '\0'; str++, x += glyph_width*text_scale) {
+		unsigned int cell = fontCell(*str);
+		if(cell == 0)
+			continue;
+		quad(x, y, static_cast<float>(glyph_width*text_scale), static_cast<float>(glyph_height*text_scale),
+			 cell*cell_u, 0.0f, (cell+1)*cell_u, 1.0f, color);
+	}
+}
+
+void PerformanceHUD::graph(float x, float y, float width, float height, const std::vector<float>& frame_ms, unsigned int next, const char* label) {
+	rect(x, y, width, height, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
+
+	//Oldest frame first, which is at the ring index of the next frame
+	float bar_width = width/frame_ms.size();
+	for(unsigned int i = 0; i < frame_ms.size(); i++) {
+		float ms = frame_ms.at((next + i) % frame_ms.size());
+		if(ms <= 0.0f)
+			continue;
+		glm::vec4 color = ms <= budget_ms ? glm::vec4(0.3f, 0.9f, 0.3f, 1.0f)
+						: ms <= graph_max_ms ? glm::vec4(1.0f, 0.9f, 0.2f, 1.0f)
+						: glm::vec4(1.0f, 0.2f, 0.2f, 1.0f);
+		rect(x + i*bar_width, y, bar_width, std::min(ms/graph_max_ms, 1.0f)*height, color);
+	}
+	rect(x, y + height*budget_ms/graph_max_ms, width, 1.0f, glm::vec4(1.0f, 1.0f, 1.0f, 0.5f));
+	text(x + 2.0f, y + height - glyph_height*text_scale - 2.0f, label, text_color);
+}
+
+void PerformanceHUD::draw(unsigned int window_height) {
+	PROFILE_FUNCTION();
+	if(++frames_since_memory_query >= 30)
+		updateGPUMemory();
+
+	const float line_height = static_cast<float>(glyph_height*text_scale + 2);
+	const float graph_height = 40.0f;
+	const float width = 300.0f;
+	const float height = (4 + PassQueries::PASS_COUNT)*line_height + 2.0f*(graph_height + 4.0f) + 10.0f;
+	const float left = 10.0f;
+	float y = window_height - 60.0f;
+
+	vertices.clear();
+	rect(left - 4.0f, y - height, width + 8.0f, height, background_color);
+
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(2);
+	float last_cpu_ms = cpu_ms.at((next_cpu + cpu_ms.size() - 1) % cpu_ms.size());
+	float last_gpu_ms = gpu_ms.at((next_gpu + gpu_ms.size() - 1) % gpu_ms.size());
+	y -= line_height;
+	line << "CPU " << std::setw(5) << last_cpu_ms << " MS";
+	text(left, y, line.str().c_str(), cpu_color);
+	line.str("");
+	line << "GPU " << std::setw(5) << last_gpu_ms << " MS";
+	text(left + 156.0f, y, line.str().c_str(), gpu_color);
+
+	y -= graph_height + 4.0f;
+	graph(left, y, width, graph_height, cpu_ms, next_cpu, "CPU");
+	y -= graph_height + 4.0f;
+	graph(left, y, width, graph_height, gpu_ms, next_gpu, "GPU");
+
+	//GPU time on top of the CPU time of each pass, the numbers are the GPU time
+	y -= 4.0f;
+	const float bar_left = left + 11.0f*glyph_width*text_scale;
+	const float bar_width = 90.0f;
+	for(unsigned int i = 0; i < PassQueries::PASS_COUNT; i++) {
+		y -= line_height;
+		PassQueries::Passes pass = static_cast<PassQueries::Passes>(i);
+		text(left, y, PassQueries::passName(pass), pass_measured[i] ? text_color : glm::vec4(0.6f));
+		float half = glyph_height*text_scale/2.0f;
+		rect(bar_left, y + half, std::min(static_cast<float>(pass_gpu_ms[i])/pass_bar_max_ms, 1.0f)*bar_width, half, gpu_color);
+		rect(bar_left, y, std::min(static_cast<float>(pass_cpu_ms[i])/pass_bar_max_ms, 1.0f)*bar_width, half, cpu_color);
+		line.str("");
+		line << std::setw(5) << pass_gpu_ms[i];
+		text(bar_left + bar_width + 4.0f, y, line.str().c_str(), text_color);
+	}
+
+	y -= line_height;
+	if(GLUtils::gl_counters_enabled) {
+		line.str("");
+		line << "DRAWS " << gl_counters.draw_calls << " TRIS " << gl_counters.triangles/1000 << "K";
+		text(left, y, line.str().c_str(), text_color);
+	}
+	else {
+		text(left, y, "DRAWS N/A", text_color);
+	}
+
+	y -= line_height;
+	line.str("");
+	line << "INSTANCES " << instances_drawn << " CULLED " << instances_culled;
+	text(left, y, line.str().c_str(), text_color);
+
+	y -= line_height;
+	line.str("");
+	if(gpu_memory_info == GPU_MEMORY_NVX)
+		line << "GPU MEM " << (gpu_memory_total_kb - gpu_memory_free_kb)/1024 << "/" << gpu_memory_total_kb/1024 << " MB";
+	else if(gpu_memory_info == GPU_MEMORY_ATI)
+		line << "GPU MEM FREE " << gpu_memory_free_kb/1024 << " MB";
+	else
+		line << "GPU MEM N/A";
+	text(left, y, line.str().c_str(), text_color);
+
+	if(vertices.empty())
+		return;
+
+	//In front of the GUI textures, which are at depth -5
+	glm::mat4 model_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f));
+	glUniformMatrix4fv(gui_program->getUniform("model_matrix"), 1, 0, glm::value_ptr(model_matrix));
+	glUniform1i(gui_program->getUniform("vertex_texcoords"), 1);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, font_texture);
+
+	//Orphaning the buffer, so the draw of the previous frame is not waited for
+	glBindVertexArray(vao);
+	vertex_buffer->bind();
+	glBufferData(GL_ARRAY_BUFFER, vertices.capacity()*sizeof(Vertex), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size()*sizeof(Vertex), &vertices[0]);
+
+	//The quads overlap at the same depth, so they are drawn in order
+	glDisable(GL_DEPTH_TEST);
+	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+	glEnable(GL_DEPTH_TEST);
+
+	vertex_buffer->unbind();
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUniform1i(gui_program->getUniform("vertex_texcoords"), 0);
+	CHECK_GL_ERRORS();
+}
@@ -0,0 +1,192 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace profiler {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+	const unsigned int buffer_capacity = 1 << 16; //< Samples kept per thread, about a minute of frames
+
+	struct Sample {
+		const char* name;
+		long long begin_ns, end_ns;
+	};
+
+	/**
+	* Ring buffer written by one thread at a time. Readers copy the samples
+	* below count, and drop those the writer may have overwritten meanwhile.
+	*/
+	struct Buffer {
+		Buffer(unsigned int id) : samples(buffer_capacity), count(0), in_use(false), id(id) {}
+
+		void push(const char* name, long long begin_ns, long long end_ns) {
+			unsigned int index = count.load(std::memory_order_relaxed);
+			Sample& sample = samples[index % buffer_capacity];
+			sample.name = name;
+			sample.begin_ns = begin_ns;
+			sample.end_ns = end_ns;
+			count.store(index+1, std::memory_order_release);
+		}
+
+		std::vector<Sample> samples;
+		std::atomic<unsigned int> count; //< Samples pushed in total
+		bool in_use;					 //< Owned by a running thread, guarded by the registry mutex
+		unsigned int id;				 //< Trace thread id
+	};
+
+	/**
+	* All buffers ever created. They are never freed, so threads that
+	* ended still show in the trace, and a new thread takes over the buffer
+	* of one that ended.
+	*/
+	struct Registry {
+		Registry() : gpu(0), trace_seconds(10.0) {}
+
+		std::mutex mutex;
+		std::vector<Buffer*> buffers;
+		Buffer gpu;
+		double trace_seconds;
+	};
+
+	Registry& registry() {
+		static Registry instance;
+		return instance;
+	}
+
+	Buffer* acquireBuffer() {
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for(unsigned int i = 0; i < r.buffers.size(); i++) {
+			if(!r.buffers.at(i)->in_use) {
+				r.buffers.at(i)->in_use = true;
+				return r.buffers.at(i);
+			}
+		}
+		r.buffers.push_back(new Buffer(static_cast<unsigned int>(r.buffers.size()) + 1));
+		r.buffers.back()->in_use = true;
+		return r.buffers.back();
+	}
+
+	/**
+	* The buffer of the calling thread, taken on its first sample and given
+	* back when the thread ends
+	*/
+	struct ThreadBuffer {
+		ThreadBuffer() : buffer(NULL) {}
+		~ThreadBuffer() {
+			if(buffer == NULL)
+				return;
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			buffer->in_use = false;
+		}
+
+		Buffer* buffer;
+	};
+
+	thread_local ThreadBuffer thread_buffer;
+
+	/**
+	* Copies the samples of the buffer ending at or after the param time
+	*/
+	void collect(Buffer& buffer, long long since_ns, std::vector<std::pair<unsigned int, Sample> >& out) {
+		unsigned int end = buffer.count.load(std::memory_order_acquire);
+		unsigned int begin = end > buffer_capacity ? end - buffer_capacity : 0;
+		std::vector<Sample> copy;
+		for(unsigned int i = begin; i < end; i++)
+			copy.push_back(buffer.samples[i % buffer_capacity]);
+
+		unsigned int overwritten = buffer.count.load(std::memory_order_acquire);
+		unsigned int first_valid = overwritten > buffer_capacity ? overwritten - buffer_capacity : 0;
+		for(unsigned int i = std::max(begin, first_valid); i < end; i++) {
+			const Sample& sample = copy.at(i - begin);
+			if(sample.end_ns >= since_ns)
+				out.push_back(std::make_pair(buffer.id, sample));
+		}
+	}
+
+	void writeEscaped(std::ostream& out, const char* str) {
+		for(; *str != '\0'; str++) {
+			if(*str == '"' || *str == '\\')
+				out << '\\';
+			if(static_cast<unsigned char>(*str) >= 0x20)
+				out << *str;
+		}
+	}
+}
+
+void setEnabled(bool enable) {
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+void setTraceSeconds(double seconds) {
+	registry().trace_seconds = seconds;
+}
+
+double getTraceSeconds() {
+	return registry().trace_seconds;
+}
+
+long long now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* name, long long begin_ns, long long end_ns) {
+	if(thread_buffer.buffer == NULL)
+		thread_buffer.buffer = acquireBuffer();
+	thread_buffer.buffer->push(name, begin_ns, end_ns);
+}
+
+void recordGPU(const char* name, long long begin_ns, long long end_ns) {
+	registry().gpu.push(name, begin_ns, end_ns);
+}
+
+bool writeChromeTrace(const std::string& filename) {
+	std::ofstream out(filename.c_str());
+	if(!out.good())
+		return false;
+
+	Registry& r = registry();
+	long long since_ns = now() - static_cast<long long>(r.trace_seconds*1.0e9);
+	std::vector<std::pair<unsigned int, Sample> > samples;
+	std::vector<unsigned int> thread_ids;
+	{
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for(unsigned int i = 0; i < r.buffers.size(); i++) {
+			collect(*r.buffers.at(i), since_ns, samples);
+			thread_ids.push_back(r.buffers.at(i)->id);
+		}
+	}
+	collect(r.gpu, since_ns, samples);
+
+	long long origin_ns = samples.empty() ? 0 : samples.front().second.begin_ns;
+	for(unsigned int i = 0; i < samples.size(); i++)
+		origin_ns = std::min(origin_ns, samples.at(i).second.begin_ns);
+
+	//Complete ("X") events, in microseconds from the first sample
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+	out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"GPU\"}}";
+	for(unsigned int i = 0; i < thread_ids.size(); i++)
+		out << "," << std::endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread_ids.at(i)
+			<< ", \"args\": {\"name\": \"CPU thread " << thread_ids.at(i) << "\"}}";
+	for(unsigned int i = 0; i < samples.size(); i++) {
+		const Sample& sample = samples.at(i).second;
+		out << "," << std::endl << "{\"name\": \"";
+		writeEscaped(out, sample.name);
+		out << "\", \"cat\": \"" << (samples.at(i).first == 0 ? "gpu" : "cpu") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << samples.at(i).first
+			<< ", \"ts\": " << (sample.begin_ns - origin_ns)/1000.0
+			<< ", \"dur\": " << (sample.end_ns - sample.begin_ns)/1000.0 << "}";
+	}
+	out << std::endl << "]}" << std::endl;
+	return out.good();
+}
+
+}
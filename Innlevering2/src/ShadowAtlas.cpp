@@ -0,0 +1,85 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+
+
+ShadowAtlas::ShadowAtlas(unsigned int size, GLenum depth_format, unsigned int min_tile_size) {
+	this->size = size;
+	this->min_tile_size = min_tile_size;
+	fbo.reset(new ShadowFBO(size, size, depth_format));
+}
+
+/**
+* Largest power of two not above the param value, at least 1
+*/
+static unsigned int floorPowerOfTwo(unsigned int value) {
+	unsigned int result = 1;
+	while(result*2 <= value)
+		result *= 2;
+	return result;
+}
+
+bool ShadowAtlas::pack(const std::vector<unsigned int>& requested_sizes) {
+	std::vector<unsigned int> sizes(requested_sizes.size());
+	unsigned int max_tile_size = std::max(size/2, min_tile_size);
+	for(unsigned int i = 0; i < sizes.size(); i++)
+		sizes[i] = floorPowerOfTwo(std::min(std::max(requested_sizes[i], min_tile_size), max_tile_size));
+
+	//Halve the largest tiles until the budget is met. Power of two squares
+	//sorted largest first always fit when their total area does.
+	while(true) {
+		unsigned long long area = 0;
+		for(unsigned int i = 0; i < sizes.size(); i++)
+			area += (unsigned long long) sizes[i]*sizes[i];
+		if(area <= (unsigned long long) size*size)
+			break;
+
+		std::vector<unsigned int>::iterator largest = std::max_element(sizes.begin(), sizes.end());
+		if(*largest <= min_tile_size)
+			break;
+		*largest /= 2;
+	}
+
+	if(sizes == tile_sizes)
+		return false;
+	tile_sizes = sizes;
+
+	std::vector<unsigned int> order(sizes.size());
+	for(unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sizes[a] > sizes[b]; });
+
+	//Free squares of the quadtree. A tile takes the last free square, which is
+	//the smallest one, splitting it into quadrants until it has the tile size.
+	std::vector<Tile> free_squares;
+	Tile root = {0, 0, size};
+	free_squares.push_back(root);
+
+	tiles.assign(sizes.size(), root);
+	for(unsigned int i = 0; i < order.size(); i++) {
+		unsigned int tile_size = sizes[order[i]];
+		if(free_squares.empty()) {
+			//Only reachable when even minimum size tiles exceed the atlas
+			std::cerr << "Shadow atlas full, light " << order[i] << " shares a tile" << std::endl;
+			Tile shared = {0, 0, tile_size};
+			tiles[order[i]] = shared;
+			continue;
+		}
+
+		Tile square = free_squares.back();
+		free_squares.pop_back();
+		while(square.size > tile_size) {
+			unsigned int half = square.size/2;
+			Tile quadrants[3] = {
+				{square.x+half, square.y+half, half},
+				{square.x, square.y+half, half},
+				{square.x+half, square.y, half}
+			};
+			free_squares.insert(free_squares.end(), quadrants, quadrants+3);
+			square.size = half;
+		}
+		tiles[order[i]] = square;
+	}
+
+	return true;
+}
@@ -2,9 +2,10 @@
 #include "GLUtils/GLUtils.hpp"
 
 
-ShadowFBO::ShadowFBO(unsigned int width, unsigned int height) {
+ShadowFBO::ShadowFBO(unsigned int width, unsigned int height, GLenum depth_format) {
 	this->width = width;
 	this->height = height;
+	this->depth_format = depth_format;
 
 	// Initialize Depth & Texture
 	glGenTextures(1, &texture);
@@ -17,7 +18,7 @@ ShadowFBO::ShadowFBO(unsigned int width, unsigned int height) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+	glTexImage2D(GL_TEXTURE_2D, 0, depth_format, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
 
 	glGenFramebuffers(1, &fbo);
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
@@ -26,20 +27,33 @@ ShadowFBO::ShadowFBO(unsigned int width, unsigned int height) {
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	
+	GLUtils::labelObject(GL_TEXTURE, texture, "shadow map depth");
+	GLUtils::labelObject(GL_FRAMEBUFFER, fbo, "shadow map");
+
 	//Check for completeness
 	CHECK_GL_ERRORS();
 	CHECK_GL_FBO_COMPLETENESS();
 }
 
 ShadowFBO::~ShadowFBO() {
-	glDeleteFramebuffersEXT(1, &fbo);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &texture);
 }
 
 void ShadowFBO::bind() {
-	glBindFramebufferEXT(GL_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 }
 
 void ShadowFBO::unbind() {
-	glBindFramebufferEXT(GL_FRAMEBUFFER, 0);
-}
\ No newline at end of file
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
+}
+
+const char* ShadowFBO::depthFormatName(GLenum depth_format) {
+	switch(depth_format) {
+	case GL_DEPTH_COMPONENT16: return "GL_DEPTH_COMPONENT16";
+	case GL_DEPTH_COMPONENT24: return "GL_DEPTH_COMPONENT24";
+	case GL_DEPTH_COMPONENT32: return "GL_DEPTH_COMPONENT32";
+	case GL_DEPTH_COMPONENT32F: return "GL_DEPTH_COMPONENT32F";
+	default: return "unknown depth format";
+	}
+}
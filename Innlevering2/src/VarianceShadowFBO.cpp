@@ -0,0 +1,92 @@
+#include "VarianceShadowFBO.h"
+#include "GLUtils/GLUtils.hpp"
+
+
+VarianceShadowFBO::VarianceShadowFBO(unsigned int width, unsigned int height) {
+	this->width = width;
+	this->height = height;
+
+	// Initialize the moment textures. They are filtered linearly, which is
+	// what lets a single fetch stand in for several PCF taps
+	glGenTextures(2, &textures[0]);
+	for(int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, (void*)0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Depth is only needed while rendering the moments, so a renderbuffer is enough
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(2, &fbos[0]);
+	for(int i = 0; i < 2; i++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+		if(i == 0)
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+		//Check for completeness
+		CHECK_GL_FBO_COMPLETENESS();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtils::labelObject(GL_TEXTURE, textures[0], "VSM moments");
+	GLUtils::labelObject(GL_TEXTURE, textures[1], "VSM blur");
+	GLUtils::labelObject(GL_FRAMEBUFFER, fbos[0], "VSM moments");
+	GLUtils::labelObject(GL_FRAMEBUFFER, fbos[1], "VSM blur");
+	CHECK_GL_ERRORS();
+}
+
+VarianceShadowFBO::~VarianceShadowFBO() {
+	glDeleteFramebuffers(2, &fbos[0]);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteTextures(2, &textures[0]);
+}
+
+void VarianceShadowFBO::bind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbos[0]);
+}
+
+void VarianceShadowFBO::unbind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
+}
+
+void VarianceShadowFBO::blur(std::shared_ptr<GLUtils::Program> blur_program, GLuint fullscreen_vao) {
+	glViewport(0, 0, width, height);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	blur_program->use();
+	glBindVertexArray(fullscreen_vao);
+	glActiveTexture(GL_TEXTURE0);
+
+	//Horizontal pass, moments -> intermediate
+	glBindFramebuffer(GL_FRAMEBUFFER, fbos[1]);
+	glBindTexture(GL_TEXTURE_2D, textures[0]);
+	glUniform2f(blur_program->getUniform("blur_step"), 1.0f/width, 0.0f);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	//Vertical pass, intermediate -> moments
+	glBindFramebuffer(GL_FRAMEBUFFER, fbos[0]);
+	glBindTexture(GL_TEXTURE_2D, textures[1]);
+	glUniform2f(blur_program->getUniform("blur_step"), 0.0f, 1.0f/height);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+	blur_program->disuse();
+	glBindFramebuffer(GL_FRAMEBUFFER, GLUtils::screenFramebuffer());
+
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	CHECK_GL_ERRORS();
+}
@@ -1,5 +1,10 @@
 #include "GameManager.h"
+#include "Profiler.h"
 #include <iostream>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
 
 #ifdef _WIN32
 #define NOMINMAX
@@ -7,14 +12,154 @@
 #endif
 
 /**
- * Simple program that starts our game manager
+ * Simple program that starts our game manager. With --headless it renders
+ * offscreen instead, for machines without a display:
+ *   --headless            render --frames frames without a window and exit
+ *   --size WIDTHxHEIGHT   offscreen framebuffer size (default 1280x720)
+ *   --frames N            number of frames to render (default 1000)
+ *   --threads N           llvmpipe rasterizer threads (LP_NUM_THREADS)
+ * With --benchmark it runs the built in benchmark scenarios instead, in the
+ * window or headless, and writes the frame time statistics as JSON:
+ *   --benchmark [NAME]    run all scenarios, or only the named one
+ *   --seed N              seed of the bunny and light placement (default 1234)
+ *   --output FILE         JSON file to write (default benchmark.json)
+ * The windowed game can record its input and replay it frame by frame, and
+ * log its frame times:
+ *   --record FILE         write every handled event to an input log
+ *   --replay FILE         play an input log back, with its seed and window size
+ *   --frame-log FILE [SECONDS]  write frame time statistics as JSON lines
+ *                         every SECONDS (default 1)
+ *   --hitch-budget MS     write the last frames to hitch_<frame>.json when a
+ *                         frame takes over MS (default 50, 0 turns it off)
+ * Any of them can capture the GL calls of a frame for tools/glreplay, in a
+ * build with PG612_GL_CAPTURE (F10 captures the next one while playing):
+ *   --capture FILE [FRAME]  capture frame FRAME (default 10) to FILE
+ * Any of them can be profiled (F9 starts and writes a profile while playing):
+ *   --profile [SECONDS]   record from the start and write the last SECONDS
+ *                         (default 10) to trace.json at exit
  */
 int main(int argc, char *argv[]) {
+	bool headless = false;
+	unsigned int width = 1280, height = 720;
+	unsigned int frames = 1000;
+	bool benchmark = false;
+	std::string benchmark_name;
+	std::string benchmark_output = "benchmark.json";
+	unsigned int seed = 1234;
+	bool seed_set = false;
+	bool profile = false;
+	double hitch_budget = -1.0;
+	std::string frame_log_file;
+	double frame_log_interval = 1.0;
+	std::string record_file;
+	std::string replay_file;
+	std::string capture_file;
+	unsigned int capture_frame = 10;
+	std::shared_ptr<InputReplay> replay;
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--headless")
+			headless = true;
+		else if(arg == "--size" && i+1 < argc)
+			sscanf(argv[++i], "%ux%u", &width, &height);
+		else if(arg == "--frames" && i+1 < argc)
+			frames = static_cast<unsigned int>(atoi(argv[++i]));
+		else if(arg == "--threads" && i+1 < argc)
+			HeadlessContext::setRasterizerThreads(static_cast<unsigned int>(atoi(argv[++i])));
+		else if(arg == "--benchmark") {
+			benchmark = true;
+			if(i+1 < argc && std::string(argv[i+1]).compare(0, 2, "--") != 0)
+				benchmark_name = argv[++i];
+		}
+		else if(arg == "--seed" && i+1 < argc) {
+			seed = static_cast<unsigned int>(atoi(argv[++i]));
+			seed_set = true;
+		}
+		else if(arg == "--output" && i+1 < argc)
+			benchmark_output = argv[++i];
+		else if(arg == "--profile") {
+			profile = true;
+			if(i+1 < argc && std::string(argv[i+1]).compare(0, 2, "--") != 0)
+				profiler::setTraceSeconds(atof(argv[++i]));
+		}
+		else if(arg == "--frame-log" && i+1 < argc) {
+			frame_log_file = argv[++i];
+			if(i+1 < argc && std::string(argv[i+1]).compare(0, 2, "--") != 0)
+				frame_log_interval = atof(argv[++i]);
+		}
+		else if(arg == "--hitch-budget" && i+1 < argc)
+			hitch_budget = atof(argv[++i]);
+		else if(arg == "--record" && i+1 < argc)
+			record_file = argv[++i];
+		else if(arg == "--replay" && i+1 < argc)
+			replay_file = argv[++i];
+		else if(arg == "--capture" && i+1 < argc) {
+			capture_file = argv[++i];
+			if(i+1 < argc && std::string(argv[i+1]).compare(0, 2, "--") != 0)
+				capture_frame = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+	}
+
+	std::vector<BenchmarkScenario> scenarios;
+	if(benchmark) {
+		std::vector<BenchmarkScenario> all = getBenchmarkScenarios();
+		for(unsigned int i = 0; i < all.size(); i++) {
+			if(benchmark_name.empty() || all.at(i).name == benchmark_name)
+				scenarios.push_back(all.at(i));
+		}
+		if(scenarios.empty()) {
+			std::cout << "Unknown benchmark scenario " << benchmark_name << ", the scenarios are:" << std::endl;
+			for(unsigned int i = 0; i < all.size(); i++)
+				std::cout << "  " << all.at(i).name << std::endl;
+			return -1;
+		}
+	}
+
+	profiler::setEnabled(profile);
 	try {
 		GameManager* game;
 		game = new GameManager();
-		game->init();
-		game->play();
+		//Benchmarks are only comparable with the same scene
+		if(benchmark || seed_set)
+			game->setRandomSeed(seed);
+		//A replay must start from the recorded scene and window
+		if(!replay_file.empty()) {
+			replay = std::make_shared<InputReplay>(replay_file);
+			game->setRandomSeed(replay->getSeed());
+			window_width = replay->getWidth();
+			window_height = replay->getHeight();
+		}
+		if(headless)
+			game->initHeadless(width, height);
+		else
+			game->init();
+		if(!capture_file.empty())
+			game->captureFrame(capture_file, capture_frame);
+
+		if(benchmark) {
+			std::ofstream json(benchmark_output.c_str());
+			game->runBenchmark(scenarios, json);
+			std::cout << "Wrote " << benchmark_output << std::endl;
+		}
+		else if(headless)
+			game->playHeadless(frames);
+		else {
+			if(!record_file.empty())
+				game->recordInput(record_file);
+			if(hitch_budget >= 0.0)
+				game->setHitchBudget(hitch_budget);
+			if(!frame_log_file.empty())
+				game->setFrameLog(frame_log_file, frame_log_interval);
+			if(replay)
+				game->setInputReplay(replay);
+			game->play();
+		}
+		if(profile) {
+			if(profiler::writeChromeTrace("trace.json"))
+				std::cout << "Wrote the last " << profiler::getTraceSeconds() << " s of the profile to trace.json" << std::endl;
+			else
+				std::cout << "Could not write trace.json" << std::endl;
+		}
 		delete game;
 	} catch (std::exception &e) {
 		std::string err = e.what();
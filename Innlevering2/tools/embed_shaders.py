@@ -0,0 +1,100 @@
+"""
+Writes every shader below the shader directory into a C++ source file as a
+constexpr open addressing table of string literals, indexed by the 64 bit
+FNV-1a hash of the shader path so GLUtils::findEmbeddedShader finds a shader
+in its hash slot. A static_assert per shader checks the hash against the
+constexpr GLUtils::hashString.
+
+Usage: python embed_shaders.py <shader directory> <output .cpp file>
+
+Run as the pre-build event of the project. The output is only rewritten when
+a shader changed, so an unchanged tree does not recompile it.
+"""
+import os
+import sys
+
+SHADER_EXTENSIONS = ('.vert', '.geom', '.frag', '.glsl')
+
+
+def fnv1a_64(text):
+    """Same hash as GLUtils::hashString"""
+    h = 14695981039346656037
+    for byte in bytearray(text.encode("utf-8")):
+        h ^= byte
+        h = (h * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def cpp_literal(line):
+    escaped = line.replace('\\', '\\\\').replace('"', '\\"').replace('\t', '\\t')
+    return '"' + escaped + '\\n"'
+
+
+def main(shader_dir, output):
+    shaders = []
+    for root, dirs, files in os.walk(shader_dir):
+        dirs.sort()
+        for name in sorted(files):
+            if not name.endswith(SHADER_EXTENSIONS):
+                continue
+            path = os.path.join(root, name)
+            # Programs name their shaders relative to the working directory,
+            # e.g. "shaders/include/shadows.glsl"
+            key = os.path.relpath(path, os.path.dirname(os.path.abspath(shader_dir))).replace(os.sep, '/')
+            with open(path, 'r') as f:
+                lines = f.read().splitlines()
+            shaders.append((fnv1a_64(key), key, lines))
+
+    # At least twice the shader count, so probes stay short
+    slot_count = 1
+    while slot_count < 2 * len(shaders):
+        slot_count *= 2
+    slots = [None] * slot_count
+    for shader in shaders:
+        slot = shader[0] & (slot_count - 1)
+        while slots[slot] is not None:
+            slot = (slot + 1) & (slot_count - 1)
+        slots[slot] = shader
+
+    out = []
+    out.append('//Generated by tools/embed_shaders.py from %s, do not edit' % shader_dir.replace(os.sep, '/'))
+    out.append('#include "GLUtils/EmbeddedShaders.hpp"')
+    out.append('')
+    out.append('namespace GLUtils {')
+    out.append('')
+    for h, key, lines in shaders:
+        out.append('static_assert(hashString("%s") == 0x%016xULL, "%s");' % (key, h, key))
+    out.append('')
+    out.append('constexpr EmbeddedShader embedded_shaders[] = {')
+    for slot in slots:
+        if slot is None:
+            out.append('\t{0ULL, NULL, NULL},')
+            continue
+        h, key, lines = slot
+        out.append('\t{0x%016xULL, "%s",' % (h, key))
+        for line in lines:
+            out.append('\t\t' + cpp_literal(line))
+        if not lines:
+            out.append('\t\t""')
+        out.append('\t},')
+    out.append('};')
+    out.append('')
+    out.append('constexpr unsigned int embedded_shader_slots = %d;' % slot_count)
+    out.append('')
+    out.append('}; //Namespace GLUtils')
+    out.append('')
+    text = '\n'.join(out)
+
+    if os.path.exists(output):
+        with open(output, 'r') as f:
+            if f.read() == text:
+                return
+    with open(output, 'w') as f:
+        f.write(text)
+    print('Embedded %d shaders in %s' % (len(shaders), output))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    main(sys.argv[1], sys.argv[2])
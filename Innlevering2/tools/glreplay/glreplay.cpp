@@ -0,0 +1,743 @@
+#include "HeadlessContext.h"
+#include "GLUtils/GLUtils.hpp"
+#include "GLUtils/GLCapture.hpp"
+#include "GameException.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+	struct Trace {
+		GLuint width, height;
+		std::vector<GLuint> words;
+		size_t section_begin[4]; //< Of the object, state and frame sections, and the end
+	};
+
+	Trace loadTrace(const std::string& filename) {
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		GLuint header[7];
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if(!file.good() || header[0] != GLUtils::gl_trace_magic)
+			THROW_EXCEPTION(filename + " is not a GL trace");
+		if(header[1] != GLUtils::gl_trace_version) {
+			std::stringstream err;
+			err << filename << " is a version " << header[1] << " trace, this replayer reads version " << GLUtils::gl_trace_version;
+			THROW_EXCEPTION(err.str());
+		}
+
+		Trace trace;
+		trace.width = header[2];
+		trace.height = header[3];
+		trace.section_begin[0] = 0;
+		for(unsigned int i = 0; i < 3; i++)
+			trace.section_begin[i+1] = trace.section_begin[i] + header[4+i];
+		trace.words.resize(trace.section_begin[3]);
+		if(!trace.words.empty())
+			file.read(reinterpret_cast<char*>(&trace.words[0]), trace.words.size()*sizeof(GLuint));
+		if(!file.good())
+			THROW_EXCEPTION(filename + " is truncated");
+		return trace;
+	}
+
+	/**
+	* Reads the arguments of a command
+	*/
+	class TraceArgs {
+	public:
+		TraceArgs(const GLuint* words) : next(words) {}
+
+		GLuint u() { return *next++; }
+		GLint i() { return static_cast<GLint>(*next++); }
+		GLfloat f() {
+			GLfloat value;
+			std::memcpy(&value, next++, sizeof(GLfloat));
+			return value;
+		}
+
+		/**
+		* Returns the bytes of a blob, NULL if it is empty
+		*/
+		const void* blob(GLuint& bytes) {
+			bytes = u();
+			const void* data = bytes > 0 ? next : NULL;
+			next += (bytes+3)/4;
+			return data;
+		}
+
+		std::string str() {
+			GLuint bytes;
+			const char* data = static_cast<const char*>(blob(bytes));
+			return bytes > 0 ? std::string(data, bytes) : std::string();
+		}
+
+		const GLuint* words() { return next; }
+		void skip(unsigned int count) { next += count; }
+
+	private:
+		const GLuint* next;
+	};
+
+	/**
+	* Executes trace commands, mapping the object names and uniform
+	* locations of the capture to those of this context
+	*/
+	class Replayer {
+	public:
+		Replayer(GLuint screen_framebuffer) : current_program(0), screen_framebuffer(screen_framebuffer),
+											  call_count(0), draw_count(0) {}
+
+		/**
+		* Executes the commands of the param section of the trace
+		*/
+		void run(const Trace& trace, unsigned int section);
+
+		unsigned int getCallCount() { return call_count; }	//< Of the last run
+		unsigned int getDrawCount() { return draw_count; }
+
+	private:
+		typedef std::map<GLuint, GLuint> NameMap;
+
+		void execute(GLuint command, TraceArgs& a);
+		void createProgram(TraceArgs& a);
+		void setUniform(GLint location, GLenum type, const GLuint* values);
+
+		GLuint object(NameMap& names, GLuint name, const char* kind) {
+			if(name == 0)
+				return 0;
+			NameMap::iterator it = names.find(name);
+			if(it == names.end()) {
+				std::stringstream err;
+				err << "The trace uses " << kind << " " << name << " before it is created";
+				THROW_EXCEPTION(err.str());
+			}
+			return it->second;
+		}
+
+		GLint location(GLint captured) {
+			std::map<GLint, GLint>& locations = uniform_locations[current_program];
+			std::map<GLint, GLint>::iterator it = locations.find(captured);
+			return it != locations.end() ? it->second : -1;
+		}
+
+		NameMap buffers, textures, vertex_arrays, framebuffers, renderbuffers, programs;
+		std::map<GLuint, std::map<GLint, GLint> > uniform_locations; //< Of each program, by the captured location
+		GLuint current_program; //< As named in the capture
+		GLuint screen_framebuffer; //< Stands in for framebuffer 0 of the capture
+		unsigned int call_count, draw_count;
+	};
+
+	void Replayer::run(const Trace& trace, unsigned int section) {
+		call_count = draw_count = 0;
+		size_t pos = trace.section_begin[section];
+		size_t end = trace.section_begin[section+1];
+		while(pos + 2 <= end) {
+			GLuint command = trace.words[pos];
+			GLuint length = trace.words[pos+1];
+			if(pos + 2 + length > end)
+				THROW_EXCEPTION("The trace has a truncated command");
+			TraceArgs args(&trace.words[pos+2]);
+			execute(command, args);
+			pos += 2 + length;
+			call_count++;
+		}
+	}
+
+	void Replayer::execute(GLuint command, TraceArgs& a) {
+		GLuint bytes, n;
+		const void* data;
+		switch(command) {
+		case GLUtils::GLTRACE_GEN_BUFFERS:
+		case GLUtils::GLTRACE_GEN_TEXTURES:
+		case GLUtils::GLTRACE_GEN_VERTEX_ARRAYS:
+		case GLUtils::GLTRACE_GEN_FRAMEBUFFERS:
+		case GLUtils::GLTRACE_GEN_RENDERBUFFERS:
+			n = a.u();
+			for(GLuint i = 0; i < n; i++) {
+				GLuint captured = a.u(), name;
+				switch(command) {
+				case GLUtils::GLTRACE_GEN_BUFFERS: glGenBuffers(1, &name); buffers[captured] = name; break;
+				case GLUtils::GLTRACE_GEN_TEXTURES: glGenTextures(1, &name); textures[captured] = name; break;
+				case GLUtils::GLTRACE_GEN_VERTEX_ARRAYS: glGenVertexArrays(1, &name); vertex_arrays[captured] = name; break;
+				case GLUtils::GLTRACE_GEN_FRAMEBUFFERS: glGenFramebuffers(1, &name); framebuffers[captured] = name; break;
+				default: glGenRenderbuffers(1, &name); renderbuffers[captured] = name; break;
+				}
+			}
+			break;
+		case GLUtils::GLTRACE_DELETE_BUFFERS:
+		case GLUtils::GLTRACE_DELETE_TEXTURES:
+		case GLUtils::GLTRACE_DELETE_VERTEX_ARRAYS:
+		case GLUtils::GLTRACE_DELETE_FRAMEBUFFERS:
+		case GLUtils::GLTRACE_DELETE_RENDERBUFFERS:
+			n = a.u();
+			for(GLuint i = 0; i < n; i++) {
+				GLuint captured = a.u(), name;
+				switch(command) {
+				case GLUtils::GLTRACE_DELETE_BUFFERS: name = object(buffers, captured, "buffer"); glDeleteBuffers(1, &name); buffers.erase(captured); break;
+				case GLUtils::GLTRACE_DELETE_TEXTURES: name = object(textures, captured, "texture"); glDeleteTextures(1, &name); textures.erase(captured); break;
+				case GLUtils::GLTRACE_DELETE_VERTEX_ARRAYS: name = object(vertex_arrays, captured, "vertex array"); glDeleteVertexArrays(1, &name); vertex_arrays.erase(captured); break;
+				case GLUtils::GLTRACE_DELETE_FRAMEBUFFERS: name = object(framebuffers, captured, "framebuffer"); glDeleteFramebuffers(1, &name); framebuffers.erase(captured); break;
+				default: name = object(renderbuffers, captured, "renderbuffer"); glDeleteRenderbuffers(1, &name); renderbuffers.erase(captured); break;
+				}
+			}
+			break;
+
+		case GLUtils::GLTRACE_BIND_BUFFER: {
+			GLenum target = a.u();
+			glBindBuffer(target, object(buffers, a.u(), "buffer"));
+			break;
+		}
+		case GLUtils::GLTRACE_BIND_BUFFER_BASE: {
+			GLenum target = a.u();
+			GLuint index = a.u();
+			glBindBufferBase(target, index, object(buffers, a.u(), "buffer"));
+			break;
+		}
+		case GLUtils::GLTRACE_BUFFER_DATA: {
+			GLenum target = a.u();
+			GLuint size = a.u();
+			GLenum usage = a.u();
+			data = a.blob(bytes);
+			glBufferData(target, size, data, usage);
+			break;
+		}
+		case GLUtils::GLTRACE_BUFFER_SUB_DATA: {
+			GLenum target = a.u();
+			GLuint offset = a.u();
+			data = a.blob(bytes);
+			glBufferSubData(target, offset, bytes, data);
+			break;
+		}
+
+		case GLUtils::GLTRACE_ACTIVE_TEXTURE:
+			glActiveTexture(a.u());
+			break;
+		case GLUtils::GLTRACE_BIND_TEXTURE: {
+			GLenum target = a.u();
+			glBindTexture(target, object(textures, a.u(), "texture"));
+			break;
+		}
+		case GLUtils::GLTRACE_TEX_IMAGE_2D: {
+			GLenum target = a.u();
+			GLint level = a.i(), internal_format = a.i();
+			GLsizei width = a.i(), height = a.i();
+			GLint border = a.i();
+			GLenum format = a.u(), type = a.u();
+			data = a.blob(bytes);
+			glTexImage2D(target, level, internal_format, width, height, border, format, type, data);
+			break;
+		}
+		case GLUtils::GLTRACE_TEX_IMAGE_3D: {
+			GLenum target = a.u();
+			GLint level = a.i(), internal_format = a.i();
+			GLsizei width = a.i(), height = a.i(), depth = a.i();
+			GLint border = a.i();
+			GLenum format = a.u(), type = a.u();
+			data = a.blob(bytes);
+			glTexImage3D(target, level, internal_format, width, height, depth, border, format, type, data);
+			break;
+		}
+		case GLUtils::GLTRACE_TEX_PARAMETERI: {
+			GLenum target = a.u(), pname = a.u();
+			glTexParameteri(target, pname, a.i());
+			break;
+		}
+		case GLUtils::GLTRACE_TEX_BUFFER: {
+			GLenum target = a.u(), internal_format = a.u();
+			glTexBuffer(target, internal_format, object(buffers, a.u(), "buffer"));
+			break;
+		}
+
+		case GLUtils::GLTRACE_BIND_RENDERBUFFER: {
+			GLenum target = a.u();
+			glBindRenderbuffer(target, object(renderbuffers, a.u(), "renderbuffer"));
+			break;
+		}
+		case GLUtils::GLTRACE_RENDERBUFFER_STORAGE: {
+			GLenum target = a.u(), internal_format = a.u();
+			GLsizei width = a.i(), height = a.i();
+			glRenderbufferStorage(target, internal_format, width, height);
+			break;
+		}
+		case GLUtils::GLTRACE_RENDERBUFFER_STORAGE_MULTISAMPLE: {
+			GLenum target = a.u();
+			GLsizei samples = a.i();
+			GLenum internal_format = a.u();
+			GLsizei width = a.i(), height = a.i();
+			glRenderbufferStorageMultisample(target, samples, internal_format, width, height);
+			break;
+		}
+		case GLUtils::GLTRACE_BIND_FRAMEBUFFER: {
+			GLenum target = a.u();
+			GLuint framebuffer = a.u();
+			glBindFramebuffer(target, framebuffer == 0 ? screen_framebuffer : object(framebuffers, framebuffer, "framebuffer"));
+			break;
+		}
+		case GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE: {
+			GLenum target = a.u(), attachment = a.u();
+			GLuint texture = object(textures, a.u(), "texture");
+			glFramebufferTexture(target, attachment, texture, a.i());
+			break;
+		}
+		case GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE_2D: {
+			GLenum target = a.u(), attachment = a.u(), texture_target = a.u();
+			GLuint texture = object(textures, a.u(), "texture");
+			glFramebufferTexture2D(target, attachment, texture_target, texture, a.i());
+			break;
+		}
+		case GLUtils::GLTRACE_FRAMEBUFFER_TEXTURE_LAYER: {
+			GLenum target = a.u(), attachment = a.u();
+			GLuint texture = object(textures, a.u(), "texture");
+			GLint level = a.i();
+			glFramebufferTextureLayer(target, attachment, texture, level, a.i());
+			break;
+		}
+		case GLUtils::GLTRACE_FRAMEBUFFER_RENDERBUFFER: {
+			GLenum target = a.u(), attachment = a.u(), renderbuffer_target = a.u();
+			glFramebufferRenderbuffer(target, attachment, renderbuffer_target, object(renderbuffers, a.u(), "renderbuffer"));
+			break;
+		}
+		//The window's buffers are the color attachment of the offscreen framebuffer here
+		case GLUtils::GLTRACE_DRAW_BUFFER:
+		case GLUtils::GLTRACE_READ_BUFFER: {
+			GLenum mode = a.u();
+			if(mode == GL_BACK || mode == GL_FRONT || mode == GL_BACK_LEFT || mode == GL_FRONT_LEFT)
+				mode = GL_COLOR_ATTACHMENT0;
+			if(command == GLUtils::GLTRACE_DRAW_BUFFER)
+				glDrawBuffer(mode);
+			else
+				glReadBuffer(mode);
+			break;
+		}
+		case GLUtils::GLTRACE_DRAW_BUFFERS:
+			n = a.u();
+			glDrawBuffers(n, a.words());
+			a.skip(n);
+			break;
+
+		case GLUtils::GLTRACE_BIND_VERTEX_ARRAY:
+			glBindVertexArray(object(vertex_arrays, a.u(), "vertex array"));
+			break;
+		case GLUtils::GLTRACE_VERTEX_ATTRIB_POINTER: {
+			GLuint index = a.u();
+			GLint size = a.i();
+			GLenum type = a.u();
+			GLboolean normalized = static_cast<GLboolean>(a.u());
+			GLsizei stride = a.i();
+			glVertexAttribPointer(index, size, type, normalized, stride, BUFFER_OFFSET(a.u()));
+			break;
+		}
+		case GLUtils::GLTRACE_VERTEX_ATTRIB_I_POINTER: {
+			GLuint index = a.u();
+			GLint size = a.i();
+			GLenum type = a.u();
+			GLsizei stride = a.i();
+			glVertexAttribIPointer(index, size, type, stride, BUFFER_OFFSET(a.u()));
+			break;
+		}
+		case GLUtils::GLTRACE_VERTEX_ATTRIB_DIVISOR: {
+			GLuint index = a.u();
+			glVertexAttribDivisor(index, a.u());
+			break;
+		}
+		case GLUtils::GLTRACE_ENABLE_VERTEX_ATTRIB_ARRAY:
+			glEnableVertexAttribArray(a.u());
+			break;
+
+		case GLUtils::GLTRACE_CREATE_PROGRAM:
+			createProgram(a);
+			break;
+		case GLUtils::GLTRACE_PROGRAM_UNIFORM: {
+			GLuint program = a.u();
+			GLint captured = a.i();
+			std::string name = a.str();
+			uniform_locations[program][captured] = glGetUniformLocation(object(programs, program, "program"), name.c_str());
+			break;
+		}
+		case GLUtils::GLTRACE_UNIFORM_BLOCK_BINDING: {
+			GLuint program = object(programs, a.u(), "program");
+			GLuint binding = a.u();
+			GLuint index = glGetUniformBlockIndex(program, a.str().c_str());
+			if(index != GL_INVALID_INDEX)
+				glUniformBlockBinding(program, index, binding);
+			break;
+		}
+		case GLUtils::GLTRACE_UNIFORM_VALUE: {
+			GLint loc = location(a.i());
+			GLenum type = a.u();
+			setUniform(loc, type, a.words());
+			break;
+		}
+		case GLUtils::GLTRACE_USE_PROGRAM:
+			current_program = a.u();
+			glUseProgram(object(programs, current_program, "program"));
+			break;
+		case GLUtils::GLTRACE_UNIFORM_1I: {
+			GLint loc = location(a.i());
+			glUniform1i(loc, a.i());
+			break;
+		}
+		case GLUtils::GLTRACE_UNIFORM_1F: {
+			GLint loc = location(a.i());
+			glUniform1f(loc, a.f());
+			break;
+		}
+		case GLUtils::GLTRACE_UNIFORM_2F: {
+			GLint loc = location(a.i());
+			GLfloat v0 = a.f();
+			glUniform2f(loc, v0, a.f());
+			break;
+		}
+		case GLUtils::GLTRACE_UNIFORM_2FV:
+		case GLUtils::GLTRACE_UNIFORM_3FV:
+		case GLUtils::GLTRACE_UNIFORM_3IV: {
+			GLint loc = location(a.i());
+			GLsizei count = a.i();
+			data = a.blob(bytes);
+			if(command == GLUtils::GLTRACE_UNIFORM_2FV)
+				glUniform2fv(loc, count, static_cast<const GLfloat*>(data));
+			else if(command == GLUtils::GLTRACE_UNIFORM_3FV)
+				glUniform3fv(loc, count, static_cast<const GLfloat*>(data));
+			else
+				glUniform3iv(loc, count, static_cast<const GLint*>(data));
+			break;
+		}
+		case GLUtils::GLTRACE_UNIFORM_MATRIX_4FV: {
+			GLint loc = location(a.i());
+			GLsizei count = a.i();
+			GLboolean transpose = static_cast<GLboolean>(a.u());
+			data = a.blob(bytes);
+			glUniformMatrix4fv(loc, count, transpose, static_cast<const GLfloat*>(data));
+			break;
+		}
+
+		case GLUtils::GLTRACE_ENABLE:
+			glEnable(a.u());
+			break;
+		case GLUtils::GLTRACE_DISABLE:
+			glDisable(a.u());
+			break;
+		case GLUtils::GLTRACE_VIEWPORT:
+		case GLUtils::GLTRACE_SCISSOR: {
+			GLint x = a.i(), y = a.i();
+			GLsizei width = a.i(), height = a.i();
+			if(command == GLUtils::GLTRACE_VIEWPORT)
+				glViewport(x, y, width, height);
+			else
+				glScissor(x, y, width, height);
+			break;
+		}
+		case GLUtils::GLTRACE_DEPTH_FUNC:
+			glDepthFunc(a.u());
+			break;
+		case GLUtils::GLTRACE_DEPTH_MASK:
+			glDepthMask(static_cast<GLboolean>(a.u()));
+			break;
+		case GLUtils::GLTRACE_COLOR_MASK: {
+			GLboolean mask[4];
+			for(unsigned int i = 0; i < 4; i++)
+				mask[i] = static_cast<GLboolean>(a.u());
+			glColorMask(mask[0], mask[1], mask[2], mask[3]);
+			break;
+		}
+		case GLUtils::GLTRACE_BLEND_FUNC: {
+			GLenum source = a.u();
+			glBlendFunc(source, a.u());
+			break;
+		}
+		case GLUtils::GLTRACE_BLEND_FUNC_SEPARATE: {
+			GLenum source_rgb = a.u(), destination_rgb = a.u(), source_alpha = a.u();
+			glBlendFuncSeparate(source_rgb, destination_rgb, source_alpha, a.u());
+			break;
+		}
+		case GLUtils::GLTRACE_BLEND_EQUATION_SEPARATE: {
+			GLenum mode_rgb = a.u();
+			glBlendEquationSeparate(mode_rgb, a.u());
+			break;
+		}
+		case GLUtils::GLTRACE_CULL_FACE:
+			glCullFace(a.u());
+			break;
+		case GLUtils::GLTRACE_FRONT_FACE:
+			glFrontFace(a.u());
+			break;
+		case GLUtils::GLTRACE_POLYGON_MODE: {
+			GLenum face = a.u();
+			glPolygonMode(face, a.u());
+			break;
+		}
+		case GLUtils::GLTRACE_POLYGON_OFFSET: {
+			GLfloat factor = a.f();
+			glPolygonOffset(factor, a.f());
+			break;
+		}
+		case GLUtils::GLTRACE_PIXEL_STOREI: {
+			GLenum pname = a.u();
+			glPixelStorei(pname, a.i());
+			break;
+		}
+		case GLUtils::GLTRACE_CLEAR_COLOR: {
+			GLfloat color[4];
+			for(unsigned int i = 0; i < 4; i++)
+				color[i] = a.f();
+			glClearColor(color[0], color[1], color[2], color[3]);
+			break;
+		}
+		case GLUtils::GLTRACE_CLEAR_DEPTH:
+			glClearDepth(a.f());
+			break;
+		case GLUtils::GLTRACE_CLEAR:
+			glClear(a.u());
+			break;
+
+		case GLUtils::GLTRACE_DRAW_ARRAYS: {
+			GLenum mode = a.u();
+			GLint first = a.i();
+			glDrawArrays(mode, first, a.i());
+			draw_count++;
+			break;
+		}
+		case GLUtils::GLTRACE_DRAW_ELEMENTS: {
+			GLenum mode = a.u();
+			GLsizei count = a.i();
+			GLenum type = a.u();
+			glDrawElements(mode, count, type, BUFFER_OFFSET(a.u()));
+			draw_count++;
+			break;
+		}
+
+		default: {
+			std::stringstream err;
+			err << "The trace has the unknown command " << command;
+			THROW_EXCEPTION(err.str());
+		}
+		}
+	}
+
+	/**
+	* Compiles and links a program from the captured sources, with the
+	* attribute locations it had in the capture
+	*/
+	void Replayer::createProgram(TraceArgs& a) {
+		GLuint captured = a.u();
+		GLuint program = glCreateProgram();
+
+		std::vector<GLuint> shaders;
+		GLuint stages = a.u();
+		for(GLuint i = 0; i < stages; i++) {
+			GLenum type = a.u();
+			std::string source = a.str();
+			GLuint shader = glCreateShader(type);
+			const GLchar* source_list[1] = { source.c_str() };
+			glShaderSource(shader, 1, source_list, NULL);
+			glCompileShader(shader);
+
+			GLint compiled;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if(compiled != GL_TRUE) {
+				std::vector<GLchar> log(4096);
+				glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()), NULL, &log[0]);
+				std::stringstream err;
+				err << "Program " << captured << " of the trace does not compile: " << &log[0];
+				THROW_EXCEPTION(err.str());
+			}
+			glAttachShader(program, shader);
+			shaders.push_back(shader);
+		}
+
+		GLuint attributes = a.u();
+		for(GLuint i = 0; i < attributes; i++) {
+			GLuint location = a.u();
+			glBindAttribLocation(program, location, a.str().c_str());
+		}
+		glLinkProgram(program);
+
+		GLint linked;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if(linked != GL_TRUE) {
+			std::vector<GLchar> log(4096);
+			glGetProgramInfoLog(program, static_cast<GLsizei>(log.size()), NULL, &log[0]);
+			std::stringstream err;
+			err << "Program " << captured << " of the trace does not link: " << &log[0];
+			THROW_EXCEPTION(err.str());
+		}
+		for(unsigned int i = 0; i < shaders.size(); i++) {
+			glDetachShader(program, shaders.at(i));
+			glDeleteShader(shaders.at(i));
+		}
+		programs[captured] = program;
+	}
+
+	void Replayer::setUniform(GLint location, GLenum type, const GLuint* values) {
+		const GLfloat* floats = reinterpret_cast<const GLfloat*>(values);
+		const GLint* ints = reinterpret_cast<const GLint*>(values);
+		switch(type) {
+		case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(location, 1, GL_FALSE, floats); return;
+		}
+
+		GLenum base_type;
+		switch(GLUtils::glUniformComponents(type, base_type)) {
+		case 1:
+			if(base_type == GL_FLOAT) glUniform1fv(location, 1, floats);
+			else if(base_type == GL_UNSIGNED_INT) glUniform1uiv(location, 1, values);
+			else glUniform1iv(location, 1, ints);
+			return;
+		case 2:
+			if(base_type == GL_FLOAT) glUniform2fv(location, 1, floats);
+			else if(base_type == GL_UNSIGNED_INT) glUniform2uiv(location, 1, values);
+			else glUniform2iv(location, 1, ints);
+			return;
+		case 3:
+			if(base_type == GL_FLOAT) glUniform3fv(location, 1, floats);
+			else if(base_type == GL_UNSIGNED_INT) glUniform3uiv(location, 1, values);
+			else glUniform3iv(location, 1, ints);
+			return;
+		case 4:
+			if(base_type == GL_FLOAT) glUniform4fv(location, 1, floats);
+			else if(base_type == GL_UNSIGNED_INT) glUniform4uiv(location, 1, values);
+			else glUniform4iv(location, 1, ints);
+			return;
+		}
+	}
+
+	/**
+	* Writes the color of the param framebuffer to a binary PPM file
+	*/
+	void writeImage(const std::string& filename, GLuint framebuffer, unsigned int width, unsigned int height) {
+		std::vector<unsigned char> pixels(width*height*4);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+		std::ofstream file(filename.c_str(), std::ios::binary);
+		file << "P6\n" << width << " " << height << "\n255\n";
+		for(unsigned int y = height; y-- > 0;)
+			for(unsigned int x = 0; x < width; x++)
+				file.write(reinterpret_cast<const char*>(&pixels[4*(y*width + x)]), 3);
+		if(!file.good())
+			THROW_EXCEPTION("Could not write " + filename);
+	}
+
+	/**
+	* Prints the minimum, median, mean and maximum of the param times
+	*/
+	void printTimes(const char* label, std::vector<double> ms) {
+		std::sort(ms.begin(), ms.end());
+		double sum = 0.0;
+		for(unsigned int i = 0; i < ms.size(); i++)
+			sum += ms.at(i);
+		std::cout << std::left << std::setw(10) << label << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << ms.front() << std::setw(10) << ms.at(ms.size()/2)
+			<< std::setw(10) << sum/ms.size() << std::setw(10) << ms.back() << std::endl;
+	}
+}
+
+/**
+ * Replays a frame captured by the game (F10, or --capture FILE [FRAME]) in
+ * a headless context, over and over, and reports the time each replay
+ * takes the CPU to submit, the whole frame to finish, and the GPU. The
+ * objects of the trace are created once, and every replay sets the
+ * captured state before it runs the calls of the frame.
+ *   glreplay FILE
+ *   --frames N     replays to time (default 100)
+ *   --warmup N     replays before the timed ones (default 10)
+ *   --threads N    llvmpipe rasterizer threads (LP_NUM_THREADS)
+ *   --image FILE   write the replayed frame as a binary PPM, to compare it
+ *                  with the game's
+ * Build it without PG612_GL_CAPTURE and PG612_GL_COUNTERS, so the replayed
+ * calls are the plain GL ones.
+ */
+int main(int argc, char *argv[]) {
+	std::string filename;
+	unsigned int frames = 100;
+	unsigned int warmup = 10;
+	std::string image_file;
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--frames" && i+1 < argc)
+			frames = static_cast<unsigned int>(atoi(argv[++i]));
+		else if(arg == "--warmup" && i+1 < argc)
+			warmup = static_cast<unsigned int>(atoi(argv[++i]));
+		else if(arg == "--threads" && i+1 < argc)
+			HeadlessContext::setRasterizerThreads(static_cast<unsigned int>(atoi(argv[++i])));
+		else if(arg == "--image" && i+1 < argc)
+			image_file = argv[++i];
+		else
+			filename = arg;
+	}
+	if(filename.empty() || frames == 0) {
+		std::cout << "Usage: glreplay FILE [--frames N] [--warmup N] [--threads N] [--image FILE]" << std::endl;
+		return -1;
+	}
+
+	try {
+		Trace trace = loadTrace(filename);
+		HeadlessContext context(trace.width, trace.height);
+		GLUtils::installDebugOutput(GL_DEBUG_SEVERITY_HIGH);
+
+		Replayer replayer(context.getFramebuffer());
+		replayer.run(trace, 0);
+		CHECK_GL_ERRORS();
+
+		GLuint query;
+		glGenQueries(1, &query);
+		std::vector<double> submit_ms, frame_ms, gpu_ms;
+		for(unsigned int i = 0; i < warmup + frames; i++) {
+			Timer timer;
+			glBeginQuery(GL_TIME_ELAPSED, query);
+			replayer.run(trace, 1);
+			replayer.run(trace, 2);
+			glEndQuery(GL_TIME_ELAPSED);
+			double submit = timer.elapsed();
+			glFinish();
+			double frame = timer.elapsed();
+
+			GLuint64 gpu_ns;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpu_ns);
+			CHECK_GL_ERRORS();
+			if(i < warmup)
+				continue;
+			submit_ms.push_back(submit*1000.0);
+			frame_ms.push_back(frame*1000.0);
+			gpu_ms.push_back(gpu_ns*1e-6);
+		}
+		glDeleteQueries(1, &query);
+		if(!image_file.empty())
+			writeImage(image_file, context.getFramebuffer(), trace.width, trace.height);
+
+		std::cout << filename << ": " << trace.width << "x" << trace.height << ", "
+			<< replayer.getCallCount() << " calls and " << replayer.getDrawCount() << " draws per frame" << std::endl;
+		std::cout << frames << " replays after " << warmup << " warm up replays on "
+			<< glGetString(GL_RENDERER) << " (" << context.getBackendName() << ")" << std::endl;
+		std::cout << std::left << std::setw(10) << "ms" << std::right << std::setw(10) << "min" << std::setw(10) << "median"
+			<< std::setw(10) << "mean" << std::setw(10) << "max" << std::endl;
+		printTimes("submit", submit_ms);
+		printTimes("frame", frame_ms);
+		printTimes("GPU", gpu_ms);
+	}
+	catch(std::exception &e) {
+		std::string err = e.what();
+		std::cout << err.c_str() << std::endl;
+		return -1;
+	}
+	return 0;
+}